@@ -127,6 +127,7 @@ void disk_init(void)
                 NOT_REACHED();
         }
         lock_init(&c->lock);
+        lock_set_name(&c->lock, c->name);
         c->expecting_interrupt = false;
         sema_init(&c->completion_wait, 0);
 
@@ -0,0 +1,237 @@
+#include "devices/hrtimer.h"
+
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "devices/timer.h"
+#include "intrinsic.h"
+#include "threads/interrupt.h"
+#include "threads/lapic.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+
+/* High-resolution timers.
+
+   Time is kept by the TSC, converted to nanoseconds with the
+   frequency that hrtimer_calibrate() measures against the 8254
+   timer.  Expiry is signaled by the BSP's local APIC timer, which
+   the BSP does not otherwise use, in one-shot mode: it is always
+   armed for the earliest pending timer, whose expiry the handler
+   then checks against the clock, so an early or stray interrupt
+   does no harm.
+
+   Pending timers sit in a heap with the earliest on top,
+   protected by disabling interrupts.  A processor other than the
+   BSP cannot program the BSP's local APIC, so when it starts a
+   timer that becomes the earliest it sends the timer's vector to
+   the BSP as an IPI, and the handler re-arms. */
+
+/* Timer ticks to measure the TSC over. */
+#define CALIBRATE_TICKS 5
+
+#define NSEC_PER_SEC 1000000000ull
+#define NSEC_PER_TICK (NSEC_PER_SEC / TIMER_FREQ)
+
+/* Longest one-shot to program, in nanoseconds.  A later expiry
+   is reached in several steps. */
+#define MAX_ARM_NS NSEC_PER_SEC
+
+/* TSC when hrtimer_now() read 0, and nanoseconds per TSC cycle,
+   times 2**32.  tsc_mult is 0 until calibrated. */
+static uint64_t tsc_base;
+static uint64_t tsc_mult;
+
+/* Local APIC timer counts per nanosecond, times 2**32, or 0 if
+   there is no local APIC, in which case timers are unavailable. */
+static uint64_t lapic_mult;
+
+/* Pending timers, earliest on top. */
+static struct heap timers;
+
+static intr_handler_func hrtimer_interrupt;
+static heap_less_func expires_later;
+static void arm(void);
+static void wake_sleeper(void *sema);
+
+/* Measures the TSC and, if there is one, the local APIC timer
+   against the 8254 timer, and enables high-resolution timers if
+   possible.  Called by timer_calibrate(), with interrupts on. */
+void hrtimer_calibrate(void)
+{
+    uint64_t start_tsc, end_tsc, tsc_hz;
+    int64_t start;
+
+    ASSERT(intr_get_level() == INTR_ON);
+
+    /* Wait for a tick boundary, then count TSC cycles for a few
+       ticks. */
+    start = timer_ticks();
+    while (timer_ticks() == start) barrier();
+    start = timer_ticks();
+    start_tsc = rdtsc();
+    while (timer_elapsed(start) < CALIBRATE_TICKS) barrier();
+    end_tsc = rdtsc();
+
+    tsc_hz = (end_tsc - start_tsc) * TIMER_FREQ / CALIBRATE_TICKS;
+    if (tsc_hz == 0) return;
+
+    /* Start the clock so that it reads about the same as `ticks'
+       converted to nanoseconds. */
+    tsc_base = end_tsc - (start + CALIBRATE_TICKS) * (tsc_hz / TIMER_FREQ);
+    tsc_mult = (NSEC_PER_SEC << 32) / tsc_hz;
+    printf("TSC runs at %'" PRIu64 " Hz.\n", tsc_hz);
+
+    if (!lapic_present()) return;
+
+    heap_init(&timers, expires_later, NULL);
+    intr_register_ext(LAPIC_VEC_HRTIMER, hrtimer_interrupt, "hrtimer");
+    lapic_mult = ((uint64_t) lapic_timer_calibrate() << 32) / NSEC_PER_TICK;
+}
+
+/* Returns true if hrtimer_start() may be used. */
+bool hrtimer_available(void)
+{
+    return lapic_mult != 0;
+}
+
+/* Returns the number of nanoseconds since about when the OS
+   booted, or 0 before hrtimer_calibrate(). */
+uint64_t hrtimer_now(void)
+{
+    return ((unsigned __int128) (rdtsc() - tsc_base) * tsc_mult) >> 32;
+}
+
+/* Stores in *TSC_BASE and *TSC_MULT what hrtimer_now() computes
+   the time from: it returns (rdtsc() - *TSC_BASE) * *TSC_MULT /
+   2**32, and *TSC_MULT is 0 before hrtimer_calibrate(). */
+void hrtimer_clock(uint64_t *tsc_base_, uint64_t *tsc_mult_)
+{
+    *tsc_base_ = tsc_base;
+    *tsc_mult_ = tsc_mult;
+}
+
+/* Initializes TIMER to call FUNC(AUX) when it expires. */
+void hrtimer_init(struct hrtimer *timer, hrtimer_func *func, void *aux)
+{
+    ASSERT(timer != NULL);
+    ASSERT(func != NULL);
+
+    timer->func = func;
+    timer->aux = aux;
+    timer->pending = false;
+}
+
+/* Starts TIMER to expire when hrtimer_now() reaches EXPIRES, or
+   at once if it already has.  If TIMER was already pending, it
+   is moved to the new time. */
+void hrtimer_start(struct hrtimer *timer, uint64_t expires)
+{
+    enum intr_level old_level;
+
+    ASSERT(timer != NULL);
+    ASSERT(hrtimer_available());
+
+    old_level = intr_disable();
+    if (timer->pending) heap_remove(&timers, &timer->elem);
+    timer->expires = expires;
+    timer->pending = true;
+    heap_push(&timers, &timer->elem);
+    if (heap_top(&timers) == &timer->elem) arm();
+    intr_set_level(old_level);
+}
+
+/* Stops TIMER.  Returns true if it was pending, false if it had
+   already expired or was never started. */
+bool hrtimer_cancel(struct hrtimer *timer)
+{
+    enum intr_level old_level;
+    bool was_pending;
+
+    ASSERT(timer != NULL);
+
+    old_level = intr_disable();
+    was_pending = timer->pending;
+    if (was_pending)
+    {
+        heap_remove(&timers, &timer->elem);
+        timer->pending = false;
+    }
+    intr_set_level(old_level);
+    return was_pending;
+}
+
+/* Blocks the running thread for about NS nanoseconds.  Requires
+   hrtimer_available(). */
+void hrtimer_sleep(uint64_t ns)
+{
+    struct semaphore sema;
+    struct hrtimer timer;
+
+    ASSERT(!intr_context());
+
+    sema_init(&sema, 0);
+    hrtimer_init(&timer, wake_sleeper, &sema);
+    hrtimer_start(&timer, hrtimer_now() + ns);
+    sema_down(&sema);
+}
+
+/* Local APIC timer interrupt handler for the BSP.  Runs every
+   timer that has expired, then arms for the next one. */
+static void hrtimer_interrupt(struct intr_frame *args UNUSED)
+{
+    uint64_t now = hrtimer_now();
+
+    while (!heap_empty(&timers))
+    {
+        struct hrtimer *t = heap_entry(heap_top(&timers), struct hrtimer, elem);
+
+        if (t->expires > now) break;
+        heap_pop(&timers);
+        t->pending = false;
+        t->func(t->aux);
+    }
+    arm();
+}
+
+/* Returns true if timer A expires after timer B, so that the
+   heap keeps the earliest on top. */
+static bool expires_later(const struct heap_elem *a_,
+                          const struct heap_elem *b_, void *aux UNUSED)
+{
+    const struct hrtimer *a = heap_entry(a_, struct hrtimer, elem);
+    const struct hrtimer *b = heap_entry(b_, struct hrtimer, elem);
+
+    return a->expires > b->expires;
+}
+
+/* Arms the BSP's local APIC timer for the earliest pending timer,
+   if there is one.  Interrupts must be off. */
+static void arm(void)
+{
+    struct hrtimer *t;
+    uint64_t now, delta, count;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (heap_empty(&timers)) return;
+
+    if (this_cpu() != &cpus[0])
+    {
+        lapic_send_ipi(cpus[0].lapic_id, LAPIC_VEC_HRTIMER);
+        return;
+    }
+
+    t = heap_entry(heap_top(&timers), struct hrtimer, elem);
+    now = hrtimer_now();
+    delta = t->expires > now ? t->expires - now : 0;
+    if (delta > MAX_ARM_NS) delta = MAX_ARM_NS;
+    count = (delta * lapic_mult) >> 32;
+    lapic_timer_oneshot(LAPIC_VEC_HRTIMER, count > 0 ? count : 1);
+}
+
+/* hrtimer_func for hrtimer_sleep(). */
+static void wake_sleeper(void *sema)
+{
+    sema_up(sema);
+}
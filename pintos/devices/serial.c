@@ -9,6 +9,7 @@
 #include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 
 /* Register definitions for the 16550A UART used in PCs.
    The 16550A has a lot more going on than shown here, but this
@@ -35,6 +36,9 @@
 #define MCR_REG (IO_BASE + 4) /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5) /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01 /* Enable the 16-byte FIFOs. */
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01 /* Interrupt when data received. */
 #define IER_XMIT 0x02 /* Interrupt when transmit finishes. */
@@ -49,6 +53,10 @@
 /* Line Status Register. */
 #define LSR_DR 0x01   /* Data Ready: received data byte is in RBR. */
 #define LSR_THRE 0x20 /* THR Empty. */
+#define LSR_TEMT 0x40 /* Transmitter Empty: THR and shift register. */
+
+/* Bytes the transmitter FIFO holds. */
+#define TX_FIFO_SIZE 16
 
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
@@ -56,10 +64,18 @@ static enum { UNINIT, POLL, QUEUE } mode;
 /* Data to be transmitted. */
 static struct intq txq;
 
+/* Refills the transmitter from txq.  The interrupt handler only
+   schedules it, and the transmit interrupt stays off until it has
+   run.  It runs in the high-priority worker, which therefore must
+   not print anything itself: it could wait for itself to make
+   room in txq. */
+static struct work tx_work;
+
 static void set_serial(int bps);
 static void putc_poll(uint8_t);
 static void write_ier(void);
 static intr_handler_func serial_interrupt;
+static work_func tx_refill;
 
 /* Initializes the serial port device for polling mode.
    Polling mode busy-waits for the serial port to become free
@@ -78,7 +94,8 @@ static void init_poll(void)
 
 /* Initializes the serial port device for queued interrupt-driven
    I/O.  With interrupt-driven I/O we don't waste CPU time
-   waiting for the serial device to become ready. */
+   waiting for the serial device to become ready.  Must be called
+   after workqueue_init(). */
 void serial_init_queue(void)
 {
     enum intr_level old_level;
@@ -86,9 +103,17 @@ void serial_init_queue(void)
     if (mode == UNINIT) init_poll();
     ASSERT(mode == POLL);
 
+    work_init(&tx_work, tx_refill, NULL);
     intr_register_ext(0x20 + 4, serial_interrupt, "serial");
-    mode = QUEUE;
     old_level = intr_disable();
+
+    /* Turn on the FIFOs, so that each transmit interrupt can be
+       answered with up to TX_FIFO_SIZE bytes.  That also clears
+       them, so first let the last byte sent by polling go out. */
+    while ((inb(LSR_REG) & LSR_TEMT) == 0) continue;
+    outb(FCR_REG, FCR_ENABLE);
+
+    mode = QUEUE;
     write_ier();
     intr_set_level(old_level);
 }
@@ -172,8 +197,8 @@ static void write_ier(void)
     ASSERT(intr_get_level() == INTR_OFF);
 
     /* Enable transmit interrupt if we have any characters to
-       transmit. */
-    if (!intq_empty(&txq)) ier |= IER_XMIT;
+       transmit, unless a refill is already on its way. */
+    if (!intq_empty(&txq) && !tx_work.pending) ier |= IER_XMIT;
 
     /* Enable receive interrupt if we have room to store any
        characters we receive. */
@@ -204,11 +229,26 @@ static void serial_interrupt(struct intr_frame *f UNUSED)
     while (!input_full() && (inb(LSR_REG) & LSR_DR) != 0)
         input_putc(inb(RBR_REG));
 
-    /* As long as we have a byte to transmit, and the hardware is
-       ready to accept a byte for transmission, transmit a byte. */
-    while (!intq_empty(&txq) && (inb(LSR_REG) & LSR_THRE) != 0)
-        outb(THR_REG, intq_getc(&txq));
+    /* If we have bytes to transmit and the hardware is ready for
+       them, leave the refill to tx_work.  write_ier() masks the
+       transmit interrupt until it has run. */
+    if (!intq_empty(&txq) && (inb(LSR_REG) & LSR_THRE) != 0)
+        work_schedule(&tx_work, WORK_HIGH);
 
     /* Update interrupt enable register based on queue status. */
     write_ier();
 }
+
+/* Work function that fills the transmitter FIFO, which is empty
+   when the hardware reports THR empty, from txq. */
+static void tx_refill(void *aux UNUSED)
+{
+    enum intr_level old_level = intr_disable();
+    int i;
+
+    if ((inb(LSR_REG) & LSR_THRE) != 0)
+        for (i = 0; i < TX_FIFO_SIZE && !intq_empty(&txq); i++)
+            outb(THR_REG, intq_getc(&txq));
+    write_ier();
+    intr_set_level(old_level);
+}
@@ -5,10 +5,15 @@
 #include <round.h>
 #include <stdio.h>
 
+#include "devices/hrtimer.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#ifdef USERPROG
+#include "userprog/vdso.h"
+#endif
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -19,35 +24,71 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency. */
+#define PIT_HZ 1193180
+
+/* 8254 input clocks per timer tick, rounded to nearest. */
+#define PIT_TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Sub-tick delays shorter than this many nanoseconds busy-wait
+   even when high-resolution timers are available, since blocking
+   and being woken up again would take about as long. */
+#define SPIN_NS 2000
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Number of timer interrupts actually taken.  Lower than `ticks'
+   when tickless idle let the timer skip ticks. */
+static int64_t timer_intrs;
+
+/* Guards `ticks' and `timer_intrs', so that reading them does not
+   take interrupts off, which on SMP means taking the big kernel
+   lock.  Only timer_interrupt() writes them. */
+static struct seqlock ticks_seq;
+
+/* One-shot state of counter 0.  The PIT runs in mode 0
+   ("interrupt on terminal count") and is re-armed by every timer
+   interrupt, normally for the rest of the current tick, or for
+   several ticks when the CPU goes idle.  pit_armed is the count
+   last loaded into the counter, pit_banked the input clocks that
+   elapsed under an earlier one-shot that was re-armed before it
+   expired, and pit_residual the clocks that have elapsed past the
+   last whole tick. */
+static uint16_t pit_armed;
+static uint32_t pit_banked;
+static uint32_t pit_residual;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static void pit_arm(uint16_t count);
+static bool pit_snapshot(uint16_t *count);
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
-   interrupt PIT_FREQ times per second, and registers the
-   corresponding interrupt. */
+   interrupt TIMER_FREQ times per second, and registers the
+   corresponding interrupt.  The counter is used in one-shot
+   mode and re-armed on each interrupt, so that the idle thread
+   can stretch a single interrupt over several ticks. */
 void timer_init(void)
 {
-    /* 8254 input frequency divided by TIMER_FREQ, rounded to
-       nearest. */
-    uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-    outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
-    outb(0x40, count & 0xff);
-    outb(0x40, count >> 8);
+    seqlock_init(&ticks_seq);
+    pit_armed = 0;
+    pit_banked = 0;
+    pit_residual = 0;
+    pit_arm(PIT_TICK_COUNT);
 
     intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays,
+   then the clocks behind the high-resolution timers, which
+   replace most of them. */
 void timer_calibrate(void)
 {
     unsigned high_bit, test_bit;
@@ -70,15 +111,21 @@ void timer_calibrate(void)
         if (!too_many_loops(high_bit | test_bit)) loops_per_tick |= test_bit;
 
     printf("%'" PRIu64 " loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+    hrtimer_calibrate();
 }
 
 /* Returns the number of timer ticks since the OS booted. */
 int64_t timer_ticks(void)
 {
-    enum intr_level old_level = intr_disable();
-    int64_t t = ticks;
-    intr_set_level(old_level);
-    barrier();
+    unsigned seq;
+    int64_t t;
+
+    do
+    {
+        seq = seqlock_read_begin(&ticks_seq);
+        t = ticks;
+    } while (seqlock_read_retry(&ticks_seq, seq));
     return t;
 }
 
@@ -120,36 +167,141 @@ void timer_nsleep(int64_t ns)
 /* Prints timer statistics. */
 void timer_print_stats(void)
 {
-    printf("Timer: %" PRId64 " ticks\n", timer_ticks());
+    unsigned seq;
+    int64_t t, intrs;
+
+    do
+    {
+        seq = seqlock_read_begin(&ticks_seq);
+        t = ticks;
+        intrs = timer_intrs;
+    } while (seqlock_read_retry(&ticks_seq, seq));
+    printf("Timer: %" PRId64 " ticks, %" PRId64 " interrupts\n", t, intrs);
+}
+
+/* Called by the idle thread, with interrupts off, right before
+   it halts.  If no sleeping thread is due on the next tick,
+   stretches the pending one-shot so that the CPU is not woken
+   again until the tick on which the earliest sleeper is due,
+   as far as the 16-bit counter reaches. */
+void timer_idle_enter(void)
+{
+    uint16_t count;
+    int64_t idle_ticks;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    /* Other processors still need `ticks' to advance. */
+    if (smp_online_cnt > 1) return;
+
+    idle_ticks = thread_next_wakeup() - ticks - 1;
+    if (idle_ticks <= 0) return;
+
+    /* Already expired: the interrupt is pending, so just take it. */
+    if (pit_snapshot(&count)) return;
+
+    if (idle_ticks > (UINT16_MAX - count) / PIT_TICK_COUNT)
+        idle_ticks = (UINT16_MAX - count) / PIT_TICK_COUNT;
+    if (idle_ticks == 0) return;
+
+    pit_banked += pit_armed - count;
+    pit_arm(count + idle_ticks * PIT_TICK_COUNT);
+}
+
+/* Called by the idle thread, with interrupts off, after it
+   wakes up from `hlt'.  If the wakeup came from some other
+   device while a stretched one-shot was still counting down,
+   fires the timer right away so that `ticks' catches up with the
+   time spent halted before anyone else runs. */
+void timer_idle_exit(void)
+{
+    uint16_t count;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (pit_armed <= PIT_TICK_COUNT) return;
+    if (pit_snapshot(&count)) return;
+
+    pit_banked += pit_armed - count;
+    pit_arm(1);
 }
 
 /* Timer interrupt handler. */
 static void timer_interrupt(struct intr_frame *args UNUSED)
 {
-    ticks++;
-    thread_tick();
-    thread_wakeup();
-
-    if (thread_mlfqs)
+    uint16_t count;
+    int64_t elapsed;
+
+    /* An interrupt raised by a one-shot that was re-armed before
+       we got here has already been accounted for. */
+    if (!pit_snapshot(&count)) return;
+
+    /* The counter keeps counting down past terminal count, so the
+       clocks since expiry are folded into the next one-shot. */
+    pit_residual += pit_banked + pit_armed + (uint16_t) (0 - count);
+    pit_banked = 0;
+    elapsed = pit_residual / PIT_TICK_COUNT;
+    pit_residual %= PIT_TICK_COUNT;
+    pit_arm(PIT_TICK_COUNT - pit_residual);
+    seqlock_write_begin(&ticks_seq);
+    timer_intrs++;
+    seqlock_write_end(&ticks_seq);
+
+    /* Catch up on every tick that passed since the last interrupt. */
+    while (elapsed-- > 0)
     {
-        // 매 틱마다: recent_cpu 증가
-        mlfqs_increment_recent_cpu();
+        seqlock_write_begin(&ticks_seq);
+        ticks++;
+        seqlock_write_end(&ticks_seq);
+#ifdef USERPROG
+        vdso_tick(ticks);
+#endif
+        thread_tick();
+        thread_wakeup();
 
-        // 초당 1회: load_avg와 recent_cpu 갱신
-        if (ticks % TIMER_FREQ == 0)
+        if (thread_mlfqs)
         {
-            mlfqs_update_load_avg();
-            mlfqs_update_recent_cpu();
-        }
+            // 매 틱마다: recent_cpu 증가
+            mlfqs_increment_recent_cpu();
 
-        // 매 4틱마다: 모든 스레드의 priority 재계산
-        if (ticks % 4 == 0)
-        {
-            mlfqs_recalculate_priority_all();
+            // 초당 1회: load_avg와 recent_cpu 갱신 (워커 스레드에 맡긴다)
+            if (ticks % TIMER_FREQ == 0) mlfqs_second();
+
+            // 매 4틱마다: 실행 중인 스레드의 priority 재계산
+            if (ticks % 4 == 0)
+            {
+                mlfqs_recalculate_priority();
+            }
         }
     }
 }
 
+/* Loads COUNT into counter 0 in mode 0, so that it raises IRQ 0
+   once after COUNT input clocks. */
+static void pit_arm(uint16_t count)
+{
+    ASSERT(count > 0);
+
+    outb(0x43, 0x30); /* CW: counter 0, LSB then MSB, mode 0, binary. */
+    outb(0x40, count & 0xff);
+    outb(0x40, count >> 8);
+    pit_armed = count;
+}
+
+/* Latches counter 0's status and count at the same instant,
+   stores the count in *COUNT, and returns true if the armed
+   one-shot has reached terminal count (OUT is high). */
+static bool pit_snapshot(uint16_t *count)
+{
+    uint8_t status;
+
+    outb(0x43, 0xc2); /* Read-back: latch count and status, counter 0. */
+    status = inb(0x40);
+    *count = inb(0x40);
+    *count |= inb(0x40) << 8;
+    return (status & 0x80) != 0;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool too_many_loops(unsigned loops)
@@ -198,6 +350,13 @@ static void real_time_sleep(int64_t num, int32_t denom)
            processes. */
         timer_sleep(ticks);
     }
+    else if (hrtimer_available() && num * (1000000000 / denom) >= SPIN_NS)
+    {
+        /* Otherwise, block on a high-resolution timer if we
+           can.  DENOM divides 10**9, and NUM / DENOM seconds is
+           less than a tick, so this does not overflow. */
+        hrtimer_sleep(num * (1000000000 / denom));
+    }
     else
     {
         /* Otherwise, use a busy-wait loop for more accurate
@@ -7,7 +7,9 @@
 
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -54,13 +56,27 @@ static disk_sector_t byte_to_sector(const struct inode *inode, off_t pos)
 }
 
 /* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
+ * returns the same `struct inode'.  Opening an inode that is
+ * already open only reads the list, so it takes the lock for
+ * reading.  The `open_cnt' and `deny_write_cnt' of an inode may
+ * also be changed by threads holding it for reading, or not at
+ * all, so they are only changed with interrupts off. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* Cache that `struct inode's are allocated from. */
+static struct kmem_cache *inode_cache;
+
+static struct inode *open_inodes_find(disk_sector_t sector);
 
 /* Initializes the inode module. */
 void inode_init(void)
 {
     list_init(&open_inodes);
+    rwlock_init(&open_inodes_lock);
+    rwlock_set_name(&open_inodes_lock, "open_inodes");
+    inode_cache = kmem_cache_create("inode", sizeof(struct inode), NULL);
+    if (inode_cache == NULL) PANIC("out of memory for inode cache");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -108,39 +124,61 @@ bool inode_create(disk_sector_t sector, off_t length)
  * Returns a null pointer if memory allocation fails. */
 struct inode *inode_open(disk_sector_t sector)
 {
-    struct list_elem *e;
     struct inode *inode;
 
     /* Check whether this inode is already open. */
-    for (e = list_begin(&open_inodes); e != list_end(&open_inodes);
-         e = list_next(e))
+    rwlock_read_acquire(&open_inodes_lock);
+    inode = inode_reopen(open_inodes_find(sector));
+    rwlock_read_release(&open_inodes_lock);
+    if (inode != NULL) return inode;
+
+    /* Check again, since somebody may have opened it while we
+     * did not hold the lock. */
+    rwlock_write_acquire(&open_inodes_lock);
+    inode = inode_reopen(open_inodes_find(sector));
+    if (inode == NULL)
     {
-        inode = list_entry(e, struct inode, elem);
-        if (inode->sector == sector)
+        /* Allocate memory. */
+        inode = kmem_cache_alloc(inode_cache);
+        if (inode != NULL)
         {
-            inode_reopen(inode);
-            return inode;
+            /* Initialize. */
+            list_push_front(&open_inodes, &inode->elem);
+            inode->sector = sector;
+            inode->open_cnt = 1;
+            inode->deny_write_cnt = 0;
+            inode->removed = false;
+            disk_read(filesys_disk, inode->sector, &inode->data);
         }
     }
-
-    /* Allocate memory. */
-    inode = malloc(sizeof *inode);
-    if (inode == NULL) return NULL;
-
-    /* Initialize. */
-    list_push_front(&open_inodes, &inode->elem);
-    inode->sector = sector;
-    inode->open_cnt = 1;
-    inode->deny_write_cnt = 0;
-    inode->removed = false;
-    disk_read(filesys_disk, inode->sector, &inode->data);
+    rwlock_write_release(&open_inodes_lock);
     return inode;
 }
 
+/* Returns the open inode for SECTOR, or a null pointer if it is
+ * not open.  open_inodes_lock must be held. */
+static struct inode *open_inodes_find(disk_sector_t sector)
+{
+    struct list_elem *e;
+
+    for (e = list_begin(&open_inodes); e != list_end(&open_inodes);
+         e = list_next(e))
+    {
+        struct inode *inode = list_entry(e, struct inode, elem);
+        if (inode->sector == sector) return inode;
+    }
+    return NULL;
+}
+
 /* Reopens and returns INODE. */
 struct inode *inode_reopen(struct inode *inode)
 {
-    if (inode != NULL) inode->open_cnt++;
+    if (inode != NULL)
+    {
+        enum intr_level old_level = intr_disable();
+        inode->open_cnt++;
+        intr_set_level(old_level);
+    }
     return inode;
 }
 
@@ -155,15 +193,24 @@ disk_sector_t inode_get_inumber(const struct inode *inode)
  * If INODE was also a removed inode, frees its blocks. */
 void inode_close(struct inode *inode)
 {
+    enum intr_level old_level;
+    bool last;
+
     /* Ignore null pointer. */
     if (inode == NULL) return;
 
+    /* Hold the lock for writing, so that nobody can find INODE in
+     * the list and reopen it once the count has dropped to 0. */
+    rwlock_write_acquire(&open_inodes_lock);
+    old_level = intr_disable();
+    last = --inode->open_cnt == 0;
+    intr_set_level(old_level);
+    if (last) list_remove(&inode->elem);
+    rwlock_write_release(&open_inodes_lock);
+
     /* Release resources if this was the last opener. */
-    if (--inode->open_cnt == 0)
+    if (last)
     {
-        /* Remove from inode list and release lock. */
-        list_remove(&inode->elem);
-
         /* Deallocate blocks if removed. */
         if (inode->removed)
         {
@@ -172,7 +219,7 @@ void inode_close(struct inode *inode)
                              bytes_to_sectors(inode->data.length));
         }
 
-        free(inode);
+        kmem_cache_free(inode_cache, inode);
     }
 }
 
@@ -305,8 +352,10 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
    May be called at most once per inode opener. */
 void inode_deny_write(struct inode *inode)
 {
+    enum intr_level old_level = intr_disable();
     inode->deny_write_cnt++;
     ASSERT(inode->deny_write_cnt <= inode->open_cnt);
+    intr_set_level(old_level);
 }
 
 /* Re-enables writes to INODE.
@@ -314,9 +363,11 @@ void inode_deny_write(struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void inode_allow_write(struct inode *inode)
 {
+    enum intr_level old_level = intr_disable();
     ASSERT(inode->deny_write_cnt > 0);
     ASSERT(inode->deny_write_cnt <= inode->open_cnt);
     inode->deny_write_cnt--;
+    intr_set_level(old_level);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
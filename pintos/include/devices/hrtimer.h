@@ -0,0 +1,35 @@
+#ifndef DEVICES_HRTIMER_H
+#define DEVICES_HRTIMER_H
+
+#include <heap.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Called when a high-resolution timer expires, in interrupt
+   context with interrupts off, with the AUX passed to
+   hrtimer_init(). */
+typedef void hrtimer_func(void *aux);
+
+/* High-resolution timer.  Expiry times are in nanoseconds on the
+   clock that hrtimer_now() reads. */
+struct hrtimer
+{
+    struct heap_elem elem; /* Element in the pending timers. */
+    uint64_t expires;      /* When to call `func'. */
+    hrtimer_func *func;    /* Function to call. */
+    void *aux;             /* Its argument. */
+    bool pending;          /* Started and not yet expired? */
+};
+
+void hrtimer_calibrate(void);
+bool hrtimer_available(void);
+uint64_t hrtimer_now(void);
+void hrtimer_clock(uint64_t *tsc_base, uint64_t *tsc_mult);
+
+void hrtimer_init(struct hrtimer *, hrtimer_func *, void *aux);
+void hrtimer_start(struct hrtimer *, uint64_t expires);
+bool hrtimer_cancel(struct hrtimer *);
+
+void hrtimer_sleep(uint64_t ns);
+
+#endif /* devices/hrtimer.h */
@@ -0,0 +1,72 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue.
+ *
+ * This is a pairing heap.  Like the doubly linked list in list.h,
+ * it does not require use of dynamically allocated memory:
+ * each structure that is a potential heap element must embed a
+ * struct heap_elem member, and heap_entry() converts from a
+ * struct heap_elem back to the structure object that contains
+ * it.
+ *
+ * The heap is ordered by a heap_less_func supplied to heap_init().
+ * heap_top() returns the greatest element, so with a comparison
+ * on priority the heap hands out the highest priority first.
+ *
+ * Amortized costs, for a heap of N elements:
+ *
+ *   - heap_push(), heap_top(): O(1).
+ *
+ *   - heap_pop(), heap_remove(), heap_update(): O(log N).
+ *
+ * An element's key may only change while it is out of the heap,
+ * or if heap_update() is called right after the change, before
+ * any other operation on the heap. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+{
+    struct heap_elem *child;   /* Leftmost child. */
+    struct heap_elem *sibling; /* Next sibling to the right. */
+    struct heap_elem *prev;    /* Left sibling, or parent if leftmost. */
+};
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER) \
+    ((STRUCT *) ((uint8_t *) (HEAP_ELEM) - offsetof(STRUCT, MEMBER)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func(const struct heap_elem *a,
+                            const struct heap_elem *b, void *aux);
+
+/* Heap. */
+struct heap
+{
+    struct heap_elem *root; /* Greatest element, or null if empty. */
+    size_t size;            /* Number of elements. */
+    heap_less_func *less;   /* Comparison function. */
+    void *aux;              /* Auxiliary data for `less'. */
+};
+
+void heap_init(struct heap *, heap_less_func *, void *aux);
+
+bool heap_empty(const struct heap *);
+size_t heap_size(const struct heap *);
+struct heap_elem *heap_top(const struct heap *);
+
+void heap_push(struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop(struct heap *);
+void heap_remove(struct heap *, struct heap_elem *);
+void heap_update(struct heap *, struct heap_elem *);
+
+#endif /* lib/kernel/heap.h */
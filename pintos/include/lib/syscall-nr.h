@@ -37,6 +37,18 @@ enum
 
     SYS_MOUNT,
     SYS_UMOUNT,
+
+    /* Real-time scheduling. */
+    SYS_SCHED_DEADLINE, /* Join or leave the EDF scheduling class. */
+    SYS_SCHED_WAIT,     /* End this period's EDF job. */
+
+    /* User-space synchronization. */
+    SYS_FUTEX, /* Wait on or wake up a futex. */
+
+    /* User threads. */
+    SYS_CLONE,       /* Start a thread in this process. */
+    SYS_JOIN,        /* Wait for a thread to exit. */
+    SYS_EXIT_THREAD, /* End the calling thread. */
 };
 
 #endif /* lib/syscall-nr.h */
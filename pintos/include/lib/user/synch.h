@@ -0,0 +1,35 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* Mutex.  Locking and unlocking an uncontended mutex take a
+   single atomic instruction and no system call. */
+struct mutex
+{
+    int state; /* 0: unlocked, 1: locked, 2: locked, maybe waiters. */
+};
+
+#define MUTEX_INITIALIZER {0}
+
+void mutex_init(struct mutex *);
+void mutex_lock(struct mutex *);
+bool mutex_trylock(struct mutex *);
+void mutex_unlock(struct mutex *);
+
+/* Condition variable, to be used with a mutex.  Signaling one that
+   nobody waits on makes no system call. */
+struct condvar
+{
+    int seq;     /* Incremented by every signal. */
+    int waiters; /* Number of threads in condvar_wait(). */
+};
+
+#define CONDVAR_INITIALIZER {0, 0}
+
+void condvar_init(struct condvar *);
+void condvar_wait(struct condvar *, struct mutex *);
+void condvar_signal(struct condvar *);
+void condvar_broadcast(struct condvar *);
+
+#endif /* lib/user/synch.h */
@@ -50,6 +50,20 @@ bool isdir(int fd);
 int inumber(int fd);
 int symlink(const char *target, const char *linkpath);
 
+/* Real-time scheduling. */
+bool sched_deadline(int runtime, int period);
+int sched_wait(void);
+
+/* Futexes, for user-space locks.  See <synch.h>. */
+#define FUTEX_WAIT 0 /* Sleep while *UADDR == VAL. */
+#define FUTEX_WAKE 1 /* Wake up to VAL waiters on UADDR. */
+int futex(int *uaddr, int op, int val);
+
+/* User threads.  See <thread.h>. */
+int clone(void (*entry)(void *), void *aux, void *stack, void *tls);
+int join(int tid);
+void exit_thread(int status) NO_RETURN;
+
 static inline void *get_phys_addr(void *user_addr)
 {
     void *pa;
@@ -0,0 +1,42 @@
+#ifndef __LIB_USER_THREAD_H
+#define __LIB_USER_THREAD_H
+
+#include <debug.h>
+#include <stddef.h>
+
+/* Threads of a user process.
+
+   They share the process's memory and file descriptors.  exit()
+   in any of them ends the whole process, the others exiting the
+   next time they enter or leave the kernel.  A thread blocked in
+   the kernel for some other reason, such as waiting for a child
+   process or for keyboard input, finishes waiting first.
+   thread_exit() ends only the calling thread, except in the main
+   thread, where it is exit().  Returning from the thread function
+   is thread_exit(0).
+
+   A thread can only be joined by the thread that created it, and
+   only once. */
+
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
+typedef void thread_func(void *aux);
+
+tid_t thread_create(thread_func *, void *aux, void *stack, size_t size,
+                    void *tls);
+int thread_join(tid_t);
+void thread_exit(int status) NO_RETURN;
+
+/* Returns the calling thread's TLS pointer, the TLS argument of
+   thread_create().  As the x86-64 ABI requires, the first word of
+   the TLS block must hold the block's own address. */
+static inline void *thread_tls(void)
+{
+    void *tls;
+    asm("movq %%fs:0, %0" : "=r"(tls));
+    return tls;
+}
+
+#endif /* lib/user/thread.h */
@@ -0,0 +1,14 @@
+#ifndef __LIB_USER_VDSO_H
+#define __LIB_USER_VDSO_H
+
+#include <stdint.h>
+
+/* Reads of the clock and of the process id that do not enter the
+   kernel.  They read pages the kernel maps into every process. */
+
+int getpid(void);
+int64_t clock_ticks(void);
+int clock_freq(void);
+uint64_t clock_ns(void);
+
+#endif /* lib/user/vdso.h */
@@ -0,0 +1,39 @@
+#ifndef __LIB_VDSO_DATA_H
+#define __LIB_VDSO_DATA_H
+
+#include <stdint.h>
+
+/* Pages the kernel maps read-only into every user process, so
+   that it can read the clock and its own pid without a system
+   call.  Shared between the kernel and user programs. */
+
+/* User virtual address of the first page, just above the top of
+   the user stack, and the number of pages. */
+#define VDSO_ADDR 0x47480000
+#define VDSO_PAGES 2
+
+/* First page, shared by all processes.  The kernel updates it on
+   every timer tick.  A reader copies what it needs between two
+   reads of `seq', retrying while `seq' is odd or has changed, as
+   with a kernel struct seqlock. */
+struct vdso_clock
+{
+    uint32_t seq;        /* Odd while the kernel is writing. */
+    uint32_t timer_freq; /* Timer ticks per second. */
+    int64_t ticks;       /* Timer ticks since the OS booted. */
+    uint64_t tsc_base;   /* TSC when the nanosecond clock read 0. */
+    uint64_t tsc_mult;   /* Nanoseconds per TSC cycle, times 2**32,
+                            or 0 before the TSC is calibrated. */
+};
+
+/* Second page, private to the process. */
+struct vdso_process
+{
+    int pid; /* Process id, as returned by fork(). */
+};
+
+#define VDSO_CLOCK ((const volatile struct vdso_clock *) VDSO_ADDR)
+#define VDSO_PROCESS \
+    ((const volatile struct vdso_process *) (VDSO_ADDR + 4096))
+
+#endif /* lib/vdso-data.h */
@@ -0,0 +1,14 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+
+struct thread;
+
+void fpu_init(void);
+void fpu_init_ap(void);
+void fpu_switch(struct thread *prev, struct thread *next);
+bool fpu_copy(struct thread *dst, const struct thread *src);
+void fpu_release(struct thread *);
+
+#endif /* threads/fpu.h */
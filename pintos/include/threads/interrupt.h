@@ -15,6 +15,7 @@ enum intr_level intr_get_level(void);
 enum intr_level intr_set_level(enum intr_level);
 enum intr_level intr_enable(void);
 enum intr_level intr_disable(void);
+void intr_wait(void);
 
 /* Interrupt stack frame. */
 struct gp_registers
@@ -69,6 +70,7 @@ struct intr_frame
 typedef void intr_handler_func(struct intr_frame *);
 
 void intr_init(void);
+void intr_init_ap(void);
 void intr_register_ext(uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int(uint8_t vec, int dpl, enum intr_level,
                        intr_handler_func *, const char *name);
@@ -78,4 +80,10 @@ void intr_yield_on_return(void);
 void intr_dump_frame(const struct intr_frame *);
 const char *intr_name(uint8_t vec);
 
+/* With -o intrstat, every external interrupt handler is timed
+   from entry to end of interrupt, all of which it spends with
+   interrupts off. */
+extern bool intrstat_enabled;
+void intr_print_stats(void);
+
 #endif /* threads/interrupt.h */
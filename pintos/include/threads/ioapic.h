@@ -0,0 +1,12 @@
+#ifndef THREADS_IOAPIC_H
+#define THREADS_IOAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void ioapic_init(uint64_t base, uint32_t gsi_base);
+bool ioapic_present(void);
+void ioapic_override(uint8_t irq, uint32_t gsi, uint16_t flags);
+void ioapic_route(uint8_t irq, uint8_t vec, uint8_t apic_id);
+
+#endif /* threads/ioapic.h */
@@ -0,0 +1,25 @@
+#ifndef THREADS_LAPIC_H
+#define THREADS_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Default physical address of the local APIC registers. */
+#define LAPIC_DEFAULT_BASE 0xfee00000
+
+void lapic_init(uint64_t base);
+bool lapic_present(void);
+void lapic_enable(void);
+void lapic_mask_lint0(void);
+uint8_t lapic_id(void);
+void lapic_eoi(void);
+
+void lapic_send_ipi(uint8_t apic_id, uint8_t vec);
+void lapic_send_init(uint8_t apic_id);
+void lapic_send_startup(uint8_t apic_id, uint64_t pa);
+
+uint32_t lapic_timer_calibrate(void);
+void lapic_timer_start(uint32_t count);
+void lapic_timer_oneshot(uint8_t vec, uint32_t count);
+
+#endif /* threads/lapic.h */
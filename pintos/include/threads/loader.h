@@ -11,6 +11,10 @@
 /* Kernel virtual address at which all physical memory is mapped. */
 #define LOADER_PHYS_BASE 0x200000
 
+/* Bytes of physical memory, from 0, that start.S maps before
+   paging_init() builds the kernel's own page tables. */
+#define LOADER_BOOT_MAP_SIZE 0x10000000
+
 /* Multiboot infos */
 #define MULTIBOOT_INFO 0x7000
 #define MULTIBOOT_FLAG MULTIBOOT_INFO
@@ -26,6 +30,11 @@
 #define LOADER_ARG_CNT (LOADER_ARGS - LOADER_ARG_CNT_LEN) /* Number of args. \
                                                            */
 
+/* Physical address to which application processors are started
+   (see ap_trampoline in start.S).  Must be page-aligned and below
+   1 MB, since APs begin in real mode. */
+#define AP_TRAMPOLINE 0x8000
+
 /* Sizes of loader data structures. */
 #define LOADER_SIG_LEN 2
 #define LOADER_ARGS_LEN 128
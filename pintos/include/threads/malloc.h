@@ -10,4 +10,13 @@ void *calloc(size_t, size_t) __attribute__((malloc));
 void *realloc(void *, size_t);
 void free(void *);
 
+/* Object caches. */
+struct kmem_cache;
+typedef void kmem_ctor_func(void *obj);
+struct kmem_cache *kmem_cache_create(const char *name, size_t size,
+                                     kmem_ctor_func *);
+void *kmem_cache_alloc(struct kmem_cache *) __attribute__((malloc));
+void kmem_cache_free(struct kmem_cache *, void *);
+size_t kmem_cache_slab_cnt(struct kmem_cache *);
+
 #endif /* threads/malloc.h */
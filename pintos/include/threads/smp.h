@@ -0,0 +1,56 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "threads/loader.h"
+
+/* Maximum number of processors that we bring up. */
+#define SMP_MAX_CPUS 8
+
+/* Local APIC interrupt vectors.  They sit above the vectors used
+   by the PICs and the system call gate, and count as external
+   interrupts (see intr_register_ext()). */
+#define LAPIC_VEC_TIMER 0xf0    /* Local APIC timer. */
+#define LAPIC_VEC_RESCHED 0xf1  /* Reschedule IPI. */
+#define LAPIC_VEC_HRTIMER 0xf2  /* BSP's local APIC timer, hrtimers. */
+#define LAPIC_VEC_SPURIOUS 0xff /* Spurious interrupt. */
+
+struct thread;
+
+/* Per-CPU state.
+
+   Each processor finds its own `struct cpu' through the `cpu'
+   member of the thread it is running (see this_cpu() in
+   thread.c), which the scheduler updates whenever it switches
+   threads on that processor.  Members are only touched by their
+   own processor, except for `current' and `started', which are
+   read by others under the big kernel lock. */
+struct cpu
+{
+    int id;                 /* Index in cpus[], 0 for the BSP. */
+    uint8_t lapic_id;       /* Local APIC ID, the target of IPIs. */
+    volatile bool started;  /* Has this CPU entered the scheduler? */
+    struct thread *idle;    /* This CPU's idle thread. */
+    struct thread *current; /* Thread this CPU is running. */
+    unsigned thread_ticks;  /* # of timer ticks since last yield. */
+    int64_t local_ticks;    /* # of local APIC timer ticks. */
+    bool in_external_intr;  /* Processing an external interrupt? */
+    bool yield_on_return;   /* Should we yield on interrupt return? */
+    void *tss;              /* Task-state segment (userprog only). */
+    struct thread *fpu_owner; /* Thread whose state is in the FPU. */
+    uint64_t gdt[SEL_CNT];  /* Global descriptor table. */
+};
+
+extern struct cpu cpus[SMP_MAX_CPUS];
+extern int smp_cpu_cnt;    /* # of CPUs found. */
+extern int smp_online_cnt; /* # of CPUs running the scheduler. */
+
+struct cpu *this_cpu(void);
+
+void smp_init(void);
+void smp_start(void);
+void smp_reschedule(const struct thread *);
+
+#endif /* threads/smp.h */
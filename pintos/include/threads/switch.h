@@ -0,0 +1,36 @@
+#ifndef THREADS_SWITCH_H
+#define THREADS_SWITCH_H
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+
+struct thread;
+
+/* switch_threads()'s stack frame: the callee-saved registers,
+   which are all a kernel thread that calls schedule() has to
+   keep, and the address to return to. */
+struct switch_threads_frame
+{
+    uint64_t r15;       /*  0: Saved %r15. */
+    uint64_t r14;       /*  8: Saved %r14. */
+    uint64_t r13;       /* 16: Saved %r13. */
+    uint64_t r12;       /* 24: Saved %r12. */
+    uint64_t rbp;       /* 32: Saved %rbp. */
+    uint64_t rbx;       /* 40: Saved %rbx. */
+    void (*rip)(void);  /* 48: Return address. */
+};
+
+/* Switches from CUR, which must be the running thread, to NEXT,
+   which must also be running switch_threads() or be a new
+   thread whose stack holds a frame that returns to
+   switch_entry().  Interrupts must be off. */
+void switch_threads(struct thread *cur, struct thread *next);
+
+/* First code a new thread runs.  Calls the function that
+   thread_create() left in %r14 of the thread's
+   switch_threads_frame, that is, kernel_thread(), with the
+   arguments it left in %r12 and %r13. */
+void switch_entry(void);
+#endif
+
+#endif /* threads/switch.h */
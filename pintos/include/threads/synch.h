@@ -1,17 +1,21 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
 
 /* A counting semaphore. */
 struct semaphore
 {
-    unsigned value;      /* Current value. */
-    struct list waiters; /* List of waiting threads. */
+    unsigned value;         /* Current value. */
+    struct heap waiters;    /* Waiting threads, highest priority on top. */
+    int64_t waiters_epoch;  /* MLFQS epoch of the stalest waiter. */
+    struct lock_stat *stat; /* Contention statistics, or null. */
 };
 
 void sema_init(struct semaphore *, unsigned value);
+void sema_set_name(struct semaphore *, const char *name);
 void sema_down(struct semaphore *);
 bool sema_try_down(struct semaphore *);
 void sema_up(struct semaphore *);
@@ -20,15 +24,20 @@ void sema_self_test(void);
 /* Lock. */
 struct lock
 {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *holder;      /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct heap_elem held_elem; /* Element in holder's `held_locks'. */
 };
 
 void lock_init(struct lock *);
+void lock_set_name(struct lock *, const char *name);
 void lock_acquire(struct lock *);
 bool lock_try_acquire(struct lock *);
 void lock_release(struct lock *);
 bool lock_held_by_current_thread(const struct lock *);
+int lock_priority(const struct lock *);
+bool lock_priority_less(const struct heap_elem *, const struct heap_elem *,
+                        void *aux);
 
 /* Condition variable. */
 struct condition
@@ -41,6 +50,86 @@ void cond_wait(struct condition *, struct lock *);
 void cond_signal(struct condition *, struct lock *);
 void cond_broadcast(struct condition *, struct lock *);
 
+/* Readers-writer lock.
+
+   Any number of readers, or a single writer, may hold it at once.
+   It prefers writers: once a writer is waiting, new readers wait
+   behind it, so a stream of readers cannot starve writers.
+   Neither side may acquire it recursively. */
+struct rwlock
+{
+    struct lock lock;         /* Held by the writer, briefly by readers. */
+    unsigned readers;         /* Number of threads holding it to read. */
+    bool draining;            /* Writer waiting for the readers to leave? */
+    struct semaphore drained; /* Upped when the last of them leaves. */
+};
+
+void rwlock_init(struct rwlock *);
+void rwlock_set_name(struct rwlock *, const char *name);
+void rwlock_read_acquire(struct rwlock *);
+void rwlock_read_release(struct rwlock *);
+void rwlock_write_acquire(struct rwlock *);
+void rwlock_write_release(struct rwlock *);
+bool rwlock_write_held_by_current_thread(const struct rwlock *);
+
+/* Sequence lock.
+
+   For small, read-mostly records.  Readers never block or write
+   anything: they copy the record and retry if a writer was active
+   meanwhile.
+
+       unsigned seq;
+       do
+         {
+           seq = seqlock_read_begin (&sl);
+           ...copy the record...
+         }
+       while (seqlock_read_retry (&sl, seq));
+
+   Writers must exclude each other by other means, for example by
+   running with interrupts off.  A reader waits while a write is
+   in progress, so nothing that reads may interrupt a writer. */
+struct seqlock
+{
+    unsigned seq; /* Odd while a write is in progress. */
+};
+
+void seqlock_init(struct seqlock *);
+unsigned seqlock_read_begin(const struct seqlock *);
+bool seqlock_read_retry(const struct seqlock *, unsigned seq);
+void seqlock_write_begin(struct seqlock *);
+void seqlock_write_end(struct seqlock *);
+
+/* Lock contention statistics.
+
+   With -o lockstat, every lock or semaphore that has been given a
+   name with lock_set_name() or sema_set_name() counts its
+   acquisitions, how many of them had to block, and the timer
+   ticks spent waiting for it and, for locks, holding it.
+   Unnamed ones, and all of them without the option, pay only for
+   testing a null pointer. */
+extern bool lockstat_enabled;
+void lockstat_print_stats(void);
+
+/* Spinlock.
+
+   Busy-waits instead of blocking, so unlike a lock it may be
+   acquired with interrupts off and by code that cannot sleep,
+   such as the scheduler.  It is only useful for excluding other
+   processors: a thread that spins on a spinlock held by another
+   thread on the same processor spins forever.  Everything above
+   is built on disabling interrupts, which interrupt.c turns into
+   holding the big kernel spinlock. */
+struct spinlock
+{
+    volatile int locked; /* 1 if held, 0 if free. */
+};
+
+void spinlock_init(struct spinlock *);
+void spinlock_acquire(struct spinlock *);
+bool spinlock_try_acquire(struct spinlock *);
+void spinlock_release(struct spinlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -40,9 +40,13 @@ enum fd_type
     FD_DIR,
 };
 
+/* An open file descriptor.  A process's threads share its fd
+   table, so a system call holds a reference to the entry it is
+   using, and the entry is closed when the last one is dropped. */
 struct uni_file
 {
     enum fd_type fd_type;
+    int ref_cnt; /* Table slot plus system calls using it. */
     union
     {
         struct file *file;
@@ -51,6 +55,9 @@ struct uni_file
     } data;
 };
 
+/* Cache that `struct uni_file's are allocated from. */
+extern struct kmem_cache *uni_file_cache;
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -103,11 +110,15 @@ struct uni_file
  * set to THREAD_MAGIC.  Stack overflow will normally change this
  * value, triggering the assertion. */
 /* The `elem' member has a dual purpose.  It can be an element in
- * the run queue (thread.c), or it can be an element in a
- * semaphore wait list (synch.c).  It can be used these two ways
- * only because they are mutually exclusive: only a thread in the
- * ready state is on the run queue, whereas only a thread in the
- * blocked state is on a semaphore wait list. */
+ * the run queue (thread.c), or it can be an element in the
+ * sleep wheel (thread.c).  It can be used these two ways only
+ * because they are mutually exclusive: only a thread in the
+ * ready state is on the run queue, whereas only a blocked
+ * thread is in the sleep wheel.  A thread blocked on a semaphore
+ * (synch.c) is in the semaphore's waiter heap through
+ * `wait_elem' instead, and a ready thread in the EDF class, or
+ * any ready thread under the CFS, is in a run queue through
+ * `run_elem'. */
 struct thread
 {
     /* Owned by thread.c. */
@@ -118,8 +129,21 @@ struct thread
     int original_priority;     /* Origninal Priority. */
     int nice;                  /* Nice value for MLFQS */
     int recent_cpu;            /* Recent CPU usage for MLFQS (fixed-point) */
+    int64_t recent_cpu_epoch;  /* Last decay applied to recent_cpu. */
     int64_t wakeup_tick;
-    struct list donor_list;
+    int64_t vruntime;          /* Weighted CPU time, for the CFS. */
+    struct heap_elem run_elem; /* Element in the CFS run queue. */
+    int64_t run_seq;           /* Breaks ties in the CFS run queue. */
+    int64_t edf_runtime;       /* EDF budget per period, in ticks. */
+    int64_t edf_period;        /* EDF period in ticks, 0 if not EDF. */
+    int64_t edf_deadline;      /* End of the current EDF period. */
+    int64_t edf_budget;        /* EDF budget left in this period. */
+    bool edf_pending;          /* Job of this period not done yet? */
+    int edf_misses;            /* # of EDF deadlines missed. */
+    struct heap_elem edf_elem; /* Element in EDF deadline timeline. */
+    uint64_t ready_tsc;        /* TSC when last made ready. */
+    int ready_kind;            /* Why it was made ready (SCHEDLAT_*). */
+    struct heap held_locks;    /* Locks held, by priority of top waiter. */
     struct lock *wait_on_lock; /* 현재 스레드가 어떤 lock을 대기하고 있는지에
                                   대한 정보 */
     struct list child_list;
@@ -135,14 +159,21 @@ struct thread
     struct file *executing_file;
 
     /* Shared between thread.c and synch.c. */
-    struct list_elem elem; /* List element. */
-    struct list_elem donor_elem;
+    struct list_elem elem;      /* List element. */
+    struct heap_elem wait_elem; /* Element in a semaphore's waiters. */
+    struct heap *wait_heap;     /* Heap that wait_elem is in, if any. */
+    int64_t wait_seq;           /* Breaks ties between equal waiters. */
     struct list_elem child_elem;
     struct list_elem all_elem; /* Element in all threads list. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
-    uint64_t *pml4; /* Page map level 4 */
+    uint64_t *pml4;                /* Page map level 4 */
+    struct process *process;       /* Shared with its other threads. */
+    struct list_elem process_elem; /* Element in the process's threads. */
+    bool cloned;                   /* Created by clone(), not fork()? */
+    bool killed;                   /* Exit on the way back to user mode? */
+    uint64_t fs_base;              /* User FS base, for TLS. */
 #endif
 #ifdef VM
     /* Table for whole virtual memory owned by thread. */
@@ -150,7 +181,11 @@ struct thread
 #endif
 
     /* Owned by thread.c. */
-    struct intr_frame tf; /* Information for switching */
+    struct cpu *cpu;      /* Processor that last ran this thread,
+                             whose ready queue it goes on. */
+    void *fpu;            /* FPU state save area, or null if unused. */
+    struct cpu *fpu_cpu;  /* Processor that last loaded `fpu'. */
+    uint8_t *stack;       /* Saved stack pointer, for switch_threads(). */
     unsigned magic;       /* Detects stack overflow. */
 };
 
@@ -159,16 +194,38 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the completely fair scheduler, which ignores
+   priorities and divides the CPU in proportion to weights derived
+   from `nice'.  Controlled by kernel command-line option
+   "-o cfs". */
+extern bool thread_cfs;
+
+/* Scheduling latency histograms, kept with -o schedlat.  For each
+   kind of latency and each priority (or, under the MLFQS, each
+   nice value plus 20), bucket B counts the waits of between 2**B
+   and 2**(B+1) - 1 TSC cycles; bucket 0 also counts waits of 0
+   cycles. */
+enum schedlat_kind
+{
+    SCHEDLAT_WAKEUP,  /* From thread_unblock() to running. */
+    SCHEDLAT_PREEMPT, /* From thread_yield() to running again. */
+    SCHEDLAT_KIND_CNT
+};
+#define SCHEDLAT_BUCKETS 40
+extern bool schedlat_enabled;
+
 void thread_init(void);
 void thread_start(void);
 
+struct cpu;
+void thread_init_ap(void);
+void *thread_prepare_ap(struct cpu *);
+void thread_start_ap(void) NO_RETURN;
+
 void thread_tick(void);
 void thread_sleep(int64_t ticks);
-bool wakeup_tick_less(const struct list_elem *a_, const struct list_elem *b_,
-                      void *aux UNUSED);
-bool priority_large(const struct list_elem *a_, const struct list_elem *b_,
-                    void *aux UNUSED);
 void thread_wakeup(void);
+int64_t thread_next_wakeup(void);
 
 void thread_print_stats(void);
 
@@ -185,15 +242,23 @@ const char *thread_name(void);
 void thread_exit(void) NO_RETURN;
 void thread_yield_safe(void);
 void thread_yield(void);
+void thread_preempt_on_return(void);
 
 int thread_get_priority(void);
 void thread_set_priority(int);
+void thread_change_priority(struct thread *t, int priority);
+int thread_effective_priority(const struct thread *t);
 
 void mlfqs_calculate_priority(struct thread *t);
 void mlfqs_increment_recent_cpu(void);
-void mlfqs_update_recent_cpu(void);
-void mlfqs_update_load_avg(void);
-void mlfqs_recalculate_priority_all(void);
+void mlfqs_second(void);
+void mlfqs_recalculate_priority(void);
+void mlfqs_refresh(struct thread *t);
+int64_t mlfqs_get_epoch(void);
+
+bool thread_set_deadline(int64_t runtime, int64_t period);
+void thread_deadline_wait(void);
+int thread_get_deadline_misses(void);
 
 int thread_get_nice(void);
 void thread_set_nice(int);
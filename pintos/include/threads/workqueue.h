@@ -0,0 +1,40 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+
+/* Deferred work.
+
+   An interrupt handler that has more to do than acknowledge its
+   device and capture what it needs can put the rest in a work
+   item and schedule it.  The item's function then runs in a
+   kernel worker thread, with interrupts on unless it turns them
+   off itself, where it may also sleep. */
+
+/* Worker thread classes, one worker thread each. */
+enum work_class
+{
+    WORK_HIGH,   /* Above every ordinary thread. */
+    WORK_NORMAL, /* At the default priority. */
+    WORK_CLASS_CNT
+};
+
+typedef void work_func(void *aux);
+
+/* A work item.  Owned by its user, who must keep it around while
+   it is scheduled. */
+struct work
+{
+    struct list_elem elem; /* Element in a workqueue. */
+    work_func *func;       /* Function to run. */
+    void *aux;             /* Argument for FUNC. */
+    bool pending;          /* Scheduled but not yet started? */
+};
+
+void workqueue_init(void);
+void work_init(struct work *, work_func *, void *aux);
+bool work_schedule(struct work *, enum work_class);
+void workqueue_print_stats(void);
+
+#endif /* threads/workqueue.h */
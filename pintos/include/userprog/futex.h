@@ -0,0 +1,9 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+void futex_init(void);
+int futex_wait(int *uaddr, int val);
+int futex_wake(int *uaddr, int cnt);
+void futex_wake_killed(void);
+
+#endif /* userprog/futex.h */
@@ -3,12 +3,33 @@
 
 #define MAX_ARGS 128
 
+#include "threads/synch.h"
 #include "threads/thread.h"
 
+/* What the threads of one user process share.  Besides the
+   address space and the file descriptor table, which each thread
+   points to, that is the knowledge of when the last of them is
+   gone. */
+struct process
+{
+    struct thread *main;   /* Thread that fork() or exec() started. */
+    struct list threads;   /* All its threads, through `process_elem'. */
+    int thread_cnt;        /* Number of them. */
+    bool exiting;          /* Has some thread called exit()? */
+    int exit_status;       /* Status that thread passed, if so. */
+    struct semaphore left; /* Upped whenever a thread other than the
+                              main one leaves. */
+    struct lock fd_lock;   /* Guards slots in the fd table. */
+};
+
 tid_t process_create_initd(const char *file_name);
 tid_t process_fork(const char *name, struct intr_frame *if_);
+tid_t process_clone(void *entry, void *aux, void *stack, void *tls,
+                    struct intr_frame *if_);
 int process_exec(void *f_name);
 int process_wait(tid_t);
+int process_join(tid_t);
+void process_kill(int status);
 void process_exit(void);
 void process_activate(struct thread *next);
 
@@ -8,9 +8,10 @@
 #include "lib/user/syscall.h"
 #include "threads/interrupt.h"
 
-extern struct lock filesys_lock;
+extern struct rwlock filesys_lock;
 
 void syscall_init(void);
+void syscall_init_ap(void);
 
 void check_valid(void *vaddr);
 void check_fd(int fd);
@@ -32,4 +33,12 @@ void sys_close(int fd);
 
 int sys_dup2(int oldfd, int newfd);
 
+bool sys_sched_deadline(int runtime, int period);
+int sys_sched_wait(void);
+int sys_futex(int *uaddr, int op, int val);
+int sys_clone(void *entry, void *aux, void *stack, void *tls,
+              struct intr_frame *f);
+int sys_join(int tid);
+void sys_exit_thread(int status) NO_RETURN;
+
 #endif /* userprog/syscall.h */
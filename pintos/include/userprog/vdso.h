@@ -0,0 +1,21 @@
+#ifndef USERPROG_VDSO_H
+#define USERPROG_VDSO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vdso-data.h>
+
+#include "threads/vaddr.h"
+
+/* Returns true if user virtual address VADDR lies in the pages
+   that vdso_map() maps. */
+#define is_vdso_vaddr(vaddr)            \
+    ((uint64_t) (vaddr) >= VDSO_ADDR && \
+     (uint64_t) (vaddr) < VDSO_ADDR + VDSO_PAGES * PGSIZE)
+
+void vdso_init(void);
+void vdso_tick(int64_t ticks);
+bool vdso_map(uint64_t *pml4, int pid);
+void vdso_unmap(uint64_t *pml4);
+
+#endif /* userprog/vdso.h */
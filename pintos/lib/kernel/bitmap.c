@@ -29,6 +29,7 @@ typedef unsigned long elem_type;
 struct bitmap
 {
     size_t bit_cnt;  /* Number of bits. */
+    size_t next_fit; /* Where bitmap_scan_and_flip_next() starts. */
     elem_type *bits; /* Elements that represent bits. */
 };
 
@@ -66,6 +67,48 @@ static inline elem_type last_mask(const struct bitmap *b)
     return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns the number of bits set in ELEM.  Written out because
+   the kernel is not linked with libgcc, which __builtin_popcountl()
+   would call without -mpopcnt. */
+static inline int elem_popcount(elem_type elem)
+{
+    elem = elem - ((elem >> 1) & 0x5555555555555555UL);
+    elem = (elem & 0x3333333333333333UL) + ((elem >> 2) & 0x3333333333333333UL);
+    elem = (elem + (elem >> 4)) & 0x0f0f0f0f0f0f0f0fUL;
+    return (elem * 0x0101010101010101UL) >> 56;
+}
+
+/* Returns a mask of the bits of element ELEM_IDX that fall in
+   bits START through END, exclusive, of the bitmap. */
+static inline elem_type range_mask(size_t elem_idx, size_t start, size_t end)
+{
+    size_t first = elem_idx * ELEM_BITS;
+    elem_type mask = (elem_type) -1;
+
+    if (start > first) mask &= (elem_type) -1 << (start - first);
+    if (end < first + ELEM_BITS)
+        mask &= ((elem_type) 1 << (end - first)) - 1;
+    return mask;
+}
+
+/* Returns the index of the first bit in B between START and END,
+   exclusive, that is set to VALUE, or END if there is none.
+   Skips whole elements that hold no such bit. */
+static size_t next_bit(const struct bitmap *b, size_t start, size_t end,
+                       bool value)
+{
+    size_t idx;
+
+    for (idx = elem_idx(start); idx * ELEM_BITS < end; idx++)
+    {
+        elem_type elem = value ? b->bits[idx] : ~b->bits[idx];
+
+        elem &= range_mask(idx, start, end);
+        if (elem != 0) return idx * ELEM_BITS + __builtin_ctzl(elem);
+    }
+    return end;
+}
+
 /* Creation and destruction. */
 
 /* Initializes B to be a bitmap of BIT_CNT bits
@@ -78,6 +121,7 @@ struct bitmap *bitmap_create(size_t bit_cnt)
     if (b != NULL)
     {
         b->bit_cnt = bit_cnt;
+        b->next_fit = 0;
         b->bits = malloc(byte_cnt(bit_cnt));
         if (b->bits != NULL || bit_cnt == 0)
         {
@@ -100,6 +144,7 @@ struct bitmap *bitmap_create_in_buf(size_t bit_cnt, void *block,
     ASSERT(block_size >= bitmap_buf_size(bit_cnt));
 
     b->bit_cnt = bit_cnt;
+    b->next_fit = 0;
     b->bits = (elem_type *) (b + 1);
     bitmap_set_all(b, false);
     return b;
@@ -201,16 +246,26 @@ void bitmap_set_all(struct bitmap *b, bool value)
     bitmap_set_multiple(b, 0, bitmap_size(b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.  Each
+   element is updated atomically, as by bitmap_mark() and
+   bitmap_reset(). */
 void bitmap_set_multiple(struct bitmap *b, size_t start, size_t cnt, bool value)
 {
-    size_t i;
+    size_t idx;
 
     ASSERT(b != NULL);
     ASSERT(start <= b->bit_cnt);
     ASSERT(start + cnt <= b->bit_cnt);
 
-    for (i = 0; i < cnt; i++) bitmap_set(b, start + i, value);
+    for (idx = elem_idx(start); idx * ELEM_BITS < start + cnt; idx++)
+    {
+        elem_type mask = range_mask(idx, start, start + cnt);
+
+        if (value)
+            asm("lock orq %1, %0" : "=m"(b->bits[idx]) : "r"(mask) : "cc");
+        else
+            asm("lock andq %1, %0" : "=m"(b->bits[idx]) : "r"(~mask) : "cc");
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -218,15 +273,18 @@ void bitmap_set_multiple(struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t bitmap_count(const struct bitmap *b, size_t start, size_t cnt,
                     bool value)
 {
-    size_t i, value_cnt;
+    size_t idx, value_cnt;
 
     ASSERT(b != NULL);
     ASSERT(start <= b->bit_cnt);
     ASSERT(start + cnt <= b->bit_cnt);
 
     value_cnt = 0;
-    for (i = 0; i < cnt; i++)
-        if (bitmap_test(b, start + i) == value) value_cnt++;
+    for (idx = elem_idx(start); idx * ELEM_BITS < start + cnt; idx++)
+    {
+        elem_type elem = value ? b->bits[idx] : ~b->bits[idx];
+        value_cnt += elem_popcount(elem & range_mask(idx, start, start + cnt));
+    }
     return value_cnt;
 }
 
@@ -235,15 +293,11 @@ size_t bitmap_count(const struct bitmap *b, size_t start, size_t cnt,
 bool bitmap_contains(const struct bitmap *b, size_t start, size_t cnt,
                      bool value)
 {
-    size_t i;
-
     ASSERT(b != NULL);
     ASSERT(start <= b->bit_cnt);
     ASSERT(start + cnt <= b->bit_cnt);
 
-    for (i = 0; i < cnt; i++)
-        if (bitmap_test(b, start + i) == value) return true;
-    return false;
+    return next_bit(b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -272,18 +326,28 @@ bool bitmap_all(const struct bitmap *b, size_t start, size_t cnt)
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+   Each candidate group starts at a bit set to VALUE and ends at
+   the first bit that is not, so the scan looks at each element
+   of B a bounded number of times. */
 size_t bitmap_scan(const struct bitmap *b, size_t start, size_t cnt, bool value)
 {
+    size_t i = start;
+
     ASSERT(b != NULL);
     ASSERT(start <= b->bit_cnt);
 
-    if (cnt <= b->bit_cnt)
+    if (cnt == 0) return start;
+    while (cnt <= b->bit_cnt - i)
     {
-        size_t last = b->bit_cnt - cnt;
-        size_t i;
-        for (i = start; i <= last; i++)
-            if (!bitmap_contains(b, i, cnt, !value)) return i;
+        size_t end;
+
+        i = next_bit(b, i, b->bit_cnt - cnt + 1, value);
+        if (i > b->bit_cnt - cnt) break;
+
+        end = next_bit(b, i, i + cnt, !value);
+        if (end == i + cnt) return i;
+        i = end + 1;
     }
     return BITMAP_ERROR;
 }
@@ -303,6 +367,28 @@ size_t bitmap_scan_and_flip(struct bitmap *b, size_t start, size_t cnt,
     return idx;
 }
 
+/* Like bitmap_scan_and_flip(), but starts scanning where the
+   previous call left off instead of at a fixed bit, wrapping
+   around to the beginning of B if necessary ("next fit").
+   Repeated allocations thus do not rescan the bits that earlier
+   ones flipped. */
+size_t bitmap_scan_and_flip_next(struct bitmap *b, size_t cnt, bool value)
+{
+    size_t start, idx;
+
+    ASSERT(b != NULL);
+
+    start = b->next_fit <= b->bit_cnt ? b->next_fit : 0;
+    idx = bitmap_scan(b, start, cnt, value);
+    if (idx == BITMAP_ERROR && start > 0) idx = bitmap_scan(b, 0, cnt, value);
+    if (idx != BITMAP_ERROR)
+    {
+        bitmap_set_multiple(b, idx, cnt, !value);
+        b->next_fit = idx + cnt < b->bit_cnt ? idx + cnt : 0;
+    }
+    return idx;
+}
+
 /* File input and output. */
 
 #ifdef FILESYS
@@ -0,0 +1,186 @@
+#include "heap.h"
+
+#include "../debug.h"
+
+/* Our heap is a pairing heap: a single tree in which every node
+   is greater than or equal to its children, with no constraint
+   on shape.  The children of a node form a singly linked list
+   through `sibling', with `child' pointing to the leftmost, and
+   each node's `prev' points back to its left sibling or, for the
+   leftmost child, to its parent, so that any node can be cut out
+   of the tree in constant time.
+
+   Two trees are merged ("melded") by making the lesser root the
+   leftmost child of the greater one.  All the restructuring
+   happens when a root is taken off: its children are melded in
+   pairs from left to right, and the pairs are then melded from
+   right to left into a single tree.  See [Fredman86], "The
+   Pairing Heap: A New Form of Self-Adjusting Heap". */
+
+static struct heap_elem *meld(struct heap *, struct heap_elem *,
+                              struct heap_elem *);
+static struct heap_elem *merge_pairs(struct heap *, struct heap_elem *);
+static void cut(struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void heap_init(struct heap *heap, heap_less_func *less, void *aux)
+{
+    ASSERT(heap != NULL);
+    ASSERT(less != NULL);
+
+    heap->root = NULL;
+    heap->size = 0;
+    heap->less = less;
+    heap->aux = aux;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool heap_empty(const struct heap *heap)
+{
+    return heap->root == NULL;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t heap_size(const struct heap *heap)
+{
+    return heap->size;
+}
+
+/* Returns the greatest element in HEAP, without removing it.
+   Undefined behavior if HEAP is empty. */
+struct heap_elem *heap_top(const struct heap *heap)
+{
+    ASSERT(!heap_empty(heap));
+    return heap->root;
+}
+
+/* Inserts ELEM into HEAP. */
+void heap_push(struct heap *heap, struct heap_elem *elem)
+{
+    ASSERT(heap != NULL);
+    ASSERT(elem != NULL);
+
+    elem->child = elem->sibling = elem->prev = NULL;
+    heap->root = meld(heap, heap->root, elem);
+    heap->size++;
+}
+
+/* Removes the greatest element from HEAP and returns it.
+   Undefined behavior if HEAP is empty. */
+struct heap_elem *heap_pop(struct heap *heap)
+{
+    struct heap_elem *top = heap_top(heap);
+
+    heap->root = merge_pairs(heap, top->child);
+    heap->size--;
+    top->child = NULL;
+    return top;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void heap_remove(struct heap *heap, struct heap_elem *elem)
+{
+    ASSERT(heap != NULL);
+    ASSERT(elem != NULL);
+
+    if (elem == heap->root)
+    {
+        heap_pop(heap);
+        return;
+    }
+
+    cut(elem);
+    heap->root = meld(heap, heap->root, merge_pairs(heap, elem->child));
+    heap->size--;
+    elem->child = NULL;
+}
+
+/* Restores the heap property after the key of ELEM, which must
+   be in HEAP, has changed in either direction. */
+void heap_update(struct heap *heap, struct heap_elem *elem)
+{
+    heap_remove(heap, elem);
+    heap_push(heap, elem);
+}
+
+/* Melds the trees rooted at A and B, either of which may be
+   null, and returns the root of the result.  A and B must not
+   have siblings. */
+static struct heap_elem *meld(struct heap *heap, struct heap_elem *a,
+                              struct heap_elem *b)
+{
+    struct heap_elem *t;
+
+    if (a == NULL) return b;
+    if (b == NULL) return a;
+
+    /* On ties A stays on top, so that equal elements come out in
+       the order they went in as long as the comparison
+       function breaks ties itself. */
+    if (heap->less(a, b, heap->aux))
+    {
+        t = a;
+        a = b;
+        b = t;
+    }
+
+    b->prev = a;
+    b->sibling = a->child;
+    if (a->child != NULL) a->child->prev = b;
+    a->child = b;
+    return a;
+}
+
+/* Melds the sibling list starting at FIRST into a single tree by
+   two-pass pairing, and returns its root, or a null pointer if
+   FIRST is null. */
+static struct heap_elem *merge_pairs(struct heap *heap,
+                                     struct heap_elem *first)
+{
+    struct heap_elem *pairs = NULL, *root = NULL;
+
+    /* Left to right: meld adjacent pairs, stacking up the results
+       through `sibling' in reverse order. */
+    while (first != NULL)
+    {
+        struct heap_elem *a = first, *b = first->sibling;
+
+        first = b != NULL ? b->sibling : NULL;
+        a->sibling = a->prev = NULL;
+        if (b != NULL)
+        {
+            b->sibling = b->prev = NULL;
+            a = meld(heap, a, b);
+        }
+        a->sibling = pairs;
+        pairs = a;
+    }
+
+    /* Right to left: meld the pairs into one tree. */
+    while (pairs != NULL)
+    {
+        struct heap_elem *next = pairs->sibling;
+
+        pairs->sibling = NULL;
+        root = meld(heap, root, pairs);
+        pairs = next;
+    }
+
+    if (root != NULL) root->prev = NULL;
+    return root;
+}
+
+/* Cuts the subtree rooted at ELEM, which must not be the root of
+   its heap, out of its parent's list of children. */
+static void cut(struct heap_elem *elem)
+{
+    ASSERT(elem->prev != NULL);
+
+    if (elem->prev->child == elem)
+        elem->prev->child = elem->sibling;
+    else
+        elem->prev->sibling = elem->sibling;
+    if (elem->sibling != NULL) elem->sibling->prev = elem->prev;
+    elem->sibling = elem->prev = NULL;
+}
@@ -0,0 +1,104 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <synch.h>
+#include <syscall.h>
+
+/* The mutex follows "mutex 2" of Ulrich Drepper, "Futexes Are
+   Tricky".  Its state is 0 when it is unlocked, 1 when it is
+   locked and nobody waits, and 2 when it is locked and somebody
+   may wait.  Only a thread that finds it locked makes a system
+   call, and only an unlock from state 2 wakes anybody. */
+
+/* Initializes MUTEX as unlocked. */
+void mutex_init(struct mutex *mutex)
+{
+    mutex->state = 0;
+}
+
+/* Acquires MUTEX, sleeping until it becomes available if
+   necessary.  Mutexes are not recursive. */
+void mutex_lock(struct mutex *mutex)
+{
+    int state = 0;
+
+    if (__atomic_compare_exchange_n(&mutex->state, &state, 1, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+
+    /* Mark it contended, and sleep until we are the ones to turn
+       it from unlocked to contended.  Since we do not know whether
+       anybody else still waits, we leave it at 2. */
+    if (state != 2)
+        state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    while (state != 0)
+    {
+        futex(&mutex->state, FUTEX_WAIT, 2);
+        state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+/* Tries to acquire MUTEX without sleeping.  Returns true if
+   successful, false if it was already locked. */
+bool mutex_trylock(struct mutex *mutex)
+{
+    int state = 0;
+
+    return __atomic_compare_exchange_n(&mutex->state, &state, 1, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Releases MUTEX, which the calling thread must hold, and wakes a
+   waiter if there may be one. */
+void mutex_unlock(struct mutex *mutex)
+{
+    if (__atomic_fetch_sub(&mutex->state, 1, __ATOMIC_RELEASE) != 1)
+    {
+        __atomic_store_n(&mutex->state, 0, __ATOMIC_RELEASE);
+        futex(&mutex->state, FUTEX_WAKE, 1);
+    }
+}
+
+/* Initializes condition variable COND. */
+void condvar_init(struct condvar *cond)
+{
+    cond->seq = 0;
+    cond->waiters = 0;
+}
+
+/* Atomically releases MUTEX and waits for COND to be signaled,
+   then reacquires MUTEX.  As with the kernel's cond_wait(), the
+   caller must recheck its condition afterward.
+
+   A signal increments COND's sequence number before waking
+   anybody, so one that comes after we read it, even before we
+   sleep, makes the futex wait return at once. */
+void condvar_wait(struct condvar *cond, struct mutex *mutex)
+{
+    int seq = __atomic_load_n(&cond->seq, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&cond->waiters, 1, __ATOMIC_SEQ_CST);
+    mutex_unlock(mutex);
+    futex(&cond->seq, FUTEX_WAIT, seq);
+    __atomic_fetch_sub(&cond->waiters, 1, __ATOMIC_SEQ_CST);
+
+    /* Others may have been woken along with us, so take the mutex
+       as contended, to be sure that they are woken in turn. */
+    while (__atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE) != 0)
+        futex(&mutex->state, FUTEX_WAIT, 2);
+}
+
+/* Wakes one thread waiting on COND, if any. */
+void condvar_signal(struct condvar *cond)
+{
+    __atomic_fetch_add(&cond->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&cond->waiters, __ATOMIC_SEQ_CST) > 0)
+        futex(&cond->seq, FUTEX_WAKE, 1);
+}
+
+/* Wakes all threads waiting on COND. */
+void condvar_broadcast(struct condvar *cond)
+{
+    __atomic_fetch_add(&cond->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&cond->waiters, __ATOMIC_SEQ_CST) > 0)
+        futex(&cond->seq, FUTEX_WAKE, INT_MAX);
+}
@@ -50,7 +50,7 @@ __attribute__((always_inline)) static __inline int64_t syscall(
              ((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                          \
-    (syscall(((uint64_t *) NUMBER), ((uint64_t) ARG0), ((uint64_t) ARG1), \
+    (syscall(((uint64_t) NUMBER), ((uint64_t) ARG0), ((uint64_t) ARG1),   \
              ((uint64_t) ARG2), ((uint64_t) ARG3), 0, 0))
 
 #define syscall5(NUMBER, ARG0, ARG1, ARG2, ARG3, ARG4)                  \
@@ -182,3 +182,34 @@ int umount(const char *path)
 {
     return syscall1(SYS_UMOUNT, path);
 }
+
+bool sched_deadline(int runtime, int period)
+{
+    return syscall2(SYS_SCHED_DEADLINE, runtime, period);
+}
+
+int sched_wait(void)
+{
+    return syscall0(SYS_SCHED_WAIT);
+}
+
+int futex(int *uaddr, int op, int val)
+{
+    return syscall3(SYS_FUTEX, uaddr, op, val);
+}
+
+int clone(void (*entry)(void *), void *aux, void *stack, void *tls)
+{
+    return syscall4(SYS_CLONE, entry, aux, stack, tls);
+}
+
+int join(int tid)
+{
+    return syscall1(SYS_JOIN, tid);
+}
+
+void exit_thread(int status)
+{
+    syscall1(SYS_EXIT_THREAD, status);
+    NOT_REACHED();
+}
@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <syscall.h>
+#include <thread.h>
+
+/* What a new thread needs to get going, kept at the top of its
+   stack. */
+struct start_info
+{
+    thread_func *func; /* Function to run. */
+    void *aux;         /* Its argument. */
+};
+
+static void thread_entry(void *) NO_RETURN;
+
+/* Starts a thread that runs FUNC(AUX) on the SIZE-byte STACK, with
+   TLS as its TLS pointer, and returns its thread id, or TID_ERROR
+   if it cannot be created.  The stack must stay valid until the
+   thread is joined. */
+tid_t thread_create(thread_func *func, void *aux, void *stack, size_t size,
+                    void *tls)
+{
+    uintptr_t top = ((uintptr_t) stack + size) & ~(uintptr_t) 0xf;
+    struct start_info *info = (struct start_info *) top - 1;
+
+    info->func = func;
+    info->aux = aux;
+    return clone(thread_entry, info, info, tls);
+}
+
+/* Waits for thread TID, which the calling thread created, to exit
+   and returns the status it passed to thread_exit(), or -1 if it
+   was killed or TID cannot be joined. */
+int thread_join(tid_t tid)
+{
+    return join(tid);
+}
+
+/* Ends the calling thread with STATUS. */
+void thread_exit(int status)
+{
+    exit_thread(status);
+}
+
+/* First function run by a new thread. */
+static void thread_entry(void *info_)
+{
+    struct start_info *info = info_;
+
+    info->func(info->aux);
+    thread_exit(0);
+}
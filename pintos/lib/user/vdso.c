@@ -0,0 +1,48 @@
+#include <vdso-data.h>
+#include <vdso.h>
+
+/* Returns the process id, as fork() returned it to the parent.
+   All threads of a process share it. */
+int getpid(void)
+{
+    return VDSO_PROCESS->pid;
+}
+
+/* Returns the number of timer ticks since the OS booted. */
+int64_t clock_ticks(void)
+{
+    return VDSO_CLOCK->ticks;
+}
+
+/* Returns the number of timer ticks per second. */
+int clock_freq(void)
+{
+    return VDSO_CLOCK->timer_freq;
+}
+
+/* Returns the number of nanoseconds since about when the OS
+   booted, measured with the TSC, or 0 if the kernel could not
+   calibrate it. */
+uint64_t clock_ns(void)
+{
+    const volatile struct vdso_clock *clock = VDSO_CLOCK;
+    uint64_t base, mult, tsc;
+    uint32_t seq;
+    uint32_t lo, hi;
+
+    /* Copy the calibration the way seqlock readers in the kernel
+       do.  x86 keeps loads in order, so compiler barriers do. */
+    do
+    {
+        while ((seq = __atomic_load_n(&clock->seq, __ATOMIC_ACQUIRE)) & 1)
+            asm volatile("pause");
+        base = clock->tsc_base;
+        mult = clock->tsc_mult;
+        asm volatile("" : : : "memory");
+    } while (__atomic_load_n(&clock->seq, __ATOMIC_ACQUIRE) != seq);
+
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    tsc = (uint64_t) hi << 32 | lo;
+    if (tsc < base) return 0;
+    return ((unsigned __int128) (tsc - base) * mult) >> 32;
+}
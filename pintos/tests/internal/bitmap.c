@@ -0,0 +1,139 @@
+/* Test program and microbenchmark for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan(), bitmap_count(), and bitmap_contains()
+   against bit-at-a-time reference versions on random bitmaps,
+   then times first-fit and next-fit allocation of small groups
+   of bits from a large bitmap with the TSC.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+
+#include "intrinsic.h"
+#include "threads/test.h"
+
+/* Maximum number of bits in a bitmap that we check. */
+#define MAX_BITS 300
+
+/* Number of bits in the bitmap that we time, and the size of
+   each group allocated from it. */
+#define BENCH_BITS 65536
+#define BENCH_CNT 8
+
+static void randomize(struct bitmap *, int density);
+static size_t slow_scan(const struct bitmap *, size_t start, size_t cnt,
+                        bool);
+static size_t slow_count(const struct bitmap *, size_t start, size_t cnt,
+                         bool);
+static uint64_t bench(bool next_fit);
+
+/* Test the bitmap implementation. */
+void test(void)
+{
+    size_t bit_cnt;
+
+    printf("testing various size bitmaps:");
+    for (bit_cnt = 0; bit_cnt < MAX_BITS; bit_cnt = bit_cnt * 4 / 3 + 1)
+    {
+        int repeat;
+
+        printf(" %zu", bit_cnt);
+        for (repeat = 0; repeat < 10; repeat++)
+        {
+            struct bitmap *b = bitmap_create(bit_cnt);
+            size_t start, cnt;
+            int value;
+
+            ASSERT(b != NULL);
+            randomize(b, repeat * 10);
+            for (start = 0; start <= bit_cnt; start++)
+                for (cnt = 0; start + cnt <= bit_cnt; cnt++)
+                    for (value = 0; value <= 1; value++)
+                    {
+                        ASSERT(bitmap_count(b, start, cnt, value) ==
+                               slow_count(b, start, cnt, value));
+                        ASSERT(bitmap_contains(b, start, cnt, value) ==
+                               (slow_count(b, start, cnt, value) > 0));
+                        ASSERT(bitmap_scan(b, start, cnt, value) ==
+                               slow_scan(b, start, cnt, value));
+                    }
+            bitmap_destroy(b);
+        }
+    }
+    printf(" done\n");
+
+    printf("first fit: %llu TSC cycles per allocation\n",
+           (unsigned long long) bench(false));
+    printf("next fit: %llu TSC cycles per allocation\n",
+           (unsigned long long) bench(true));
+    printf("bitmap: PASS\n");
+}
+
+/* Sets each bit in B to true with probability DENSITY percent. */
+static void randomize(struct bitmap *b, int density)
+{
+    size_t i;
+
+    for (i = 0; i < bitmap_size(b); i++)
+        bitmap_set(b, i, (int) (random_ulong() % 100) < density);
+}
+
+/* Reference bitmap_scan(), testing one bit at a time. */
+static size_t slow_scan(const struct bitmap *b, size_t start, size_t cnt,
+                        bool value)
+{
+    size_t i;
+
+    for (i = start; i + cnt <= bitmap_size(b); i++)
+        if (slow_count(b, i, cnt, value) == cnt) return i;
+    return BITMAP_ERROR;
+}
+
+/* Reference bitmap_count(), testing one bit at a time. */
+static size_t slow_count(const struct bitmap *b, size_t start, size_t cnt,
+                         bool value)
+{
+    size_t i, value_cnt = 0;
+
+    for (i = start; i < start + cnt; i++)
+        if (bitmap_test(b, i) == value) value_cnt++;
+    return value_cnt;
+}
+
+/* Fills most of a BENCH_BITS-bit bitmap, BENCH_CNT bits at a
+   time, freeing one earlier group for every two allocated, and
+   returns the average TSC cycles per allocation. */
+static uint64_t bench(bool next_fit)
+{
+    static size_t groups[BENCH_BITS / BENCH_CNT];
+    struct bitmap *b = bitmap_create(BENCH_BITS);
+    size_t group_cnt = 0, alloc_cnt = 0, idx;
+    uint64_t start, cycles = 0;
+
+    ASSERT(b != NULL);
+    for (;;)
+    {
+        start = rdtsc();
+        idx = next_fit ? bitmap_scan_and_flip_next(b, BENCH_CNT, false)
+                       : bitmap_scan_and_flip(b, 0, BENCH_CNT, false);
+        cycles += rdtsc() - start;
+        if (idx == BITMAP_ERROR) break;
+
+        alloc_cnt++;
+        groups[group_cnt++] = idx;
+        if (alloc_cnt % 2 == 0)
+        {
+            size_t victim = random_ulong() % group_cnt;
+            bitmap_set_multiple(b, groups[victim], BENCH_CNT, false);
+            groups[victim] = groups[--group_cnt];
+        }
+    }
+    bitmap_destroy(b);
+    return cycles / alloc_cnt;
+}
@@ -0,0 +1,86 @@
+/* Checks admission control for the EDF scheduling class: invalid
+   reservations are refused, and so is any reservation that would
+   take the class over 95% of a processor, counting the
+   reservations of other threads. */
+
+#include <stdio.h>
+
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct helper
+{
+    int64_t runtime, period;   /* Reservation to ask for. */
+    bool admitted;             /* Result. */
+    struct semaphore started;  /* Up'd after asking. */
+    struct semaphore release;  /* Down'd before leaving the class. */
+    struct semaphore done;     /* Up'd after leaving the class. */
+};
+
+static void helper_thread(void *);
+static void try(int64_t runtime, int64_t period);
+static void start_helper(struct helper *, int64_t runtime, int64_t period);
+
+void test_edf_admit(void)
+{
+    struct helper helpers[3];
+    int i;
+
+    try(11, 10);
+    try(1, 0);
+    try(-1, 10);
+    try(5, 10);
+
+    start_helper(&helpers[0], 4, 10);
+    start_helper(&helpers[1], 1, 10);
+    start_helper(&helpers[2], 1, 20);
+
+    try(6, 10);
+    try(0, 0);
+    try(6, 10);
+
+    for (i = 0; i < 3; i++)
+    {
+        sema_up(&helpers[i].release);
+        sema_down(&helpers[i].done);
+    }
+    try(19, 20);
+    try(0, 0);
+}
+
+/* Asks for RUNTIME ticks every PERIOD for the main thread. */
+static void try(int64_t runtime, int64_t period)
+{
+    bool admitted = thread_set_deadline(runtime, period);
+
+    msg("main %lld/%lld: %s", runtime, period,
+        admitted ? "admitted" : "rejected");
+}
+
+/* Starts a thread that asks for RUNTIME ticks every PERIOD and
+   keeps its reservation until H->release is up'd. */
+static void start_helper(struct helper *h, int64_t runtime, int64_t period)
+{
+    h->runtime = runtime;
+    h->period = period;
+    sema_init(&h->started, 0);
+    sema_init(&h->release, 0);
+    sema_init(&h->done, 0);
+    thread_create("helper", PRI_DEFAULT, helper_thread, h);
+    sema_down(&h->started);
+    msg("helper %lld/%lld: %s", runtime, period,
+        h->admitted ? "admitted" : "rejected");
+}
+
+static void helper_thread(void *h_)
+{
+    struct helper *h = h_;
+
+    h->admitted = thread_set_deadline(h->runtime, h->period);
+    sema_up(&h->started);
+    sema_down(&h->release);
+    thread_set_deadline(0, 0);
+    sema_up(&h->done);
+}
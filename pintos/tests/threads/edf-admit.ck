@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-admit) begin
+(edf-admit) main 11/10: rejected
+(edf-admit) main 1/0: rejected
+(edf-admit) main -1/10: rejected
+(edf-admit) main 5/10: admitted
+(edf-admit) helper 4/10: admitted
+(edf-admit) helper 1/10: rejected
+(edf-admit) helper 1/20: admitted
+(edf-admit) main 6/10: rejected
+(edf-admit) main 0/0: admitted
+(edf-admit) main 6/10: rejected
+(edf-admit) main 19/20: admitted
+(edf-admit) main 0/0: admitted
+(edf-admit) end
+EOF
+pass;
@@ -0,0 +1,128 @@
+/* Measures deadline misses in the EDF scheduling class.
+
+   Two periodic EDF threads, whose jobs fit in their budgets, run
+   alongside CPU-bound threads of a higher ordinary priority than
+   any other.  The EDF threads must preempt them and meet every
+   deadline, while the CPU-bound threads still get the time that
+   is not reserved.  A third EDF thread needs three times its
+   budget for each job and otherwise runs at the lowest priority,
+   so it must miss deadlines instead of taking more than it
+   reserved. */
+
+#include <stdio.h>
+
+#include "devices/timer.h"
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define HOG_CNT 2
+
+struct edf_info
+{
+    const char *name;
+    int64_t runtime, period; /* Reservation. */
+    int64_t work;            /* Ticks of work in each job. */
+    int job_cnt;             /* Number of jobs to run. */
+    int low_priority;        /* Priority outside the budget. */
+    bool admitted;
+    int misses;
+    struct semaphore *done;
+};
+
+struct hog_info
+{
+    int tick_count;
+    struct semaphore *done;
+};
+
+static volatile bool stop_hogs;
+
+static void edf_thread(void *);
+static void hog_thread(void *);
+
+void test_edf_deadline(void)
+{
+    struct edf_info edf[] = {
+        {.name = "edf A", .runtime = 2, .period = 10, .work = 1,
+         .job_cnt = 20, .low_priority = PRI_MAX},
+        {.name = "edf B", .runtime = 3, .period = 15, .work = 2,
+         .job_cnt = 14, .low_priority = PRI_MAX},
+        {.name = "overrun", .runtime = 1, .period = 10, .work = 3,
+         .job_cnt = 5, .low_priority = PRI_MIN},
+    };
+    const int edf_cnt = sizeof edf / sizeof *edf;
+    struct hog_info hogs[HOG_CNT];
+    struct semaphore done;
+    int hog_ticks = 0;
+    int i;
+
+    sema_init(&done, 0);
+    thread_set_priority(PRI_MAX);
+
+    for (i = 0; i < edf_cnt; i++)
+    {
+        edf[i].done = &done;
+        thread_create(edf[i].name, PRI_MAX, edf_thread, &edf[i]);
+    }
+    stop_hogs = false;
+    for (i = 0; i < HOG_CNT; i++)
+    {
+        hogs[i].tick_count = 0;
+        hogs[i].done = &done;
+        thread_create("hog", PRI_MAX - 1, hog_thread, &hogs[i]);
+    }
+
+    for (i = 0; i < edf_cnt; i++) sema_down(&done);
+    stop_hogs = true;
+    for (i = 0; i < HOG_CNT; i++) sema_down(&done);
+
+    for (i = 0; i < edf_cnt; i++)
+        if (!edf[i].admitted) fail("%s was not admitted", edf[i].name);
+    msg("Thread %s missed %d deadlines.", edf[0].name, edf[0].misses);
+    msg("Thread %s missed %d deadlines.", edf[1].name, edf[1].misses);
+    if (edf[2].misses == 0)
+        fail("overrunning thread did not miss deadlines");
+    msg("Overrunning thread missed deadlines.");
+
+    for (i = 0; i < HOG_CNT; i++) hog_ticks += hogs[i].tick_count;
+    if (hog_ticks == 0) fail("CPU-bound threads never ran");
+    msg("CPU-bound threads ran.");
+}
+
+/* Joins the EDF class and runs INFO's jobs, each of which spins
+   for INFO->work ticks. */
+static void edf_thread(void *info_)
+{
+    struct edf_info *info = info_;
+    int i;
+
+    info->admitted = thread_set_deadline(info->runtime, info->period);
+    thread_set_priority(info->low_priority);
+    for (i = 0; i < info->job_cnt; i++)
+    {
+        int64_t start = timer_ticks();
+
+        while (timer_elapsed(start) < info->work) continue;
+        thread_deadline_wait();
+    }
+    info->misses = thread_get_deadline_misses();
+    thread_set_deadline(0, 0);
+    sema_up(info->done);
+}
+
+/* Spins until told to stop, counting the ticks it sees. */
+static void hog_thread(void *info_)
+{
+    struct hog_info *info = info_;
+    int64_t last_time = 0;
+
+    while (!stop_hogs)
+    {
+        int64_t cur_time = timer_ticks();
+        if (cur_time != last_time) info->tick_count++;
+        last_time = cur_time;
+    }
+    sema_up(info->done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-deadline) begin
+(edf-deadline) Thread edf A missed 0 deadlines.
+(edf-deadline) Thread edf B missed 0 deadlines.
+(edf-deadline) Overrunning thread missed deadlines.
+(edf-deadline) CPU-bound threads ran.
+(edf-deadline) end
+EOF
+pass;
@@ -0,0 +1,65 @@
+/* Starts several high-resolution timers out of order, cancels one
+   of them, and checks that the rest fire in order of expiry.
+   Then checks that a sub-tick timer_usleep() blocks, letting a
+   lower-priority thread run, instead of spinning. */
+
+#include <stdio.h>
+
+#include "devices/hrtimer.h"
+#include "devices/timer.h"
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+
+#define TIMER_CNT 4
+
+static hrtimer_func record_expiry;
+static thread_func low_thread_func;
+
+static int fired[TIMER_CNT];
+static int fired_cnt;
+static volatile bool low_ran;
+
+void test_hrtimer_order(void)
+{
+    /* Expiries in microseconds, and whether to cancel. */
+    static const int delays[TIMER_CNT] = {3000, 1000, 1500, 2000};
+    static const bool cancel[TIMER_CNT] = {false, false, true, false};
+    struct hrtimer timers[TIMER_CNT];
+    uint64_t start;
+    int i;
+
+    /* This test does not work with the MLFQS. */
+    ASSERT(!thread_mlfqs);
+
+    if (!hrtimer_available()) fail("high-resolution timers unavailable");
+
+    start = hrtimer_now();
+    for (i = 0; i < TIMER_CNT; i++)
+    {
+        hrtimer_init(&timers[i], record_expiry, (void *) (intptr_t) i);
+        hrtimer_start(&timers[i], start + delays[i] * 1000ull);
+    }
+    for (i = 0; i < TIMER_CNT; i++)
+        if (cancel[i] && !hrtimer_cancel(&timers[i]))
+            fail("timer %d was not pending", i);
+
+    timer_msleep(5);
+    for (i = 0; i < fired_cnt; i++) msg("timer %d fired", fired[i]);
+    if (hrtimer_now() - start < 3000 * 1000) fail("woke up too early");
+
+    thread_create("low", PRI_DEFAULT - 1, low_thread_func, NULL);
+    timer_usleep(500);
+    if (!low_ran) fail("timer_usleep() did not let lower priority run");
+    msg("low-priority thread ran during timer_usleep()");
+}
+
+static void record_expiry(void *i)
+{
+    fired[fired_cnt++] = (intptr_t) i;
+}
+
+static void low_thread_func(void *aux UNUSED)
+{
+    low_ran = true;
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(hrtimer-order) begin
+(hrtimer-order) timer 1 fired
+(hrtimer-order) timer 3 fired
+(hrtimer-order) timer 0 fired
+(hrtimer-order) low-priority thread ran during timer_usleep()
+(hrtimer-order) end
+EOF
+pass;
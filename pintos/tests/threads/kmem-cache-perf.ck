@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing malloc cost in output"
+  unless grep (/^\(kmem-cache-perf\) malloc: \d+ TSC cycles per allocation\.$/, @output);
+fail "missing kmem_cache cost in output"
+  unless grep (/^\(kmem-cache-perf\) kmem_cache: \d+ TSC cycles per allocation\.$/, @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(kmem-cache-perf) PASS', @output);
+
+pass;
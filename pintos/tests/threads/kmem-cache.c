@@ -0,0 +1,124 @@
+/* Checks how an object cache manages its slabs.
+
+   Fills two slabs of a fresh cache whose constructor counts its
+   calls, and checks that the constructor ran once for each object
+   in them.  Frees the second slab's objects, some of which stay
+   in the CPU's magazine, so the slab must be kept.  Frees the
+   first slab's objects, which overflow the full magazine onto the
+   free list, so that slab must be given back.  Allocating the
+   second slab's objects again must not run the constructor, and
+   they must still hold what it set up.
+
+   Interrupts stay off while the cache is in use, so that the test
+   is not preempted and moved to another CPU, whose magazine would
+   be a different one. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+#define OBJ_SIZE 40
+#define MAX_PER_SLAB (PGSIZE / OBJ_SIZE)
+
+/* Constructor pattern. */
+#define CTOR_BYTE 0x5a
+
+static kmem_ctor_func fill_obj;
+static void check_slab(uint8_t *objs[], size_t cnt, const char *which);
+
+/* Number of fill_obj() calls. */
+static size_t ctor_cnt;
+
+void test_kmem_cache(void)
+{
+    static uint8_t *objs[2 * MAX_PER_SLAB];
+    uint8_t *second_slab;
+    struct kmem_cache *cache;
+    enum intr_level old_level;
+    size_t per_slab, i;
+
+    cache = kmem_cache_create("test", OBJ_SIZE, fill_obj);
+    if (cache == NULL) fail("kmem_cache_create failed");
+    old_level = intr_disable();
+
+    /* Fill the first slab, and find out how many objects it has
+       from where the first object of the second slab lands. */
+    objs[0] = kmem_cache_alloc(cache);
+    if (objs[0] == NULL) fail("kmem_cache_alloc failed");
+    for (per_slab = 1;; per_slab++)
+    {
+        objs[per_slab] = kmem_cache_alloc(cache);
+        if (objs[per_slab] == NULL) fail("kmem_cache_alloc failed");
+        if (pg_round_down(objs[per_slab]) != pg_round_down(objs[0])) break;
+        if (per_slab >= MAX_PER_SLAB) fail("slab holds too many objects");
+    }
+    for (i = per_slab + 1; i < 2 * per_slab; i++)
+    {
+        objs[i] = kmem_cache_alloc(cache);
+        if (objs[i] == NULL) fail("kmem_cache_alloc failed");
+    }
+    check_slab(objs, per_slab, "first");
+    check_slab(objs + per_slab, per_slab, "second");
+    second_slab = pg_round_down(objs[per_slab]);
+    if (kmem_cache_slab_cnt(cache) != 2)
+        fail("%zu slabs, expected 2", kmem_cache_slab_cnt(cache));
+    if (ctor_cnt != 2 * per_slab)
+        fail("%zu constructor calls for %zu objects", ctor_cnt, 2 * per_slab);
+    msg("constructor ran once for each object in 2 slabs");
+
+    for (i = per_slab; i < 2 * per_slab; i++) kmem_cache_free(cache, objs[i]);
+    if (kmem_cache_slab_cnt(cache) != 2)
+        fail("second slab released while the magazine holds its objects");
+    msg("second slab kept while the magazine holds some of its objects");
+
+    for (i = 0; i < per_slab; i++) kmem_cache_free(cache, objs[i]);
+    if (kmem_cache_slab_cnt(cache) != 1)
+        fail("first slab not released once all its objects were freed");
+    msg("first slab released once all its objects were freed");
+
+    for (i = 0; i < per_slab; i++)
+    {
+        objs[i] = kmem_cache_alloc(cache);
+        if (pg_round_down(objs[i]) != second_slab)
+            fail("object %zu not from the second slab", i);
+    }
+    check_slab(objs, per_slab, "reused");
+    if (ctor_cnt != 2 * per_slab) fail("constructor ran on reused objects");
+    msg("reused objects kept their constructed state");
+
+    for (i = 0; i < per_slab; i++) kmem_cache_free(cache, objs[i]);
+    intr_set_level(old_level);
+    pass();
+}
+
+/* Fills OBJ with CTOR_BYTE. */
+static void fill_obj(void *obj)
+{
+    memset(obj, CTOR_BYTE, OBJ_SIZE);
+    ctor_cnt++;
+}
+
+/* Fails unless the CNT objects in OBJS are all in one slab, are
+   distinct, and hold the constructor's pattern.  WHICH names the
+   slab in messages. */
+static void check_slab(uint8_t *objs[], size_t cnt, const char *which)
+{
+    size_t i, j;
+
+    for (i = 0; i < cnt; i++)
+    {
+        if (pg_round_down(objs[i]) != pg_round_down(objs[0]))
+            fail("%s slab: object %zu in another slab", which, i);
+        for (j = 0; j < i; j++)
+            if (objs[i] == objs[j])
+                fail("%s slab: objects %zu and %zu are the same", which, j, i);
+        for (j = 0; j < OBJ_SIZE; j++)
+            if (objs[i][j] != CTOR_BYTE)
+                fail("%s slab: object %zu not constructed", which, i);
+    }
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(kmem-cache) begin
+(kmem-cache) constructor ran once for each object in 2 slabs
+(kmem-cache) second slab kept while the magazine holds some of its objects
+(kmem-cache) first slab released once all its objects were freed
+(kmem-cache) reused objects kept their constructed state
+(kmem-cache) PASS
+(kmem-cache) end
+EOF
+pass;
@@ -0,0 +1,105 @@
+/* Measures the cost of a multi-page allocation under
+   fragmentation.
+
+   Times allocating and freeing blocks of BLOCK_PAGES pages from
+   the user pool with the TSC, first while the pool is all free,
+   then after taking every page and giving back all of them except
+   every BLOCK_PAGES'th page in the low 7/8 of the pool, so that
+   the only free runs of BLOCK_PAGES pages are in the top 1/8.
+   Checks that each block comes from there, and that freeing
+   everything leaves blocks big enough for a large allocation.
+   The costs depend on the machine, so the test only prints them;
+   compare them between kernels to see the effect of a change. */
+
+#include <stdio.h>
+
+#include "intrinsic.h"
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define ROUNDS 1000
+#define BLOCK_PAGES 4
+
+static uint64_t time_blocks(uint8_t *low_limit);
+
+void test_palloc_stress(void)
+{
+    void **all = NULL, **kept = NULL, **next, *page;
+    uint8_t *lowest = NULL, *highest = NULL, *limit;
+    uint64_t fresh, fragmented;
+    size_t page_cnt = 0, big;
+
+    fresh = time_blocks(NULL);
+
+    /* Take every page in the pool, chaining them through their
+       first word. */
+    while ((page = palloc_get_page(PAL_USER)) != NULL)
+    {
+        *(void **) page = all;
+        all = page;
+        if (lowest == NULL || (uint8_t *) page < lowest) lowest = page;
+        if (highest == NULL || (uint8_t *) page > highest) highest = page;
+        page_cnt++;
+    }
+    if (page_cnt < 8 * BLOCK_PAGES) fail("only %zu user pages", page_cnt);
+    limit = lowest + (highest - lowest) / 8 * 7;
+
+    /* Give back all but every BLOCK_PAGES'th page below LIMIT. */
+    for (; all != NULL; all = next)
+    {
+        next = *all;
+        if ((uint8_t *) all < limit && pg_no(all) % BLOCK_PAGES == 0)
+        {
+            *all = kept;
+            kept = all;
+        }
+        else
+            palloc_free_page(all);
+    }
+
+    fragmented = time_blocks(limit);
+
+    for (; kept != NULL; kept = next)
+    {
+        next = *kept;
+        palloc_free_page(kept);
+    }
+
+    /* Freed pages must have merged back into large blocks. */
+    for (big = 1; big * 16 <= page_cnt; big *= 2) continue;
+    page = palloc_get_multiple(PAL_USER, big);
+    if (page == NULL) fail("cannot allocate %zu pages after freeing", big);
+    palloc_free_multiple(page, big);
+
+    msg("%zu pages, %d-page blocks.", page_cnt, BLOCK_PAGES);
+    msg("fresh: %llu TSC cycles per allocation.",
+        (unsigned long long) fresh);
+    msg("fragmented: %llu TSC cycles per allocation.",
+        (unsigned long long) fragmented);
+    pass();
+}
+
+/* Allocates and frees a block of BLOCK_PAGES pages ROUNDS times
+   and returns the average TSC cycles per allocation.  Fails if a
+   block starts below LOW_LIMIT. */
+static uint64_t time_blocks(uint8_t *low_limit)
+{
+    uint64_t start, cycles = 0;
+    void *block;
+    int i;
+
+    for (i = 0; i < ROUNDS; i++)
+    {
+        start = rdtsc();
+        block = palloc_get_multiple(PAL_USER, BLOCK_PAGES);
+        cycles += rdtsc() - start;
+
+        if (block == NULL) fail("cannot allocate %d pages", BLOCK_PAGES);
+        if ((uint8_t *) block < low_limit)
+            fail("block at %p inside fragmented region", block);
+        palloc_free_multiple(block, BLOCK_PAGES);
+    }
+    return cycles / ROUNDS;
+}
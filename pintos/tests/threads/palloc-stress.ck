@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing fresh allocation cost in output"
+  unless grep (/^\(palloc-stress\) fresh: \d+ TSC cycles per allocation\.$/, @output);
+fail "missing fragmented allocation cost in output"
+  unless grep (/^\(palloc-stress\) fragmented: \d+ TSC cycles per allocation\.$/, @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(palloc-stress) PASS', @output);
+
+pass;
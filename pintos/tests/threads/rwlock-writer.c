@@ -0,0 +1,57 @@
+/* The main thread acquires a readers-writer lock for reading.
+   Then it creates a writer, which must wait for the main thread
+   to leave, and a higher-priority reader, which must wait behind
+   the writer and donate its priority to it.  When the main
+   thread releases the lock, the writer should get it first, with
+   the reader's priority, and the reader after it. */
+
+#include <stdio.h>
+
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void test_rwlock_writer(void)
+{
+    struct rwlock rw;
+
+    /* This test does not work with the MLFQS. */
+    ASSERT(!thread_mlfqs);
+
+    /* Make sure our priority is the default. */
+    ASSERT(thread_get_priority() == PRI_DEFAULT);
+
+    rwlock_init(&rw);
+    rwlock_read_acquire(&rw);
+    msg("main: holding the lock for reading");
+    thread_create("writer", PRI_DEFAULT + 1, writer_thread_func, &rw);
+    thread_create("reader", PRI_DEFAULT + 2, reader_thread_func, &rw);
+    msg("main: releasing the lock");
+    rwlock_read_release(&rw);
+    msg("writer, reader must already have finished, in that order.");
+    msg("This should be the last line before finishing this test.");
+}
+
+static void writer_thread_func(void *rw_)
+{
+    struct rwlock *rw = rw_;
+
+    rwlock_write_acquire(rw);
+    msg("writer: got the lock with priority %d", thread_get_priority());
+    rwlock_write_release(rw);
+    msg("writer: done");
+}
+
+static void reader_thread_func(void *rw_)
+{
+    struct rwlock *rw = rw_;
+
+    rwlock_read_acquire(rw);
+    msg("reader: got the lock");
+    rwlock_read_release(rw);
+    msg("reader: done");
+}
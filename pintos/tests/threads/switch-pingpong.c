@@ -0,0 +1,56 @@
+/* Measures the cost of a thread switch.
+
+   Runs sema_self_test(), then times the same "ping-pong" between
+   a pair of threads of equal priority over many rounds with the
+   TSC.  Each round blocks each thread once, so it takes exactly
+   two switches.  The result depends on the machine, so the test
+   only checks that the ping-pong completes; compare the printed
+   cost between kernels to see the effect of a change. */
+
+#include <stdio.h>
+
+#include "intrinsic.h"
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ROUNDS 10000
+
+static thread_func pong_thread;
+static struct semaphore ping, pong;
+
+void test_switch_pingpong(void)
+{
+    uint64_t start, cycles;
+    int i;
+
+    sema_self_test();
+
+    sema_init(&ping, 0);
+    sema_init(&pong, 0);
+    thread_create("pong", thread_get_priority(), pong_thread, NULL);
+
+    start = rdtsc();
+    for (i = 0; i < ROUNDS; i++)
+    {
+        sema_up(&ping);
+        sema_down(&pong);
+    }
+    cycles = rdtsc() - start;
+
+    msg("%d round trips, %llu TSC cycles per switch.", ROUNDS,
+        (unsigned long long) (cycles / (2 * ROUNDS)));
+    pass();
+}
+
+static void pong_thread(void *aux UNUSED)
+{
+    int i;
+
+    for (i = 0; i < ROUNDS; i++)
+    {
+        sema_down(&ping);
+        sema_up(&pong);
+    }
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing switch cost in output"
+  unless grep (/^\(switch-pingpong\) \d+ round trips, \d+ TSC cycles per switch\.$/, @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(switch-pingpong) PASS', @output);
+
+pass;
@@ -29,6 +29,18 @@ static const struct test tests[] = {
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"switch-pingpong", test_switch_pingpong},
+    {"cfs-fair-2", test_cfs_fair_2},
+    {"cfs-fair-20", test_cfs_fair_20},
+    {"cfs-nice-2", test_cfs_nice_2},
+    {"cfs-nice-10", test_cfs_nice_10},
+    {"edf-admit", test_edf_admit},
+    {"edf-deadline", test_edf_deadline},
+    {"rwlock-writer", test_rwlock_writer},
+    {"hrtimer-order", test_hrtimer_order},
+    {"palloc-stress", test_palloc_stress},
+    {"kmem-cache", test_kmem_cache},
+    {"kmem-cache-perf", test_kmem_cache_perf},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
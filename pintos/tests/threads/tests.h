@@ -23,6 +23,18 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_switch_pingpong;
+extern test_func test_cfs_fair_2;
+extern test_func test_cfs_fair_20;
+extern test_func test_cfs_nice_2;
+extern test_func test_cfs_nice_10;
+extern test_func test_edf_admit;
+extern test_func test_edf_deadline;
+extern test_func test_rwlock_writer;
+extern test_func test_hrtimer_order;
+extern test_func test_palloc_stress;
+extern test_func test_kmem_cache;
+extern test_func test_kmem_cache_perf;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -0,0 +1,29 @@
+/* Passes clone() FS bases that are not user addresses: one that
+   is not canonical, and one in kernel space.  Both must fail with
+   -1 rather than crash the kernel, and the process must go on. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include <thread.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define STACK_SIZE 4096
+
+static char stack[STACK_SIZE] __attribute__((aligned(16)));
+
+static void never_run(void *aux UNUSED)
+{
+    fail("thread with a bad TLS pointer ran");
+}
+
+void test_main(void)
+{
+    CHECK(clone(never_run, NULL, stack + STACK_SIZE,
+                (void *) 0x8000000000000000ull) == -1,
+          "clone with non-canonical TLS");
+    CHECK(clone(never_run, NULL, stack + STACK_SIZE,
+                (void *) 0x8004000000ull) == -1,
+          "clone with kernel TLS");
+}
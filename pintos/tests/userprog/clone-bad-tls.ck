@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(clone-bad-tls) begin
+(clone-bad-tls) clone with non-canonical TLS
+(clone-bad-tls) clone with kernel TLS
+(clone-bad-tls) end
+clone-bad-tls: exit(0)
+EOF
+pass;
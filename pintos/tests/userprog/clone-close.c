@@ -0,0 +1,61 @@
+/* One thread reads a file over and over while the main thread
+   closes it.  Every read must either return the whole file or,
+   once the file is closed, fail, and so must the calls on the fd
+   after that. */
+
+#include <string.h>
+#include <syscall.h>
+#include <thread.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/userprog/sample.inc"
+
+#define STACK_SIZE 4096
+
+/* Reads to do before the main thread closes the file. */
+#define READS_BEFORE_CLOSE 16
+
+static char stack[STACK_SIZE] __attribute__((aligned(16)));
+static struct
+{
+    void *self;
+} tls;
+static int fd;
+static volatile int read_cnt;
+
+static void read_thread(void *aux UNUSED)
+{
+    static char buf[sizeof sample];
+    int size;
+
+    for (;;)
+    {
+        seek(fd, 0);
+        size = read(fd, buf, sizeof sample - 1);
+        if (size == -1) break;
+        if (size != sizeof sample - 1 || memcmp(buf, sample, size))
+            thread_exit(1);
+        read_cnt++;
+    }
+    if (filesize(fd) != -1) thread_exit(2);
+    thread_exit(0);
+}
+
+void test_main(void)
+{
+    tid_t tid;
+    char byte;
+
+    CHECK((fd = open("sample.txt")) > 1, "open \"sample.txt\"");
+
+    tls.self = &tls;
+    tid = thread_create(read_thread, NULL, stack, STACK_SIZE, &tls);
+    CHECK(tid != TID_ERROR, "create reading thread");
+    while (read_cnt < READS_BEFORE_CLOSE) continue;
+
+    msg("close \"sample.txt\"");
+    close(fd);
+    CHECK(thread_join(tid) == 0, "reads succeed until the close");
+    CHECK(read(fd, &byte, 1) == -1, "read after close fails");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(clone-close) begin
+(clone-close) open "sample.txt"
+(clone-close) create reading thread
+(clone-close) close "sample.txt"
+(clone-close) reads succeed until the close
+(clone-close) read after close fails
+(clone-close) end
+clone-close: exit(0)
+EOF
+pass;
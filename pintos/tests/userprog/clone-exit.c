@@ -0,0 +1,46 @@
+/* A thread calls exit() while the main thread is blocked joining
+   it and another thread spins in user mode.  The whole process
+   must end with the status passed to exit(), reported once, by
+   the main thread. */
+
+#include <syscall.h>
+#include <thread.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define STACK_SIZE 4096
+
+static char stacks[2][STACK_SIZE] __attribute__((aligned(16)));
+static struct
+{
+    void *self;
+} tls[2];
+static volatile int spinning;
+
+static void spin_thread(void *aux UNUSED)
+{
+    spinning = 1;
+    for (;;)
+        continue;
+}
+
+static void exit_thread_func(void *aux UNUSED)
+{
+    while (!spinning) continue;
+    exit(42);
+}
+
+void test_main(void)
+{
+    tid_t spinner, exiter;
+
+    tls[0].self = &tls[0];
+    tls[1].self = &tls[1];
+    spinner = thread_create(spin_thread, NULL, stacks[0], STACK_SIZE, &tls[0]);
+    exiter = thread_create(exit_thread_func, NULL, stacks[1], STACK_SIZE,
+                           &tls[1]);
+    CHECK(spinner != TID_ERROR && exiter != TID_ERROR, "create threads");
+    thread_join(exiter);
+    fail("should have exited with 42");
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(clone-exit) begin
+(clone-exit) create threads
+clone-exit: exit(42)
+EOF
+pass;
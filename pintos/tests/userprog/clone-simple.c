@@ -0,0 +1,75 @@
+/* Starts several threads in one process.  Each adds up its share
+   of an array into a total protected by a mutex and checks that
+   its TLS pointer is the one it was given, then the main thread
+   joins them all and checks the total. */
+
+#include <synch.h>
+#include <syscall.h>
+#include <thread.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define STACK_SIZE 4096
+#define ELEM_CNT 1024
+
+struct tls
+{
+    struct tls *self; /* Required by the ABI. */
+    int idx;          /* Which thread this is. */
+};
+
+static char stacks[THREAD_CNT][STACK_SIZE] __attribute__((aligned(16)));
+static struct tls tls[THREAD_CNT];
+static int values[ELEM_CNT];
+static struct mutex mutex;
+static long long total;
+
+static void sum_thread(void *aux)
+{
+    int idx = (int) (long) aux;
+    struct tls *t = thread_tls();
+    long long sum = 0;
+    int i;
+
+    if (t != &tls[idx] || t->idx != idx) thread_exit(-1);
+
+    for (i = idx; i < ELEM_CNT; i += THREAD_CNT) sum += values[i];
+
+    mutex_lock(&mutex);
+    total += sum;
+    mutex_unlock(&mutex);
+    thread_exit(idx + 10);
+}
+
+void test_main(void)
+{
+    tid_t tids[THREAD_CNT];
+    long long expected = 0;
+    int i;
+
+    for (i = 0; i < ELEM_CNT; i++)
+    {
+        values[i] = i * 3 + 1;
+        expected += values[i];
+    }
+    mutex_init(&mutex);
+
+    for (i = 0; i < THREAD_CNT; i++)
+    {
+        tls[i].self = &tls[i];
+        tls[i].idx = i;
+        tids[i] = thread_create(sum_thread, (void *) (long) i, stacks[i],
+                                STACK_SIZE, &tls[i]);
+        CHECK(tids[i] != TID_ERROR, "create thread %d", i);
+    }
+
+    for (i = 0; i < THREAD_CNT; i++)
+        CHECK(thread_join(tids[i]) == i + 10, "join thread %d", i);
+    CHECK(thread_join(tids[0]) == -1, "join thread 0 again");
+    CHECK(wait(tids[1]) == -1, "wait for a thread");
+
+    if (total != expected) fail("total %lld, expected %lld", total, expected);
+    msg("total correct");
+}
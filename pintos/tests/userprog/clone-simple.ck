@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(clone-simple) begin
+(clone-simple) create thread 0
+(clone-simple) create thread 1
+(clone-simple) create thread 2
+(clone-simple) create thread 3
+(clone-simple) join thread 0
+(clone-simple) join thread 1
+(clone-simple) join thread 2
+(clone-simple) join thread 3
+(clone-simple) join thread 0 again
+(clone-simple) wait for a thread
+(clone-simple) total correct
+(clone-simple) end
+clone-simple: exit(0)
+EOF
+pass;
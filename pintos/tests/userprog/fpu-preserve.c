@@ -0,0 +1,137 @@
+/* Loads values into SSE registers and checks that they are still
+   there after fork(), in the parent and in the child, after
+   blocking in wait() while the child runs with values of its
+   own, and after being preempted, over several time slices, by a
+   thread of the same process that keeps other values in the same
+   registers.
+
+   Only xmm8 through xmm15 are used.  The code between loading
+   and checking them is too simple for the compiler to use those
+   registers itself. */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <syscall.h>
+#include <thread.h>
+#include <vdso.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of registers used, and 64-bit words in them. */
+#define XMM_CNT 8
+#define WORD_CNT (XMM_CNT * 2)
+
+/* Time slices to spin for; see TIME_SLICE in threads/thread.c. */
+#define SPIN_TICKS (3 * 4)
+
+#define STACK_SIZE 4096
+
+static char stack[STACK_SIZE] __attribute__((aligned(16)));
+static struct
+{
+    void *self;
+} tls;
+static volatile int sibling_started;
+
+/* Loads xmm8...xmm15 from V. */
+static void xmm_set(const uint64_t v[WORD_CNT])
+{
+    asm volatile("movdqu 0x00(%0), %%xmm8\n"
+                 "movdqu 0x10(%0), %%xmm9\n"
+                 "movdqu 0x20(%0), %%xmm10\n"
+                 "movdqu 0x30(%0), %%xmm11\n"
+                 "movdqu 0x40(%0), %%xmm12\n"
+                 "movdqu 0x50(%0), %%xmm13\n"
+                 "movdqu 0x60(%0), %%xmm14\n"
+                 "movdqu 0x70(%0), %%xmm15\n"
+                 :
+                 : "r"(v)
+                 : "memory");
+}
+
+/* Stores xmm8...xmm15 into V. */
+static void xmm_get(uint64_t v[WORD_CNT])
+{
+    asm volatile("movdqu %%xmm8, 0x00(%0)\n"
+                 "movdqu %%xmm9, 0x10(%0)\n"
+                 "movdqu %%xmm10, 0x20(%0)\n"
+                 "movdqu %%xmm11, 0x30(%0)\n"
+                 "movdqu %%xmm12, 0x40(%0)\n"
+                 "movdqu %%xmm13, 0x50(%0)\n"
+                 "movdqu %%xmm14, 0x60(%0)\n"
+                 "movdqu %%xmm15, 0x70(%0)\n"
+                 :
+                 : "r"(v)
+                 : "memory");
+}
+
+/* Fills V with a pattern that depends on SEED. */
+static void pattern(uint64_t v[WORD_CNT], uint64_t seed)
+{
+    int i;
+
+    for (i = 0; i < WORD_CNT; i++)
+        v[i] = seed * 0x9e3779b97f4a7c15ull + i * 0x0101010101010101ull;
+}
+
+/* Returns true if the registers hold the pattern for SEED. */
+static bool xmm_holds(uint64_t seed)
+{
+    uint64_t expected[WORD_CNT], actual[WORD_CNT];
+    int i;
+
+    xmm_get(actual);
+    pattern(expected, seed);
+    for (i = 0; i < WORD_CNT; i++)
+        if (actual[i] != expected[i]) return false;
+    return true;
+}
+
+/* Loads the pattern for SEED, then checks it continually for
+   SPIN_TICKS timer ticks.  Returns true if it never changed. */
+static bool spin_holding(uint64_t seed)
+{
+    uint64_t v[WORD_CNT];
+    int64_t start;
+
+    pattern(v, seed);
+    xmm_set(v);
+    start = clock_ticks();
+    while (clock_ticks() < start + SPIN_TICKS)
+        if (!xmm_holds(seed)) return false;
+    return true;
+}
+
+static void sibling_thread(void *aux UNUSED)
+{
+    sibling_started = 1;
+    thread_exit(spin_holding(3) ? 0 : 1);
+}
+
+void test_main(void)
+{
+    uint64_t v[WORD_CNT];
+    int pid, tid;
+
+    pattern(v, 1);
+    xmm_set(v);
+    if ((pid = fork("child")) == 0)
+    {
+        if (!xmm_holds(1)) exit(1);
+        exit(spin_holding(2) ? 0 : 2);
+    }
+    CHECK(xmm_holds(1), "parent keeps registers across fork");
+    CHECK(pid != PID_ERROR, "fork child");
+
+    xmm_set(v);
+    CHECK(wait(pid) == 0, "child keeps registers across fork and spin");
+    CHECK(xmm_holds(1), "parent keeps registers across wait");
+
+    tls.self = &tls;
+    tid = thread_create(sibling_thread, NULL, stack, STACK_SIZE, &tls);
+    CHECK(tid != TID_ERROR, "create sibling thread");
+    while (!sibling_started) continue;
+    CHECK(spin_holding(4), "main thread keeps registers while preempted");
+    CHECK(thread_join(tid) == 0, "sibling keeps registers while preempted");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fpu-preserve) begin
+(fpu-preserve) parent keeps registers across fork
+(fpu-preserve) fork child
+child: exit(0)
+(fpu-preserve) child keeps registers across fork and spin
+(fpu-preserve) parent keeps registers across wait
+(fpu-preserve) create sibling thread
+(fpu-preserve) main thread keeps registers while preempted
+(fpu-preserve) sibling keeps registers while preempted
+(fpu-preserve) end
+fpu-preserve: exit(0)
+EOF
+pass;
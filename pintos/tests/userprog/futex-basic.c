@@ -0,0 +1,33 @@
+/* Exercises the futex system call and the user-space mutex and
+   condition variable built on it, within a single thread. */
+
+#include <synch.h>
+#include <syscall.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void)
+{
+    static int word = 1;
+    struct mutex mutex;
+    struct condvar cond;
+
+    CHECK(futex(&word, FUTEX_WAIT, 0) == -1, "wait with stale value");
+    CHECK(futex(&word, FUTEX_WAKE, 1) == 0, "wake with no waiters");
+    CHECK(futex(&word, 42, 0) == -1, "reject bad operation");
+
+    mutex_init(&mutex);
+    mutex_lock(&mutex);
+    CHECK(!mutex_trylock(&mutex), "trylock fails while locked");
+    mutex_unlock(&mutex);
+    CHECK(mutex_trylock(&mutex), "trylock succeeds when unlocked");
+    mutex_unlock(&mutex);
+
+    condvar_init(&cond);
+    mutex_lock(&mutex);
+    condvar_signal(&cond);
+    condvar_broadcast(&cond);
+    mutex_unlock(&mutex);
+    msg("signal with no waiters");
+}
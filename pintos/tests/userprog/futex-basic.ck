@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-basic) begin
+(futex-basic) wait with stale value
+(futex-basic) wake with no waiters
+(futex-basic) reject bad operation
+(futex-basic) trylock fails while locked
+(futex-basic) trylock succeeds when unlocked
+(futex-basic) signal with no waiters
+(futex-basic) end
+futex-basic: exit(0)
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Joins the EDF scheduling class, runs a few short periodic jobs,
+   and checks that none of them missed its deadline. */
+
+#include <syscall.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define JOB_CNT 10
+
+void test_main(void)
+{
+    volatile int work = 0;
+    int misses = 0;
+    int i, j;
+
+    CHECK(!sched_deadline(11, 10), "reject runtime > period");
+    CHECK(!sched_deadline(1, 0), "reject zero period");
+    CHECK(sched_deadline(2, 10), "admit 2 ticks every 10");
+
+    for (i = 0; i < JOB_CNT; i++)
+    {
+        for (j = 0; j < 1000; j++) work++;
+        misses = sched_wait();
+    }
+    msg("%d jobs, %d deadlines missed", JOB_CNT, misses);
+
+    CHECK(sched_deadline(0, 0), "leave EDF class");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-deadline) begin
+(sched-deadline) reject runtime > period
+(sched-deadline) reject zero period
+(sched-deadline) admit 2 ticks every 10
+(sched-deadline) 10 jobs, 0 deadlines missed
+(sched-deadline) leave EDF class
+(sched-deadline) end
+sched-deadline: exit(0)
+EOF
+pass;
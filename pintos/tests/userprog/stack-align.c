@@ -0,0 +1,24 @@
+/* Checks that a process starts with the stack aligned as the
+   x86-64 ABI requires, by storing to a 16-byte aligned local with
+   movaps, which faults if it is not aligned.  Run with an odd
+   number of arguments whose strings take a multiple of 16 bytes,
+   which an 8-byte aligned stack gets wrong. */
+
+#include <stdint.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void)
+{
+    uint64_t buf[2] __attribute__((aligned(16)));
+
+    if ((uintptr_t) buf % 16 != 0)
+        fail("aligned local at %p", (void *) buf);
+    asm volatile("pxor %%xmm0, %%xmm0\n"
+                 "movaps %%xmm0, %0"
+                 : "=m"(buf)
+                 :
+                 : "xmm0");
+    msg("aligned SSE store");
+}
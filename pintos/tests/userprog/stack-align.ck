@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stack-align) begin
+(stack-align) aligned SSE store
+(stack-align) end
+stack-align: exit(0)
+EOF
+pass;
@@ -0,0 +1,53 @@
+/* Reads the clock and the process id from the pages the kernel
+   maps into every process.  The nanosecond clock must keep pace
+   with the timer ticks, and a forked child must see the pid that
+   fork() returned to its parent. */
+
+#include <syscall.h>
+#include <vdso.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void)
+{
+    uint64_t ns_per_tick = 1000000000ull / clock_freq();
+    uint64_t start_ns, end_ns, prev_ns, ns;
+    int64_t start;
+    int pid, child_pid, fd;
+
+    /* Spin across two tick boundaries, so that at least one whole
+       tick passes, checking that the clock never goes backward. */
+    start = clock_ticks();
+    while (clock_ticks() == start) continue;
+    start_ns = prev_ns = clock_ns();
+    start = clock_ticks();
+    while (clock_ticks() < start + 2)
+    {
+        ns = clock_ns();
+        if (ns < prev_ns) fail("clock went backward");
+        prev_ns = ns;
+    }
+    end_ns = clock_ns();
+    CHECK(end_ns - start_ns >= ns_per_tick &&
+              end_ns - start_ns < 100 * ns_per_tick,
+          "clock keeps pace with ticks");
+
+    CHECK(create("pid", sizeof child_pid), "create \"pid\"");
+    if ((pid = fork("child")))
+    {
+        CHECK(wait(pid) == 0, "wait for child");
+        CHECK((fd = open("pid")) > 1, "open \"pid\"");
+        CHECK(read(fd, &child_pid, sizeof child_pid) == sizeof child_pid,
+              "read \"pid\"");
+        if (child_pid != pid) fail("child saw pid %d, not %d", child_pid, pid);
+        CHECK(getpid() != pid, "pids differ");
+    }
+    else
+    {
+        child_pid = getpid();
+        fd = open("pid");
+        write(fd, &child_pid, sizeof child_pid);
+        exit(0);
+    }
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vdso-clock) begin
+(vdso-clock) clock keeps pace with ticks
+(vdso-clock) create "pid"
+child: exit(0)
+(vdso-clock) wait for child
+(vdso-clock) open "pid"
+(vdso-clock) read "pid"
+(vdso-clock) pids differ
+(vdso-clock) end
+vdso-clock: exit(0)
+EOF
+pass;
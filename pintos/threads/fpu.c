@@ -0,0 +1,241 @@
+#include "threads/fpu.h"
+
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "intrinsic.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Lazy FPU context switching.
+
+   The kernel is compiled without floating point, so the x87,
+   SSE and AVX registers only ever hold the state of a user
+   thread.  That state is not switched along with the general
+   purpose registers.  Instead, schedule() sets CR0.TS, and the
+   first FPU or SIMD instruction the next thread executes raises
+   #NM (device not available).  Only then do we load its state,
+   from a page allocated the first time it needed one.  A thread
+   that never touches the FPU never traps and owns no page.
+
+   Each processor remembers the thread whose state is in its
+   registers (cpu->fpu_owner).  If that thread runs there again
+   and nobody else has loaded state since, TS stays clear and
+   there is no trap at all.  Because a thread may come back on a
+   different processor, its state is written back to memory when
+   it is switched out after using the FPU, rather than when
+   somebody else wants the registers.
+
+   The state is saved with XSAVE when the processor has it,
+   which covers AVX, and with FXSAVE (x87 and SSE only)
+   otherwise.  See [IA32-v1] chapter 13 "Managing State Using
+   the XSAVE Feature Set". */
+
+/* Control register bits. */
+#define CR0_MP (1 << 1)          /* Monitor coprocessor. */
+#define CR0_EM (1 << 2)          /* Emulation. */
+#define CR0_TS (1 << 3)          /* Task switched. */
+#define CR0_NE (1 << 5)          /* Native FPU error reporting. */
+#define CR4_OSFXSR (1 << 9)      /* FXSAVE/FXRSTOR and SSE. */
+#define CR4_OSXMMEXCPT (1 << 10) /* #XM for SSE exceptions. */
+#define CR4_OSXSAVE (1 << 18)    /* XSAVE and XCR0. */
+
+/* CPUID.1:ECX bit for XSAVE support. */
+#define CPUID_1_ECX_XSAVE (1 << 26)
+
+/* XCR0 state components we enable, if supported: x87, SSE, AVX,
+   and the three AVX-512 components. */
+#define XCR0_WANTED 0xe7
+
+/* True if the processors support XSAVE. */
+static bool use_xsave;
+
+/* Bytes in a save area, at most PGSIZE. */
+static size_t fpu_size;
+
+/* XCR0 value for every processor. */
+static uint64_t xcr0;
+
+static void fpu_enable(void);
+static void fpu_save(void *);
+static void fpu_restore(const void *);
+static intr_handler_func nm_handler;
+
+/* Enables the FPU on the BSP and installs the #NM handler.  Must
+   be called after intr_init(). */
+void fpu_init(void)
+{
+    uint32_t a, b, c, d;
+
+    cpuid(1, 0, &a, &b, &c, &d);
+    use_xsave = (c & CPUID_1_ECX_XSAVE) != 0;
+    if (use_xsave)
+    {
+        cpuid(0xd, 0, &a, &b, &c, &d);
+        xcr0 = a & XCR0_WANTED;
+    }
+
+    fpu_enable();
+    if (use_xsave)
+    {
+        /* EBX now reports the size for the components in XCR0. */
+        cpuid(0xd, 0, &a, &b, &c, &d);
+        fpu_size = b;
+    }
+    else
+        fpu_size = 512;
+    ASSERT(fpu_size <= PGSIZE);
+
+    intr_register_int(7, 0, INTR_OFF, nm_handler,
+                      "#NM Device Not Available Exception");
+}
+
+/* Enables the FPU on an AP, the same way as fpu_init() did on the
+   BSP. */
+void fpu_init_ap(void)
+{
+    fpu_enable();
+}
+
+/* Called by schedule() with interrupts off, just before switching
+   from PREV to NEXT. */
+void fpu_switch(struct thread *prev, struct thread *next)
+{
+    struct cpu *cpu = this_cpu();
+    uint64_t cr0 = rcr0();
+
+    /* TS is clear only while the owner runs, so if PREV has it
+       clear, its registers may have changed since they were
+       loaded. */
+    if (!(cr0 & CR0_TS) && cpu->fpu_owner == prev) fpu_save(prev->fpu);
+
+    if (cpu->fpu_owner == next && next->fpu_cpu == cpu)
+        cr0 &= ~CR0_TS;
+    else
+        cr0 |= CR0_TS;
+    lcr0(cr0);
+}
+
+/* Gives DST a copy of SRC's FPU state, if SRC has one, as for
+   fork().  SRC must not be running.  Returns true if successful,
+   false if out of memory. */
+bool fpu_copy(struct thread *dst, const struct thread *src)
+{
+    ASSERT(dst->fpu == NULL);
+
+    if (src->fpu == NULL) return true;
+
+    dst->fpu = palloc_get_page(0);
+    if (dst->fpu == NULL) return false;
+    memcpy(dst->fpu, src->fpu, fpu_size);
+    return true;
+}
+
+/* Frees T's FPU state and makes sure no processor considers its
+   registers to be T's, so that T, if it runs again, starts from
+   the initial state.  Called on exit and exec. */
+void fpu_release(struct thread *t)
+{
+    enum intr_level old_level = intr_disable();
+    int i;
+
+    for (i = 0; i < smp_cpu_cnt; i++)
+        if (cpus[i].fpu_owner == t) cpus[i].fpu_owner = NULL;
+    if (t->fpu_cpu == this_cpu()) lcr0(rcr0() | CR0_TS);
+    t->fpu_cpu = NULL;
+    intr_set_level(old_level);
+
+    if (t->fpu != NULL)
+    {
+        palloc_free_page(t->fpu);
+        t->fpu = NULL;
+    }
+}
+
+/* Turns on the FPU and SSE for the running processor, with TS
+   set so that the first use traps. */
+static void fpu_enable(void)
+{
+    uint64_t cr4 = rcr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+
+    if (use_xsave) cr4 |= CR4_OSXSAVE;
+    lcr4(cr4);
+    if (use_xsave)
+        asm volatile("xsetbv"
+                     :
+                     : "c"(0), "a"((uint32_t) xcr0),
+                       "d"((uint32_t) (xcr0 >> 32)));
+
+    lcr0((rcr0() & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS);
+}
+
+/* Saves the FPU registers to AREA.  TS must be clear. */
+static void fpu_save(void *area)
+{
+    if (use_xsave)
+        asm volatile("xsave64 (%0)"
+                     :
+                     : "r"(area), "a"(0xffffffff), "d"(0xffffffff)
+                     : "memory");
+    else
+        asm volatile("fxsave64 (%0)" : : "r"(area) : "memory");
+}
+
+/* Loads the FPU registers from AREA.  TS must be clear. */
+static void fpu_restore(const void *area)
+{
+    if (use_xsave)
+        asm volatile("xrstor64 (%0)"
+                     :
+                     : "r"(area), "a"(0xffffffff), "d"(0xffffffff)
+                     : "memory");
+    else
+        asm volatile("fxrstor64 (%0)" : : "r"(area) : "memory");
+}
+
+/* #NM handler: the running thread has used the FPU with TS set,
+   so give it its registers. */
+static void nm_handler(struct intr_frame *f)
+{
+    struct thread *curr = thread_current();
+    struct cpu *cpu;
+
+    if (f->cs == SEL_KCSEG)
+    {
+        intr_dump_frame(f);
+        PANIC("Kernel bug - FPU used in kernel");
+    }
+
+    if (curr->fpu == NULL)
+    {
+        /* First use.  A zeroed area with the default control words
+           loads as the initial state: the XSAVE header in it says
+           that every component is in its initial configuration. */
+        uint8_t *area = palloc_get_page(PAL_ZERO);
+
+        if (area == NULL)
+        {
+            printf("%s: dying due to out of memory for FPU state.\n",
+                   thread_name());
+            curr->exit_status = -1;
+            thread_exit();
+        }
+        *(uint16_t *) (area + 0) = 0x037f;  /* FCW: all masked. */
+        *(uint32_t *) (area + 24) = 0x1f80; /* MXCSR: all masked. */
+        curr->fpu = area;
+    }
+
+    /* Allocating may have slept, so look up the processor now.
+       Whatever the registers held has been saved already, by
+       fpu_switch() when its owner was switched out. */
+    cpu = this_cpu();
+    asm volatile("clts");
+    fpu_restore(curr->fpu);
+    cpu->fpu_owner = curr;
+    curr->fpu_cpu = cpu;
+}
@@ -15,20 +15,27 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "intrinsic.h"
 #include "threads/interrupt.h"
+#include "threads/fpu.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/process.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/vdso.h"
 #endif
 #include "tests/threads/tests.h"
 #ifdef VM
@@ -55,11 +62,13 @@ bool thread_tests;
 
 static void bss_init(void);
 static void paging_init(uint64_t mem_end);
+static bool direct_map_fits(uint64_t pa, uint64_t size, uint64_t mem_end);
 
 static char **read_command_line(void);
 static char **parse_options(char **argv);
 static void run_actions(char **argv);
 static void usage(void);
+static void parse_features(char *features);
 
 static void print_stats(void);
 
@@ -87,6 +96,7 @@ int main(void)
     mem_end = palloc_init();
     malloc_init();
     paging_init(mem_end);
+    smp_init();
 
 #ifdef USERPROG
     tss_init();
@@ -98,14 +108,22 @@ int main(void)
     timer_init();
     kbd_init();
     input_init();
+    fpu_init();
 #ifdef USERPROG
     exception_init();
     syscall_init();
+    futex_init();
 #endif
     /* Start thread scheduler and enable interrupts. */
     thread_start();
+    workqueue_init();
+    palloc_zero_init();
     serial_init_queue();
     timer_calibrate();
+#ifdef USERPROG
+    vdso_init();
+#endif
+    smp_start();
 
 #ifdef FILESYS
     /* Initialize file system. */
@@ -142,29 +160,66 @@ static void bss_init(void)
 
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ * The mapping uses the largest pages that fit: 1 GiB pages if the
+ * CPU has them, otherwise 2 MiB pages, and 4 kB pages only where
+ * neither fits, such as around the end of the read-only kernel
+ * text. */
 static void paging_init(uint64_t mem_end)
 {
-    uint64_t *pml4, *pte;
-    int perm;
+    uint64_t *pml4;
+    uint32_t a, b, c, d;
+    bool gb_pages = false;
     pml4 = base_pml4 = palloc_get_page(PAL_ASSERT | PAL_ZERO);
 
+    /* CPUID.80000001H:EDX.Page1GB[bit 26]. */
+    cpuid(0x80000000, 0, &a, &b, &c, &d);
+    if (a >= 0x80000001)
+    {
+        cpuid(0x80000001, 0, &a, &b, &c, &d);
+        gb_pages = (d & (1u << 26)) != 0;
+    }
+
     extern char start, _end_kernel_text;
     // Maps physical address [0 ~ mem_end] to
     //   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-    for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE)
+    for (uint64_t pa = 0, size; pa < mem_end; pa += size)
     {
         uint64_t va = (uint64_t) ptov(pa);
 
-        perm = PTE_P | PTE_W;
-        if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
-            perm &= ~PTE_W;
+        if (gb_pages && direct_map_fits(pa, PDPE_PGSIZE, mem_end))
+            size = PDPE_PGSIZE;
+        else if (direct_map_fits(pa, PDE_PGSIZE, mem_end))
+            size = PDE_PGSIZE;
+        else
+            size = PGSIZE;
 
-        if ((pte = pml4e_walk(pml4, va, 1)) != NULL) *pte = pa | perm;
+        if (!pml4_set_kernel_page(
+                pml4, va, pa, size,
+                !((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)))
+            PANIC("out of memory for kernel page tables");
     }
 
     // reload cr3
     pml4_activate(0);
+    palloc_paging_ready();
+}
+
+/* Returns true if the SIZE bytes of physical memory at PA, where
+ * SIZE is a large page size, can be mapped with a single large
+ * page by paging_init(): PA and its kernel virtual address are
+ * aligned to SIZE, they end by MEM_END, and they lie wholly inside
+ * or wholly outside the kernel text, which is read-only. */
+static bool direct_map_fits(uint64_t pa, uint64_t size, uint64_t mem_end)
+{
+    extern char start, _end_kernel_text;
+    uint64_t va = (uint64_t) ptov(pa);
+    uint64_t text_start = (uint64_t) &start;
+    uint64_t text_end = (uint64_t) &_end_kernel_text;
+
+    if (pa % size != 0 || va % size != 0 || pa + size > mem_end) return false;
+    return !(va < text_start && text_start < va + size) &&
+           !(va < text_end && text_end < va + size);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -222,6 +277,13 @@ static char **parse_options(char **argv)
             random_init(atoi(value));
         else if (!strcmp(name, "-mlfqs"))
             thread_mlfqs = true;
+        else if (!strcmp(name, "-o"))
+        {
+            /* Accept both "-o=FEATURE" and "-o FEATURE". */
+            if (value == NULL && argv[1] != NULL) value = *++argv;
+            if (value == NULL) PANIC("option `-o' requires a feature");
+            parse_features(value);
+        }
 #ifdef USERPROG
         else if (!strcmp(name, "-ul"))
             user_page_limit = atoi(value);
@@ -232,9 +294,34 @@ static char **parse_options(char **argv)
             PANIC("unknown option `%s' (use -h for help)", name);
     }
 
+    if (thread_mlfqs && thread_cfs)
+        PANIC("-mlfqs and -o cfs are mutually exclusive");
+
     return argv;
 }
 
+/* Turns on each feature in the comma-separated list FEATURES,
+   given with -o. */
+static void parse_features(char *features)
+{
+    char *feature, *save_ptr;
+
+    for (feature = strtok_r(features, ",", &save_ptr); feature != NULL;
+         feature = strtok_r(NULL, ",", &save_ptr))
+    {
+        if (!strcmp(feature, "lockstat"))
+            lockstat_enabled = true;
+        else if (!strcmp(feature, "schedlat"))
+            schedlat_enabled = true;
+        else if (!strcmp(feature, "cfs"))
+            thread_cfs = true;
+        else if (!strcmp(feature, "intrstat"))
+            intrstat_enabled = true;
+        else
+            PANIC("unknown feature `%s' (use -h for help)", feature);
+    }
+}
+
 /* Runs the task specified in ARGV[1]. */
 static void run_task(char **argv)
 {
@@ -330,6 +417,11 @@ static void usage(void)
         "  -f                 Format file system disk during startup.\n"
         "  -rs=SEED           Set random number seed to SEED.\n"
         "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+        "  -o FEATURE[,...]   Turn on optional FEATUREs:\n"
+        "    lockstat           Print lock contention statistics at exit.\n"
+        "    schedlat           Print scheduling latency histograms at exit.\n"
+        "    cfs                Use completely fair scheduler.\n"
+        "    intrstat           Print interrupt handler times at exit.\n"
 #ifdef USERPROG
         "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -348,6 +440,7 @@ void power_off(void)
     print_stats();
 
     printf("Powering off...\n");
+    serial_flush();
     outw(0x604, 0x2000); /* Poweroff command for qemu */
     for (;;)
         ;
@@ -358,6 +451,8 @@ static void print_stats(void)
 {
     timer_print_stats();
     thread_print_stats();
+    workqueue_print_stats();
+    palloc_print_stats();
 #ifdef FILESYS
     disk_print_stats();
 #endif
@@ -366,4 +461,6 @@ static void print_stats(void)
 #ifdef USERPROG
     exception_print_stats();
 #endif
+    lockstat_print_stats();
+    intr_print_stats();
 }
@@ -10,11 +10,15 @@
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/ioapic.h"
+#include "threads/lapic.h"
 #include "threads/mmu.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #ifdef USERPROG
 #include "userprog/gdt.h"
+#include "userprog/syscall.h"
 #endif
 
 /* Number of x86_64 interrupts. */
@@ -91,15 +95,52 @@ static intr_handler_func *intr_handlers[INTR_CNT];
 /* Names for each interrupt, for debugging purposes. */
 static const char *intr_names[INTR_CNT];
 
+/* Time spent in each external interrupt's handler, in TSC cycles,
+   kept with -o intrstat. */
+bool intrstat_enabled;
+static uint64_t intr_cnt[INTR_CNT];
+static uint64_t intr_cycles[INTR_CNT];
+static uint64_t intr_cycles_max[INTR_CNT];
+
 /* External interrupts are those generated by devices outside the
    CPU, such as the timer.  External interrupts run with
    interrupts turned off, so they never nest, nor are they ever
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr; /* Are we processing an external interrupt? */
-static bool yield_on_return;  /* Should we yield on interrupt return? */
+   interrupt returns.  Whether we are processing an external
+   interrupt, and whether to yield on its return, is kept per
+   processor in `struct cpu'. */
+
+/* Returns true if VEC_NO is an external interrupt: one from the
+   PICs, or one from a local APIC other than a spurious one. */
+#define is_external(vec_no)                       \
+    (((vec_no) >= 0x20 && (vec_no) < 0x30) ||     \
+     ((vec_no) >= LAPIC_VEC_TIMER && (vec_no) < LAPIC_VEC_SPURIOUS))
+
+/* The big kernel lock.
+
+   A processor holds it exactly while its interrupts are off:
+   intr_disable() acquires it, intr_enable() releases it, and so
+   do entry to and return from an interrupt handler entered with
+   interrupts on.  Everything that relies on disabled interrupts
+   for mutual exclusion, from the scheduler to semaphores and
+   everything built on them, is thereby also serialized across
+   processors, while user programs and kernel code that runs with
+   interrupts on proceed in parallel.
+
+   A thread switch happens with interrupts off, so the lock is
+   handed from the thread switched away from to the thread
+   switched to, which releases it when it turns interrupts back
+   on.  The BSP boots with interrupts off, so it boots holding the
+   lock. */
+static struct spinlock giant = {1};
+
+/* Do the PIC vectors 0x20...0x2f come from the I/O APIC instead
+   of the PICs?  If so, they are routed to the BSP one by one as
+   their handlers are registered, and acknowledged on the local
+   APIC like the rest. */
+static bool ioapic_mode;
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init(void);
@@ -135,6 +176,8 @@ enum intr_level intr_enable(void)
     enum intr_level old_level = intr_get_level();
     ASSERT(!intr_context());
 
+    if (old_level == INTR_OFF) spinlock_release(&giant);
+
     /* Enable interrupts by setting the interrupt flag.
 
        See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -154,16 +197,48 @@ enum intr_level intr_disable(void)
        Hardware Interrupts". */
     asm volatile("cli" : : : "memory");
 
+    if (old_level == INTR_ON) spinlock_acquire(&giant);
+
     return old_level;
 }
 
+/* Re-enables interrupts and waits for the next one, with
+   interrupts off on entry.  Used by the idle thread.
+
+   The `sti' instruction disables interrupts until the completion
+   of the next instruction, so these two instructions are
+   executed atomically.  This atomicity is important; otherwise,
+   an interrupt could be handled between re-enabling interrupts
+   and waiting for the next one to occur, wasting as much as one
+   clock tick worth of time.
+
+   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a] 7.11.1
+   "HLT Instruction". */
+void intr_wait(void)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(!intr_context());
+
+    spinlock_release(&giant);
+    asm volatile("sti; hlt" : : : "memory");
+}
+
 /* Initializes the interrupt system. */
 void intr_init(void)
 {
     int i;
 
-    /* Initialize interrupt controller. */
+    /* Initialize interrupt controller.  The PICs are programmed
+       even when the I/O APIC replaces them, so that a stray
+       interrupt they raise lands on a vector we know. */
     pic_init();
+    if (ioapic_present())
+    {
+        outb(0x21, 0xff);
+        outb(0xa1, 0xff);
+        lapic_mask_lint0();
+        ioapic_mode = true;
+    }
 
     /* Initialize IDT. */
     for (i = 0; i < INTR_CNT; i++)
@@ -202,6 +277,17 @@ void intr_init(void)
     intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Loads the IDT on an application processor, which starts out
+   with interrupts off.  Also acquires the big kernel lock, so
+   that from here on the AP plays by the same rules as the BSP. */
+void intr_init_ap(void)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    spinlock_acquire(&giant);
+    lidt(&idt_desc);
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -224,12 +310,15 @@ static void register_handler(uint8_t vec_no, int dpl, enum intr_level level,
 
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The handler will
-   execute with interrupts disabled. */
+   execute with interrupts disabled.  A PIC vector is routed to
+   the BSP through the I/O APIC, if we use one. */
 void intr_register_ext(uint8_t vec_no, intr_handler_func *handler,
                        const char *name)
 {
-    ASSERT(vec_no >= 0x20 && vec_no <= 0x2f);
+    ASSERT(is_external(vec_no));
     register_handler(vec_no, 0, INTR_OFF, handler, name);
+    if (ioapic_mode && vec_no < 0x30)
+        ioapic_route(vec_no - 0x20, vec_no, cpus[0].lapic_id);
 }
 
 /* Registers internal interrupt VEC_NO to invoke HANDLER, which
@@ -248,7 +337,7 @@ void intr_register_ext(uint8_t vec_no, intr_handler_func *handler,
 void intr_register_int(uint8_t vec_no, int dpl, enum intr_level level,
                        intr_handler_func *handler, const char *name)
 {
-    ASSERT(vec_no < 0x20 || vec_no > 0x2f);
+    ASSERT(!is_external(vec_no));
     register_handler(vec_no, dpl, level, handler, name);
 }
 
@@ -256,7 +345,7 @@ void intr_register_int(uint8_t vec_no, int dpl, enum intr_level level,
    and false at all other times. */
 bool intr_context(void)
 {
-    return in_external_intr;
+    return this_cpu()->in_external_intr;
 }
 
 /* During processing of an external interrupt, directs the
@@ -266,7 +355,7 @@ bool intr_context(void)
 void intr_yield_on_return(void)
 {
     ASSERT(intr_context());
-    yield_on_return = true;
+    this_cpu()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -331,26 +420,36 @@ void intr_handler(struct intr_frame *frame)
 {
     bool external;
     intr_handler_func *handler;
+    struct cpu *cpu;
+    uint64_t start = 0;
+
+    /* An interrupt gate turned interrupts off behind
+       intr_disable()'s back, so catch up on the big kernel lock. */
+    if ((frame->eflags & FLAG_IF) && intr_get_level() == INTR_OFF)
+        spinlock_acquire(&giant);
 
     /* External interrupts are special.
        We only handle one at a time (so interrupts must be off)
-       and they need to be acknowledged on the PIC (see below).
-       An external interrupt handler cannot sleep. */
-    external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+       and they need to be acknowledged on the PIC or local APIC
+       (see below).  An external interrupt handler cannot sleep. */
+    external = is_external(frame->vec_no);
     if (external)
     {
         ASSERT(intr_get_level() == INTR_OFF);
         ASSERT(!intr_context());
 
-        in_external_intr = true;
-        yield_on_return = false;
+        cpu = this_cpu();
+        cpu->in_external_intr = true;
+        cpu->yield_on_return = false;
+        if (intrstat_enabled) start = rdtsc();
     }
 
     /* Invoke the interrupt's handler. */
     handler = intr_handlers[frame->vec_no];
     if (handler != NULL)
         handler(frame);
-    else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
+    else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f ||
+             frame->vec_no == LAPIC_VEC_SPURIOUS)
     {
         /* There is no handler, but this interrupt can trigger
            spuriously due to a hardware fault or hardware race
@@ -370,11 +469,45 @@ void intr_handler(struct intr_frame *frame)
         ASSERT(intr_get_level() == INTR_OFF);
         ASSERT(intr_context());
 
-        in_external_intr = false;
-        pic_end_of_interrupt(frame->vec_no);
+        cpu->in_external_intr = false;
+        if (ioapic_mode || frame->vec_no >= 0x30)
+            lapic_eoi();
+        else
+            pic_end_of_interrupt(frame->vec_no);
+
+        if (intrstat_enabled)
+        {
+            uint64_t cycles = rdtsc() - start;
+
+            intr_cnt[frame->vec_no]++;
+            intr_cycles[frame->vec_no] += cycles;
+            if (cycles > intr_cycles_max[frame->vec_no])
+                intr_cycles_max[frame->vec_no] = cycles;
+        }
+
+        /* The thread may come back on another processor. */
+        if (cpu->yield_on_return) thread_yield();
+
+#ifdef USERPROG
+        /* A thread whose process is exiting must not go back to
+           user mode, or a thread that never makes a system call
+           would never exit. */
+        if (frame->cs == SEL_UCSEG && thread_current()->killed)
+        {
+            intr_enable();
+            sys_exit(-1);
+        }
+#endif
+    }
 
-        if (yield_on_return) thread_yield();
+    /* Return to the interrupted code holding the big kernel lock
+       exactly if it ran with interrupts off. */
+    if (frame->eflags & FLAG_IF)
+    {
+        if (intr_get_level() == INTR_OFF) spinlock_release(&giant);
     }
+    else if (intr_get_level() == INTR_ON)
+        intr_disable();
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
@@ -405,3 +538,23 @@ const char *intr_name(uint8_t vec)
 {
     return intr_names[vec];
 }
+
+/* Prints, with -o intrstat, how many times each external
+   interrupt was handled and the average and longest time its
+   handler kept interrupts off. */
+void intr_print_stats(void)
+{
+    int vec;
+
+    if (!intrstat_enabled) return;
+
+    printf("Interrupt handler time (TSC cycles):\n");
+    printf("  %-4s %-20s %10s %10s %10s\n", "vec", "name", "count",
+           "average", "max");
+    for (vec = 0; vec < INTR_CNT; vec++)
+        if (intr_cnt[vec] != 0)
+            printf("  %#04x %-20s %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+                   "\n",
+                   vec, intr_names[vec], intr_cnt[vec],
+                   intr_cycles[vec] / intr_cnt[vec], intr_cycles_max[vec]);
+}
@@ -0,0 +1,131 @@
+#include "threads/ioapic.h"
+
+#include <debug.h>
+
+#include "intrinsic.h"
+#include "threads/init.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
+
+/* I/O Advanced Programmable Interrupt Controller (I/O APIC).
+
+   The I/O APIC takes the interrupt lines of the devices and
+   sends each one to a local APIC as an interrupt message, with a
+   vector, destination, polarity and trigger mode set per line in
+   its redirection table.  Its lines are numbered as "global
+   system interrupts" (GSIs).  The ISA IRQs map to the GSIs of the
+   same number, active high and edge triggered, except where the
+   MADT lists an interrupt source override: on most machines,
+   including QEMU, IRQ 0 of the 8254 timer arrives on GSI 2.  See
+   [ACPI] 5.2.12.5 "Interrupt Source Override Structure" and the
+   82093AA I/O APIC datasheet.
+
+   We support the one I/O APIC that serves the ISA IRQs, which is
+   all that a PC normally has them on. */
+
+/* Register offsets, in bytes, of the indirect access window. */
+#define IOAPIC_REGSEL 0x00 /* Selects a register. */
+#define IOAPIC_WIN 0x10    /* Reads or writes it. */
+
+/* Registers. */
+#define IOAPIC_VER 0x01    /* Version and # of redirection entries. */
+#define IOAPIC_REDTBL 0x10 /* Redirection entry 0, bits 0:31. */
+
+/* Redirection entry bits 0:31. */
+#define REDIR_ACTIVE_LOW 0x2000 /* Polarity: active low. */
+#define REDIR_LEVEL 0x8000      /* Trigger mode: level. */
+#define REDIR_MASKED 0x10000    /* Interrupt masked. */
+
+/* MPS INTI flags of an interrupt source override. */
+#define INTI_POLARITY 0x3 /* 1: active high, 3: active low. */
+#define INTI_TRIGGER 0xc  /* 4: edge, 12: level. */
+
+/* Number of ISA IRQs. */
+#define ISA_IRQ_CNT 16
+
+/* Kernel virtual address of the registers, or a null pointer if
+   there is no I/O APIC. */
+static volatile uint32_t *ioapic;
+
+/* GSI of the first redirection entry, and number of entries. */
+static uint32_t gsi_first;
+static unsigned redir_cnt;
+
+/* Where each ISA IRQ arrives: GSI and redirection entry bits.
+   Changed by ioapic_override(). */
+static uint32_t irq_gsi[ISA_IRQ_CNT] = {0, 1, 2,  3,  4,  5,  6,  7,
+                                        8, 9, 10, 11, 12, 13, 14, 15};
+static uint32_t irq_flags[ISA_IRQ_CNT];
+
+static uint32_t ioapic_read(uint8_t reg);
+static void ioapic_write(uint8_t reg, uint32_t value);
+
+/* Maps the I/O APIC registers at physical address BASE, uncached,
+   as lapic_init() does for the local APIC, and masks all of its
+   lines.  GSI_BASE is the GSI of its first line. */
+void ioapic_init(uint64_t base, uint32_t gsi_base)
+{
+    uint64_t va = (uint64_t) ptov(base);
+    uint64_t *pte = pml4e_walk(base_pml4, va, 1);
+    unsigned i;
+
+    if (pte == NULL) PANIC("cannot map I/O APIC");
+    *pte = base | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+    invlpg(va);
+    ioapic = (volatile uint32_t *) va;
+
+    gsi_first = gsi_base;
+    redir_cnt = ((ioapic_read(IOAPIC_VER) >> 16) & 0xff) + 1;
+    for (i = 0; i < redir_cnt; i++)
+        ioapic_write(IOAPIC_REDTBL + 2 * i, REDIR_MASKED);
+}
+
+/* Returns true if ioapic_init() has been called and the ISA IRQs
+   can be routed through the I/O APIC. */
+bool ioapic_present(void)
+{
+    return ioapic != NULL && gsi_first == 0 && redir_cnt >= ISA_IRQ_CNT;
+}
+
+/* Records an interrupt source override: ISA IRQ arrives on GSI,
+   with the polarity and trigger mode given by MPS INTI FLAGS.
+   May be called before or after ioapic_init(). */
+void ioapic_override(uint8_t irq, uint32_t gsi, uint16_t flags)
+{
+    if (irq >= ISA_IRQ_CNT) return;
+
+    irq_gsi[irq] = gsi;
+    irq_flags[irq] = 0;
+    if ((flags & INTI_POLARITY) == 3) irq_flags[irq] |= REDIR_ACTIVE_LOW;
+    if ((flags & INTI_TRIGGER) == 12) irq_flags[irq] |= REDIR_LEVEL;
+}
+
+/* Delivers ISA IRQ as interrupt VEC to the local APIC whose ID is
+   APIC_ID, and unmasks it. */
+void ioapic_route(uint8_t irq, uint8_t vec, uint8_t apic_id)
+{
+    unsigned entry;
+
+    ASSERT(ioapic_present());
+    ASSERT(irq < ISA_IRQ_CNT);
+
+    entry = irq_gsi[irq] - gsi_first;
+    if (entry >= redir_cnt) PANIC("IRQ %d is on no I/O APIC line", irq);
+
+    ioapic_write(IOAPIC_REDTBL + 2 * entry + 1, (uint32_t) apic_id << 24);
+    ioapic_write(IOAPIC_REDTBL + 2 * entry, irq_flags[irq] | vec);
+}
+
+/* Reads I/O APIC register REG. */
+static uint32_t ioapic_read(uint8_t reg)
+{
+    ioapic[IOAPIC_REGSEL / sizeof *ioapic] = reg;
+    return ioapic[IOAPIC_WIN / sizeof *ioapic];
+}
+
+/* Writes VALUE to I/O APIC register REG. */
+static void ioapic_write(uint8_t reg, uint32_t value)
+{
+    ioapic[IOAPIC_REGSEL / sizeof *ioapic] = reg;
+    ioapic[IOAPIC_WIN / sizeof *ioapic] = value;
+}
@@ -0,0 +1,220 @@
+#include "threads/lapic.h"
+
+#include <debug.h>
+
+#include "devices/timer.h"
+#include "intrinsic.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Local Advanced Programmable Interrupt Controller (LAPIC).
+
+   Every processor has its own local APIC, which delivers it
+   interrupts, lets it send interrupts to other processors
+   (inter-processor interrupts, or IPIs), and contains a timer.
+   All local APICs appear at the same physical address, each
+   processor seeing only its own.  See [IA32-v3a] chapter 10
+   "Advanced Programmable Interrupt Controller (APIC)".
+
+   Device interrupts come through the I/O APIC if there is one
+   (see ioapic.c), and otherwise through the 8259A PICs, which the
+   BIOS wires to the BSP's LINT0 line.  Besides those, the local
+   APIC delivers IPIs, the timer of the APs, and the BSP's
+   high-resolution timers (see devices/hrtimer.c). */
+
+/* Register offsets, in bytes. */
+#define LAPIC_ID 0x020     /* Local APIC ID. */
+#define LAPIC_TPR 0x080    /* Task priority. */
+#define LAPIC_EOI 0x0b0    /* End of interrupt. */
+#define LAPIC_SVR 0x0f0    /* Spurious interrupt vector. */
+#define LAPIC_ICRLO 0x300  /* Interrupt command, bits 0:31. */
+#define LAPIC_ICRHI 0x310  /* Interrupt command, bits 32:63. */
+#define LAPIC_TIMER 0x320  /* LVT timer. */
+#define LAPIC_LINT0 0x350  /* LVT LINT0. */
+#define LAPIC_TICR 0x380   /* Timer initial count. */
+#define LAPIC_TCCR 0x390   /* Timer current count. */
+#define LAPIC_TDCR 0x3e0   /* Timer divide configuration. */
+
+#define SVR_ENABLE 0x100       /* APIC software enable. */
+#define ICR_FIXED 0x000        /* Fixed delivery mode. */
+#define ICR_INIT 0x500         /* INIT delivery mode. */
+#define ICR_STARTUP 0x600      /* Start-up delivery mode. */
+#define ICR_DELIVS 0x1000      /* Delivery status: send pending. */
+#define ICR_ASSERT 0x4000      /* Level assert. */
+#define ICR_LEVEL 0x8000       /* Level triggered. */
+#define TIMER_PERIODIC 0x20000 /* Periodic timer mode. */
+#define TIMER_MASKED 0x10000   /* Timer interrupt masked. */
+#define LVT_MASKED 0x10000     /* Any LVT entry masked. */
+#define TDCR_DIV16 0x3         /* Divide the bus clock by 16. */
+
+/* Timer ticks to average over in lapic_timer_calibrate(). */
+#define CALIBRATE_TICKS 4
+
+/* Kernel virtual address of the registers, or a null pointer if
+   lapic_init() has not been called. */
+static volatile uint32_t *lapic;
+
+/* Timer counts per timer tick, or 0 if not yet measured. */
+static uint32_t counts_per_tick;
+
+static uint32_t lapic_read(int reg);
+static void lapic_write(int reg, uint32_t value);
+static void lapic_icr(uint8_t apic_id, uint32_t low);
+
+/* Maps the local APIC registers at physical address BASE into
+   the kernel's address space, uncached.  The mapping lives in
+   base_pml4, whose kernel half every page table shares. */
+void lapic_init(uint64_t base)
+{
+    uint64_t va = (uint64_t) ptov(base);
+    uint64_t *pte = pml4e_walk(base_pml4, va, 1);
+
+    if (pte == NULL) PANIC("cannot map local APIC");
+    *pte = base | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+    invlpg(va);
+    lapic = (volatile uint32_t *) va;
+}
+
+/* Returns true if lapic_init() has been called. */
+bool lapic_present(void)
+{
+    return lapic != NULL;
+}
+
+/* Enables the running processor's local APIC, so that it accepts
+   IPIs.  Its timer stays masked until lapic_timer_start(). */
+void lapic_enable(void)
+{
+    ASSERT(lapic != NULL);
+
+    lapic_write(LAPIC_SVR, SVR_ENABLE | LAPIC_VEC_SPURIOUS);
+    lapic_write(LAPIC_TIMER, TIMER_MASKED);
+    lapic_write(LAPIC_TPR, 0);
+}
+
+/* Stops the running processor from taking interrupts from the
+   8259A PICs through its LINT0 line, once the I/O APIC has taken
+   over their job. */
+void lapic_mask_lint0(void)
+{
+    ASSERT(lapic != NULL);
+
+    lapic_write(LAPIC_LINT0, LVT_MASKED);
+}
+
+/* Returns the running processor's local APIC ID. */
+uint8_t lapic_id(void)
+{
+    ASSERT(lapic != NULL);
+
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+/* Acknowledges the interrupt being serviced. */
+void lapic_eoi(void)
+{
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* Sends interrupt VEC to the processor whose local APIC ID is
+   APIC_ID. */
+void lapic_send_ipi(uint8_t apic_id, uint8_t vec)
+{
+    lapic_icr(apic_id, ICR_FIXED | vec);
+}
+
+/* Sends an INIT IPI to APIC_ID, which resets that processor and
+   leaves it waiting for a start-up IPI.  See [IA32-v3a] 8.4.4
+   "MP Initialization Example". */
+void lapic_send_init(uint8_t apic_id)
+{
+    lapic_icr(apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+    lapic_icr(apic_id, ICR_INIT | ICR_LEVEL);
+}
+
+/* Sends a start-up IPI to APIC_ID, which starts that processor in
+   real mode at physical address PA. */
+void lapic_send_startup(uint8_t apic_id, uint64_t pa)
+{
+    ASSERT(pg_ofs(pa) == 0 && pa < 0x100000);
+
+    lapic_icr(apic_id, ICR_STARTUP | (pa >> 12));
+}
+
+/* Measures how many local APIC timer counts, at the divisor that
+   lapic_timer_start() uses, make up one timer tick.  Must be
+   called with interrupts on, after timer_init().  All local APIC
+   timers run off the same bus clock, so this only needs to be
+   done once, on the BSP; later calls return the same count
+   without touching the timer. */
+uint32_t lapic_timer_calibrate(void)
+{
+    int64_t start;
+
+    ASSERT(intr_get_level() == INTR_ON);
+
+    if (counts_per_tick != 0) return counts_per_tick;
+
+    lapic_write(LAPIC_TDCR, TDCR_DIV16);
+    lapic_write(LAPIC_TIMER, TIMER_MASKED);
+
+    /* Wait for a tick boundary, then count down for a few ticks. */
+    start = timer_ticks();
+    while (timer_ticks() == start) barrier();
+    lapic_write(LAPIC_TICR, UINT32_MAX);
+
+    start = timer_ticks();
+    while (timer_elapsed(start) < CALIBRATE_TICKS) barrier();
+
+    counts_per_tick = (UINT32_MAX - lapic_read(LAPIC_TCCR)) / CALIBRATE_TICKS;
+    lapic_write(LAPIC_TICR, 0);
+    return counts_per_tick;
+}
+
+/* Starts the running processor's local APIC timer, interrupting
+   at LAPIC_VEC_TIMER every COUNT counts. */
+void lapic_timer_start(uint32_t count)
+{
+    ASSERT(count > 0);
+
+    lapic_write(LAPIC_TDCR, TDCR_DIV16);
+    lapic_write(LAPIC_TIMER, TIMER_PERIODIC | LAPIC_VEC_TIMER);
+    lapic_write(LAPIC_TICR, count);
+}
+
+/* Arms the running processor's local APIC timer to raise VEC
+   once, after COUNT counts at the same divisor.  Replaces any
+   countdown in progress. */
+void lapic_timer_oneshot(uint8_t vec, uint32_t count)
+{
+    ASSERT(count > 0);
+
+    lapic_write(LAPIC_TDCR, TDCR_DIV16);
+    lapic_write(LAPIC_TIMER, vec);
+    lapic_write(LAPIC_TICR, count);
+}
+
+/* Reads local APIC register REG. */
+static uint32_t lapic_read(int reg)
+{
+    return lapic[reg / sizeof *lapic];
+}
+
+/* Writes VALUE to local APIC register REG. */
+static void lapic_write(int reg, uint32_t value)
+{
+    lapic[reg / sizeof *lapic] = value;
+}
+
+/* Issues the interrupt command LOW to APIC_ID and waits for the
+   local APIC to accept it. */
+static void lapic_icr(uint8_t apic_id, uint32_t low)
+{
+    lapic_write(LAPIC_ICRHI, (uint32_t) apic_id << 24);
+    lapic_write(LAPIC_ICRLO, low);
+    while (lapic_read(LAPIC_ICRLO) & ICR_DELIVS) asm volatile("pause");
+}
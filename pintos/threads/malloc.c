@@ -7,7 +7,9 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -34,7 +36,21 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   Kernel objects that are allocated and freed all the time can
+   instead come from an object cache (see kmem_cache_create()),
+   which is much like a descriptor except that its blocks, here
+   called objects, are exactly as big as the object, rounded up
+   to a multiple of 8 bytes, and its pages are called slabs.  A
+   cache with a constructor runs it on each object once, when the
+   slab is made, and keeps the free list link just past the
+   object so that freeing it does not undo the construction.  In
+   front of its free list, each cache keeps a small stack of
+   recently freed objects, a "magazine", for each CPU.  A CPU
+   pushes and pops its own magazine with interrupts off instead
+   of taking the cache's lock, and only goes to the free list
+   when its magazine is empty or full. */
 
 /* Descriptor. */
 struct desc
@@ -43,6 +59,7 @@ struct desc
     size_t blocks_per_arena; /* Number of blocks in an arena. */
     struct list free_list;   /* List of free blocks. */
     struct lock lock;        /* Lock. */
+    char name[16];           /* Name of `lock', for lock statistics. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -62,12 +79,51 @@ struct block
     struct list_elem free_elem; /* Free list element. */
 };
 
+/* Number of objects a CPU's magazine holds. */
+#define MAGAZINE_SIZE 16
+
+/* Recently freed objects of a cache, private to one CPU. */
+struct magazine
+{
+    size_t cnt;                 /* Number of objects in OBJS. */
+    void *objs[MAGAZINE_SIZE];  /* Objects, most recently freed last. */
+};
+
+/* Object cache. */
+struct kmem_cache
+{
+    size_t obj_size;                      /* Size of each object in bytes. */
+    size_t objs_per_slab;                 /* Number of objects in a slab. */
+    kmem_ctor_func *ctor;                 /* Constructor, or null. */
+    size_t link_ofs;                      /* Offset of free list link. */
+    size_t slab_cnt;                      /* Number of slabs. */
+    struct list free_list;                /* List of free objects. */
+    struct lock lock;                     /* Lock for FREE_LIST. */
+    char name[16];                        /* Name of `lock'. */
+    struct magazine mags[SMP_MAX_CPUS];   /* Per-CPU magazines. */
+};
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab.  Laid out like an arena. */
+struct slab
+{
+    unsigned magic;           /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache; /* Owning cache. */
+    size_t free_cnt;          /* Objects on the cache's free list. */
+};
+
 /* Our set of descriptors. */
 static struct desc descs[10]; /* Descriptors. */
 static size_t desc_cnt;       /* Number of descriptors. */
 
 static struct arena *block_to_arena(struct block *);
 static struct block *arena_to_block(struct arena *, size_t idx);
+static struct slab *obj_to_slab(struct kmem_cache *, void *obj);
+static void *slab_to_obj(struct slab *, size_t idx);
+static struct block *obj_to_link(struct kmem_cache *, void *obj);
+static void *link_to_obj(struct kmem_cache *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void malloc_init(void)
@@ -82,6 +138,8 @@ void malloc_init(void)
         d->blocks_per_arena = (PGSIZE - sizeof(struct arena)) / block_size;
         list_init(&d->free_list);
         lock_init(&d->lock);
+        snprintf(d->name, sizeof d->name, "malloc%zu", block_size);
+        lock_set_name(&d->lock, d->name);
     }
 }
 
@@ -254,6 +312,197 @@ void free(void *p)
     }
 }
 
+/* Creates and returns an object cache for objects of SIZE bytes,
+   which must fit in a page with a slab header.  NAME is used
+   for lock statistics.  If CTOR is nonnull, it is called on each
+   object once, when the slab that holds it is created, with the
+   cache's lock held.  Objects keep their contents from
+   kmem_cache_free() to the next kmem_cache_alloc(), so users
+   must put them back in their constructed state before freeing
+   them.  Returns a null pointer if memory is not available. */
+struct kmem_cache *kmem_cache_create(const char *name, size_t size,
+                                     kmem_ctor_func *ctor)
+{
+    struct kmem_cache *c;
+    size_t link_ofs;
+    int i;
+
+    /* Without a constructor, a free object holds its own link. */
+    size = ROUND_UP(size, 8);
+    link_ofs = ctor != NULL ? size : 0;
+    if (size < link_ofs + sizeof(struct block))
+        size = link_ofs + sizeof(struct block);
+    ASSERT(size <= PGSIZE - sizeof(struct slab));
+
+    c = malloc(sizeof *c);
+    if (c == NULL) return NULL;
+
+    c->obj_size = size;
+    c->objs_per_slab = (PGSIZE - sizeof(struct slab)) / size;
+    c->ctor = ctor;
+    c->link_ofs = link_ofs;
+    c->slab_cnt = 0;
+    list_init(&c->free_list);
+    lock_init(&c->lock);
+    snprintf(c->name, sizeof c->name, "%s", name);
+    lock_set_name(&c->lock, c->name);
+    for (i = 0; i < SMP_MAX_CPUS; i++) c->mags[i].cnt = 0;
+    return c;
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *kmem_cache_alloc(struct kmem_cache *c)
+{
+    enum intr_level old_level;
+    struct magazine *mag;
+    struct block *b;
+    struct slab *s;
+    void *obj = NULL;
+
+    /* Try the running CPU's magazine. */
+    old_level = intr_disable();
+    mag = &c->mags[this_cpu()->id];
+    if (mag->cnt > 0) obj = mag->objs[--mag->cnt];
+    intr_set_level(old_level);
+    if (obj != NULL) return obj;
+
+    lock_acquire(&c->lock);
+
+    /* If the free list is empty, create a new slab. */
+    if (list_empty(&c->free_list))
+    {
+        size_t i;
+
+        s = palloc_get_page(0);
+        if (s == NULL)
+        {
+            lock_release(&c->lock);
+            return NULL;
+        }
+
+        s->magic = SLAB_MAGIC;
+        s->cache = c;
+        s->free_cnt = c->objs_per_slab;
+        for (i = 0; i < c->objs_per_slab; i++)
+        {
+            void *obj = slab_to_obj(s, i);
+
+            if (c->ctor != NULL) c->ctor(obj);
+            list_push_back(&c->free_list, &obj_to_link(c, obj)->free_elem);
+        }
+        c->slab_cnt++;
+    }
+
+    /* Get an object from the free list. */
+    b = list_entry(list_pop_front(&c->free_list), struct block, free_elem);
+    obj = link_to_obj(c, b);
+    s = obj_to_slab(c, obj);
+    s->free_cnt--;
+    lock_release(&c->lock);
+
+    return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C, to C.
+   A null OBJ is ignored. */
+void kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+    enum intr_level old_level;
+    struct magazine *mag;
+    struct block *b;
+    struct slab *s;
+
+    if (obj == NULL) return;
+    s = obj_to_slab(c, obj);
+    b = obj_to_link(c, obj);
+
+#ifndef NDEBUG
+    /* Clear the object to help detect use-after-free bugs, unless
+       it must keep what its constructor set up. */
+    if (c->ctor == NULL) memset(obj, 0xcc, c->obj_size);
+#endif
+
+    /* Try the running CPU's magazine. */
+    old_level = intr_disable();
+    mag = &c->mags[this_cpu()->id];
+    if (mag->cnt < MAGAZINE_SIZE)
+    {
+        mag->objs[mag->cnt++] = obj;
+        obj = NULL;
+    }
+    intr_set_level(old_level);
+    if (obj == NULL) return;
+
+    lock_acquire(&c->lock);
+
+    /* Add object to free list. */
+    list_push_front(&c->free_list, &b->free_elem);
+
+    /* If the slab is now entirely unused, free it. */
+    if (++s->free_cnt >= c->objs_per_slab)
+    {
+        size_t i;
+
+        ASSERT(s->free_cnt == c->objs_per_slab);
+        for (i = 0; i < c->objs_per_slab; i++)
+            list_remove(&obj_to_link(c, slab_to_obj(s, i))->free_elem);
+        palloc_free_page(s);
+        c->slab_cnt--;
+    }
+
+    lock_release(&c->lock);
+}
+
+/* Returns the number of slabs that cache C has, which are all the
+   pages it holds. */
+size_t kmem_cache_slab_cnt(struct kmem_cache *c)
+{
+    size_t slab_cnt;
+
+    lock_acquire(&c->lock);
+    slab_cnt = c->slab_cnt;
+    lock_release(&c->lock);
+    return slab_cnt;
+}
+
+/* Returns the slab of cache C that OBJ is inside. */
+static struct slab *obj_to_slab(struct kmem_cache *c, void *obj)
+{
+    struct slab *s = pg_round_down(obj);
+
+    /* Check that the slab is valid and belongs to C. */
+    ASSERT(s != NULL);
+    ASSERT(s->magic == SLAB_MAGIC);
+    ASSERT(s->cache == c);
+
+    /* Check that the object is properly aligned for the slab. */
+    ASSERT((pg_ofs(obj) - sizeof *s) % c->obj_size == 0);
+
+    return s;
+}
+
+/* Returns the IDX'th object within slab S. */
+static void *slab_to_obj(struct slab *s, size_t idx)
+{
+    ASSERT(s != NULL);
+    ASSERT(s->magic == SLAB_MAGIC);
+    ASSERT(idx < s->cache->objs_per_slab);
+    return (uint8_t *) s + sizeof *s + idx * s->cache->obj_size;
+}
+
+/* Returns the free list link of OBJ in cache C. */
+static struct block *obj_to_link(struct kmem_cache *c, void *obj)
+{
+    return (struct block *) ((uint8_t *) obj + c->link_ofs);
+}
+
+/* Returns the object of cache C whose free list link is B. */
+static void *link_to_obj(struct kmem_cache *c, struct block *b)
+{
+    return (uint8_t *) b - c->link_ofs;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *block_to_arena(struct block *b)
 {
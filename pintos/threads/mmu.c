@@ -10,62 +10,94 @@
 #include "threads/pte.h"
 #include "threads/thread.h"
 
-static uint64_t *pgdir_walk(uint64_t *pdp, const uint64_t va, int create)
+/* Page table levels, from the PML4 down.  An entry at level L
+   covers 1 << level_shift[L] bytes of virtual address space, and
+   maps that much memory itself if it is a PTE, or a PDE or PDPE
+   with PTE_PS set. */
+enum
 {
-    int idx = PDX(va);
-    if (pdp)
-    {
-        uint64_t *pte = (uint64_t *) pdp[idx];
-        if (!((uint64_t) pte & PTE_P))
-        {
-            if (create)
-            {
-                uint64_t *new_page = palloc_get_page(PAL_ZERO);
-                if (new_page)
-                    pdp[idx] = vtop(new_page) | PTE_U | PTE_W | PTE_P;
-                else
-                    return NULL;
-            }
-            else
-                return NULL;
-        }
-        return (uint64_t *) ptov(PTE_ADDR(pdp[idx]) + 8 * PTX(va));
-    }
-    return NULL;
+    PML4_LEVEL,
+    PDPE_LEVEL,
+    PDE_LEVEL,
+    PTE_LEVEL
+};
+static const unsigned level_shift[] = {PML4SHIFT, PDPESHIFT, PDXSHIFT,
+                                       PTXSHIFT};
+
+/* Replaces the large page mapped by entry E, at LEVEL, with a
+ * table of entries one level down that map the same memory with
+ * the same permissions.  Returns false if out of memory. */
+static bool split_large(uint64_t *e, int level)
+{
+    uint64_t *table = palloc_get_page(0);
+    uint64_t child_size = 1UL << level_shift[level + 1];
+    uint64_t flags = *e & PTE_FLAGS;
+
+    if (table == NULL) return false;
+
+    /* Bit 7 of a PTE is not PTE_PS but PAT. */
+    if (level + 1 == PTE_LEVEL) flags &= ~PTE_PS;
+    for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+        table[i] = (PTE_ADDR(*e) + i * child_size) | flags;
+    *e = vtop(table) | PTE_U | PTE_W | PTE_P;
+
+    /* Flush any TLB entry for the large page. */
+    lcr3(rcr3());
+    return true;
 }
 
-static uint64_t *pdpe_walk(uint64_t *pdpe, const uint64_t va, int create)
+/* Returns the address of the entry at LEVEL for virtual address
+ * VA in PML4, and stores LEVEL into *LEVELP if LEVELP is nonnull.
+ * If a table on the way to it is missing, or a large page is in
+ * its place, behavior depends on CREATE.  If CREATE is true, then
+ * the table is created, or the large page is split, and the walk
+ * goes on.  Otherwise a missing table makes it return a null
+ * pointer, and a large page makes it return the address of the
+ * PDE or PDPE that maps it, storing that entry's level into
+ * *LEVELP. */
+static uint64_t *entry_walk(uint64_t *pml4, uint64_t va, int level,
+                            int create, int *levelp)
 {
-    uint64_t *pte = NULL;
-    int idx = PDPE(va);
-    int allocated = 0;
-    if (pdpe)
+    uint64_t *table = pml4, *allocated[PTE_LEVEL];
+    int alloc_cnt = 0;
+
+    if (pml4 == NULL) return NULL;
+    for (int l = PML4_LEVEL;; l++)
     {
-        uint64_t *pde = (uint64_t *) pdpe[idx];
-        if (!((uint64_t) pde & PTE_P))
+        uint64_t *e = &table[(va >> level_shift[l]) & 0x1FF];
+
+        if (l == level || (!create && l != PML4_LEVEL && (*e & PTE_P) &&
+                           (*e & PTE_PS)))
+        {
+            if (levelp != NULL) *levelp = l;
+            return e;
+        }
+
+        if (!(*e & PTE_P))
+        {
+            uint64_t *new_page;
+
+            if (!create) return NULL;
+            new_page = palloc_get_page(PAL_ZERO);
+            if (new_page == NULL) break;
+            *e = vtop(new_page) | PTE_U | PTE_W | PTE_P;
+            allocated[alloc_cnt++] = e;
+        }
+        else if (l != PML4_LEVEL && (*e & PTE_PS))
         {
-            if (create)
-            {
-                uint64_t *new_page = palloc_get_page(PAL_ZERO);
-                if (new_page)
-                {
-                    pdpe[idx] = vtop(new_page) | PTE_U | PTE_W | PTE_P;
-                    allocated = 1;
-                }
-                else
-                    return NULL;
-            }
-            else
-                return NULL;
+            if (!split_large(e, l)) break;
         }
-        pte = pgdir_walk(ptov(PTE_ADDR(pdpe[idx])), va, create);
+        table = ptov(PTE_ADDR(*e));
     }
-    if (pte == NULL && allocated)
+
+    /* Out of memory: free the tables we added. */
+    while (alloc_cnt > 0)
     {
-        palloc_free_page((void *) ptov(PTE_ADDR(pdpe[idx])));
-        pdpe[idx] = 0;
+        uint64_t *e = allocated[--alloc_cnt];
+        palloc_free_page(ptov(PTE_ADDR(*e)));
+        *e = 0;
     }
-    return pte;
+    return NULL;
 }
 
 /* Returns the address of the page table entry for virtual
@@ -73,39 +105,40 @@ static uint64_t *pdpe_walk(uint64_t *pdpe, const uint64_t va, int create)
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.  If VADDR lies in a large page, CREATE
+ * splits the page down to page tables, and otherwise the PDE or
+ * PDPE that maps the large page is returned. */
 uint64_t *pml4e_walk(uint64_t *pml4e, const uint64_t va, int create)
 {
-    uint64_t *pte = NULL;
-    int idx = PML4(va);
-    int allocated = 0;
-    if (pml4e)
-    {
-        uint64_t *pdpe = (uint64_t *) pml4e[idx];
-        if (!((uint64_t) pdpe & PTE_P))
-        {
-            if (create)
-            {
-                uint64_t *new_page = palloc_get_page(PAL_ZERO);
-                if (new_page)
-                {
-                    pml4e[idx] = vtop(new_page) | PTE_U | PTE_W | PTE_P;
-                    allocated = 1;
-                }
-                else
-                    return NULL;
-            }
-            else
-                return NULL;
-        }
-        pte = pdpe_walk(ptov(PTE_ADDR(pml4e[idx])), va, create);
-    }
-    if (pte == NULL && allocated)
-    {
-        palloc_free_page((void *) ptov(PTE_ADDR(pml4e[idx])));
-        pml4e[idx] = 0;
-    }
-    return pte;
+    return entry_walk(pml4e, va, PTE_LEVEL, create, NULL);
+}
+
+/* Maps the SIZE bytes of physical memory at PA at kernel virtual
+ * address VA in PML4 with a single entry: a PTE if SIZE is
+ * PGSIZE, a large-page PDE if it is PDE_PGSIZE, or a large-page
+ * PDPE if it is PDPE_PGSIZE, which needs CPU support.  VA and PA
+ * must be aligned to SIZE and VA must not be mapped yet.  The
+ * mapping is read-only unless WRITABLE.  Returns true if
+ * successful, false if memory allocation failed. */
+bool pml4_set_kernel_page(uint64_t *pml4, uint64_t va, uint64_t pa,
+                          uint64_t size, bool writable)
+{
+    int level;
+    uint64_t *e;
+
+    ASSERT(is_kernel_vaddr(va));
+    ASSERT(size == PGSIZE || size == PDE_PGSIZE || size == PDPE_PGSIZE);
+    ASSERT(va % size == 0 && pa % size == 0);
+
+    level = size == PGSIZE ? PTE_LEVEL
+            : size == PDE_PGSIZE ? PDE_LEVEL
+                                 : PDPE_LEVEL;
+    e = entry_walk(pml4, va, level, 1, NULL);
+    if (e == NULL) return false;
+
+    ASSERT(!(*e & PTE_P));
+    *e = pa | PTE_P | (writable ? PTE_W : 0) | (size != PGSIZE ? PTE_PS : 0);
+    return true;
 }
 
 /* Creates a new page map level 4 (pml4) has mappings for kernel
@@ -144,10 +177,19 @@ static bool pgdir_for_each(uint64_t *pdp, pte_for_each_func *func, void *aux,
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
     {
         uint64_t *pte = ptov((uint64_t *) pdp[i]);
-        if (((uint64_t) pte) & PTE_P)
-            if (!pt_for_each((uint64_t *) PTE_ADDR(pte), func, aux, pml4_index,
-                             pdp_index, i))
-                return false;
+        if (!(((uint64_t) pte) & PTE_P)) continue;
+
+        /* A large page is passed to FUNC as a whole. */
+        if (pdp[i] & PTE_PS)
+        {
+            void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+                                 ((uint64_t) pdp_index << PDPESHIFT) |
+                                 ((uint64_t) i << PDXSHIFT));
+            if (!func(&pdp[i], va, aux)) return false;
+        }
+        else if (!pt_for_each((uint64_t *) PTE_ADDR(pte), func, aux,
+                              pml4_index, pdp_index, i))
+            return false;
     }
     return true;
 }
@@ -158,15 +200,25 @@ static bool pdp_for_each(uint64_t *pdp, pte_for_each_func *func, void *aux,
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
     {
         uint64_t *pde = ptov((uint64_t *) pdp[i]);
-        if (((uint64_t) pde) & PTE_P)
-            if (!pgdir_for_each((uint64_t *) PTE_ADDR(pde), func, aux,
-                                pml4_index, i))
-                return false;
+        if (!(((uint64_t) pde) & PTE_P)) continue;
+
+        /* A large page is passed to FUNC as a whole. */
+        if (pdp[i] & PTE_PS)
+        {
+            void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+                                 ((uint64_t) i << PDPESHIFT));
+            if (!func(&pdp[i], va, aux)) return false;
+        }
+        else if (!pgdir_for_each((uint64_t *) PTE_ADDR(pde), func, aux,
+                                 pml4_index, i))
+            return false;
     }
     return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+ * A PDE or PDPE that maps a large page is passed to FUNC once, as
+ * if it were a PTE, with the virtual address of the large page. */
 bool pml4_for_each(uint64_t *pml4, pte_for_each_func *func, void *aux)
 {
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
@@ -194,7 +246,11 @@ static void pgdir_destroy(uint64_t *pdp)
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
     {
         uint64_t *pte = ptov((uint64_t *) pdp[i]);
-        if (((uint64_t) pte) & PTE_P) pt_destroy(PTE_ADDR(pte));
+        if (!(((uint64_t) pte) & PTE_P)) continue;
+        if (pdp[i] & PTE_PS)
+            palloc_free_multiple(ptov(PTE_ADDR(pdp[i])), PDE_PGSIZE / PGSIZE);
+        else
+            pt_destroy(PTE_ADDR(pte));
     }
     palloc_free_page((void *) pdp);
 }
@@ -204,7 +260,12 @@ static void pdpe_destroy(uint64_t *pdpe)
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
     {
         uint64_t *pde = ptov((uint64_t *) pdpe[i]);
-        if (((uint64_t) pde) & PTE_P) pgdir_destroy((void *) PTE_ADDR(pde));
+        if (!(((uint64_t) pde) & PTE_P)) continue;
+        if (pdpe[i] & PTE_PS)
+            palloc_free_multiple(ptov(PTE_ADDR(pdpe[i])),
+                                 PDPE_PGSIZE / PGSIZE);
+        else
+            pgdir_destroy((void *) PTE_ADDR(pde));
     }
     palloc_free_page((void *) pdpe);
 }
@@ -236,9 +297,15 @@ void *pml4_get_page(uint64_t *pml4, const void *uaddr)
 {
     ASSERT(is_user_vaddr(uaddr));
 
-    uint64_t *pte = pml4e_walk(pml4, (uint64_t) uaddr, 0);
+    int level;
+    uint64_t *pte = entry_walk(pml4, (uint64_t) uaddr, PTE_LEVEL, 0, &level);
 
-    if (pte && (*pte & PTE_P)) return ptov(PTE_ADDR(*pte)) + pg_ofs(uaddr);
+    if (pte && (*pte & PTE_P))
+    {
+        /* The entry may map a large page. */
+        uint64_t mask = (1UL << level_shift[level]) - 1;
+        return ptov((PTE_ADDR(*pte) & ~mask) | ((uint64_t) uaddr & mask));
+    }
     return NULL;
 }
 
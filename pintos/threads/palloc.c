@@ -3,6 +3,7 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -10,8 +11,9 @@
 #include <string.h>
 
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -26,14 +28,66 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Its free pages form
+   blocks of 2**ORDER pages, aligned to their size relative to the
+   pool base, kept on one free list per order.  An allocation
+   takes the smallest block big enough, splitting larger ones as
+   needed, and gives back the pages it does not use; freeing pages
+   merges each block with its buddy for as long as the buddy is
+   free too.  Both take time proportional to the number of orders,
+   not to the size of the pool.
+
+   The free lists link through an array of `struct buddy_page',
+   one per page, kept next to the used_map rather than in the
+   free pages themselves: palloc_init() runs before paging_init()
+   has mapped all of memory.  For the same reason, until
+   paging_init() calls palloc_paging_ready(), allocations only
+   take blocks that lie in the first LOADER_BOOT_MAP_SIZE bytes.
+
+   A pool is guarded by turning interrupts off rather than by a
+   lock, because the scheduler frees dead threads' pages with
+   interrupts already off.  Neither operation holds them off for
+   long.
+
+   So that PAL_ZERO allocations of single pages do not have to
+   clear the page themselves, each pool also keeps a stack of up
+   to ZERO_POOL_SIZE free pages that are already zeroed.  A
+   low-priority kernel thread takes pages from the free lists,
+   zeroes them and pushes them whenever a PAL_ZERO allocation
+   leaves fewer than ZERO_POOL_LOW.  The buddy allocator counts
+   these pages as used, so an allocation that finds the free
+   lists short gives them back before failing. */
+
+/* Number of block orders.  The largest block is 2**(BUDDY_ORDERS
+   - 1) pages. */
+#define BUDDY_ORDERS 20
+
+/* Number of zeroed pages each pool keeps, and the number below
+   which the zeroing thread refills them. */
+#define ZERO_POOL_SIZE 32
+#define ZERO_POOL_LOW (ZERO_POOL_SIZE / 2)
+
+/* Buddy allocator state of one page. */
+struct buddy_page
+{
+    struct list_elem elem; /* Element in a free list. */
+    int8_t order;          /* ORDER + 1 if first page of a free
+                              block of 2**ORDER pages, else 0. */
+};
 
 /* A memory pool. */
 struct pool
 {
-    struct lock lock;        /* Mutual exclusion. */
-    struct bitmap *used_map; /* Bitmap of free pages. */
-    uint8_t *base;           /* Base of pool. */
+    struct bitmap *used_map;              /* Bitmap of used pages. */
+    struct buddy_page *pages;             /* Per-page buddy state. */
+    struct list free_lists[BUDDY_ORDERS]; /* Free blocks, by order. */
+    uint8_t *base;                        /* Base of pool. */
+    void *zeroed[ZERO_POOL_SIZE];         /* Zeroed pages. */
+    size_t zeroed_cnt;                    /* Number of zeroed pages. */
+    long long zero_hits;   /* # of PAL_ZERO pages taken zeroed. */
+    long long zero_misses; /* # of PAL_ZERO pages zeroed on demand. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -41,10 +95,27 @@ static struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
-static void init_pool(struct pool *p, void **bm_base, uint64_t start,
-                      uint64_t end);
+static void init_pool(struct pool *p, const char *name, void **bm_base,
+                      uint64_t start, uint64_t end);
 
 static bool page_from_pool(const struct pool *, void *page);
+static size_t buddy_alloc(struct pool *, size_t page_cnt);
+static void buddy_free(struct pool *, size_t page_idx, size_t page_cnt);
+static void buddy_free_block(struct pool *, size_t page_idx, int order);
+static struct buddy_page *boot_block(struct pool *, int order, int want);
+static void zeroed_refill(struct pool *);
+static void zeroed_drain(struct pool *);
+static void zeroer_wake(void);
+static thread_func zeroer_thread;
+
+/* Allocations must end below this kernel virtual address, or 0
+   once all of memory is mapped. */
+static uint64_t boot_map_end = (uint64_t) ptov(LOADER_BOOT_MAP_SIZE);
+
+/* Thread that refills the zeroed pages, once started. */
+static struct thread *zeroer;
+static bool zeroer_waiting; /* Zeroer blocked for lack of work? */
+static bool zeroer_kicked;  /* Zeroer asked to refill? */
 
 /* multiboot info */
 struct multiboot_info
@@ -178,8 +249,8 @@ static void populate_pools(struct area *base_mem, struct area *ext_mem)
                         break;
                     }
                     // generate kernel pool
-                    init_pool(&kernel_pool, &free_start, region_start,
-                              start + rem * PGSIZE);
+                    init_pool(&kernel_pool, "kernel_pool", &free_start,
+                              region_start, start + rem * PGSIZE);
                     // Transition to the next state
                     if (rem == size_in_pg)
                     {
@@ -212,7 +283,7 @@ static void populate_pools(struct area *base_mem, struct area *ext_mem)
     }
 
     // generate the user pool
-    init_pool(&user_pool, &free_start, region_start, end);
+    init_pool(&user_pool, "user_pool", &free_start, region_start, end);
 
     // Iterate over the e820_entry. Setup the usable.
     uint64_t usable_bound = (uint64_t) free_start;
@@ -249,14 +320,14 @@ static void populate_pools(struct area *base_mem, struct area *ext_mem)
             if ((uint64_t) pool_end < end)
             {
                 page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-                bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+                buddy_free(pool, page_idx, page_cnt);
                 start = (uint64_t) pool_end;
                 goto split;
             }
             else
             {
                 page_cnt = ((uint64_t) end - start) / PGSIZE;
-                bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+                buddy_free(pool, page_idx, page_cnt);
             }
         }
     }
@@ -290,12 +361,35 @@ uint64_t palloc_init(void)
 void *palloc_get_multiple(enum palloc_flags flags, size_t page_cnt)
 {
     struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-    lock_acquire(&pool->lock);
-    size_t page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
-    lock_release(&pool->lock);
+    size_t page_idx = BITMAP_ERROR;
+    bool zeroed = false;
     void *pages;
 
+    enum intr_level old_level = intr_disable();
+    if ((flags & PAL_ZERO) && page_cnt == 1)
+    {
+        if (pool->zeroed_cnt > 0)
+        {
+            page_idx = pg_no(pool->zeroed[--pool->zeroed_cnt]) -
+                       pg_no(pool->base);
+            zeroed = true;
+            pool->zero_hits++;
+        }
+        else
+            pool->zero_misses++;
+        if (pool->zeroed_cnt < ZERO_POOL_LOW) zeroer_wake();
+    }
+    if (page_idx == BITMAP_ERROR)
+    {
+        page_idx = buddy_alloc(pool, page_cnt);
+        if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0)
+        {
+            zeroed_drain(pool);
+            page_idx = buddy_alloc(pool, page_cnt);
+        }
+    }
+    intr_set_level(old_level);
+
     if (page_idx != BITMAP_ERROR)
         pages = pool->base + PGSIZE * page_idx;
     else
@@ -303,7 +397,8 @@ void *palloc_get_multiple(enum palloc_flags flags, size_t page_cnt)
 
     if (pages)
     {
-        if (flags & PAL_ZERO) memset(pages, 0, PGSIZE * page_cnt);
+        if ((flags & PAL_ZERO) && !zeroed)
+            memset(pages, 0, PGSIZE * page_cnt);
     }
     else
     {
@@ -330,6 +425,7 @@ void palloc_free_multiple(void *pages, size_t page_cnt)
 {
     struct pool *pool;
     size_t page_idx;
+    enum intr_level old_level;
 
     ASSERT(pg_ofs(pages) == 0);
     if (pages == NULL || page_cnt == 0) return;
@@ -346,8 +442,10 @@ void palloc_free_multiple(void *pages, size_t page_cnt)
 #ifndef NDEBUG
     memset(pages, 0xcc, PGSIZE * page_cnt);
 #endif
+    old_level = intr_disable();
     ASSERT(bitmap_all(pool->used_map, page_idx, page_cnt));
-    bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+    buddy_free(pool, page_idx, page_cnt);
+    intr_set_level(old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -356,24 +454,247 @@ void palloc_free_page(void *page)
     palloc_free_multiple(page, 1);
 }
 
-/* Initializes pool P as starting at START and ending at END */
-static void init_pool(struct pool *p, void **bm_base, uint64_t start,
-                      uint64_t end)
+/* Lets the page allocator hand out pages anywhere in memory.
+   Called by paging_init() once it has mapped all of memory. */
+void palloc_paging_ready(void)
+{
+    boot_map_end = 0;
+}
+
+/* Starts the thread that keeps zeroed pages ready for PAL_ZERO
+   allocations.  Must be called after thread_start(). */
+void palloc_zero_init(void)
+{
+    zeroer_kicked = true;
+    thread_create("pagezero", PRI_MIN, zeroer_thread, NULL);
+}
+
+/* Prints page allocator statistics. */
+void palloc_print_stats(void)
+{
+    printf("Palloc: kernel pool %lld zeroed hits, %lld misses; "
+           "user pool %lld zeroed hits, %lld misses\n",
+           kernel_pool.zero_hits, kernel_pool.zero_misses,
+           user_pool.zero_hits, user_pool.zero_misses);
+}
+
+/* Refills POOL's zeroed pages from its free lists, as far as they
+   go. */
+static void zeroed_refill(struct pool *pool)
+{
+    for (;;)
+    {
+        enum intr_level old_level = intr_disable();
+        size_t page_idx = BITMAP_ERROR;
+        void *page;
+
+        if (pool->zeroed_cnt < ZERO_POOL_SIZE)
+            page_idx = buddy_alloc(pool, 1);
+        intr_set_level(old_level);
+        if (page_idx == BITMAP_ERROR) return;
+
+        page = pool->base + PGSIZE * page_idx;
+        memset(page, 0, PGSIZE);
+
+        old_level = intr_disable();
+        if (pool->zeroed_cnt < ZERO_POOL_SIZE)
+            pool->zeroed[pool->zeroed_cnt++] = page;
+        else
+            buddy_free(pool, page_idx, 1);
+        intr_set_level(old_level);
+    }
+}
+
+/* Gives POOL's zeroed pages back to its free lists.  Interrupts
+   must be off. */
+static void zeroed_drain(struct pool *pool)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    while (pool->zeroed_cnt > 0)
+    {
+        void *page = pool->zeroed[--pool->zeroed_cnt];
+        buddy_free(pool, pg_no(page) - pg_no(pool->base), 1);
+    }
+}
+
+/* Asks the zeroing thread to refill the zeroed pages.
+   Interrupts must be off. */
+static void zeroer_wake(void)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    zeroer_kicked = true;
+    if (zeroer_waiting)
+    {
+        zeroer_waiting = false;
+        thread_unblock(zeroer);
+    }
+}
+
+/* Zeroing thread.  Refills both pools' zeroed pages each time it
+   is asked to, and blocks in between. */
+static void zeroer_thread(void *aux UNUSED)
+{
+    zeroer = thread_current();
+    thread_set_nice(20);
+    for (;;)
+    {
+        enum intr_level old_level = intr_disable();
+
+        while (!zeroer_kicked)
+        {
+            zeroer_waiting = true;
+            thread_block();
+        }
+        zeroer_kicked = false;
+        intr_set_level(old_level);
+
+        zeroed_refill(&kernel_pool);
+        zeroed_refill(&user_pool);
+    }
+}
+
+/* Initializes pool P, named NAME, as starting at START and ending
+   at END */
+static void init_pool(struct pool *p, const char *name UNUSED,
+                      void **bm_base, uint64_t start, uint64_t end)
 {
-    /* We'll put the pool's used_map at its base.
-       Calculate the space needed for the bitmap
-       and subtract it from the pool's size. */
+    /* We'll put the pool's used_map and per-page buddy state at
+       *BM_BASE.  Calculate the space needed for them and advance
+       *BM_BASE past it. */
     uint64_t pgcnt = (end - start) / PGSIZE;
     size_t bm_pages = DIV_ROUND_UP(bitmap_buf_size(pgcnt), PGSIZE) * PGSIZE;
+    size_t meta_pages =
+        DIV_ROUND_UP(pgcnt * sizeof(struct buddy_page), PGSIZE) * PGSIZE;
+    int order;
 
-    lock_init(&p->lock);
     p->used_map = bitmap_create_in_buf(pgcnt, *bm_base, bm_pages);
+    p->pages = (struct buddy_page *) ((uint8_t *) *bm_base + bm_pages);
+    for (order = 0; order < BUDDY_ORDERS; order++)
+        list_init(&p->free_lists[order]);
     p->base = (void *) start;
 
     // Mark all to unusable.
     bitmap_set_all(p->used_map, true);
+    memset(p->pages, 0, meta_pages);
+
+    *bm_base += bm_pages + meta_pages;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL, with interrupts
+   off, and returns the index of the first, or BITMAP_ERROR if
+   no free block is big enough. */
+static size_t buddy_alloc(struct pool *pool, size_t page_cnt)
+{
+    struct buddy_page *bp;
+    size_t page_idx;
+    int order, want;
+
+    if (page_cnt == 0) return BITMAP_ERROR;
+
+    /* Smallest order that holds PAGE_CNT pages. */
+    for (want = 0; want < BUDDY_ORDERS; want++)
+        if (((size_t) 1 << want) >= page_cnt) break;
+
+    /* Smallest free block of at least that order. */
+    bp = NULL;
+    for (order = want; order < BUDDY_ORDERS && bp == NULL; order++)
+        if (!list_empty(&pool->free_lists[order]))
+            bp = boot_map_end == 0
+                     ? list_entry(list_front(&pool->free_lists[order]),
+                                  struct buddy_page, elem)
+                     : boot_block(pool, order, want);
+    if (bp == NULL) return BITMAP_ERROR;
+    order--;
+
+    list_remove(&bp->elem);
+    bp->order = 0;
+    page_idx = bp - pool->pages;
+
+    /* Split it down to the order wanted, freeing the upper halves. */
+    while (order > want)
+    {
+        order--;
+        bp = &pool->pages[page_idx + ((size_t) 1 << order)];
+        bp->order = order + 1;
+        list_push_front(&pool->free_lists[order], &bp->elem);
+    }
+
+    bitmap_set_multiple(pool->used_map, page_idx, page_cnt, true);
+
+    /* Give back the pages past PAGE_CNT. */
+    buddy_free(pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+    return page_idx;
+}
+
+/* Returns a free block of POOL of 2**ORDER pages whose first
+   2**WANT pages lie below boot_map_end, or a null pointer if
+   there is none.  Only used while booting, when free lists are
+   short. */
+static struct buddy_page *boot_block(struct pool *pool, int order, int want)
+{
+    struct list_elem *e;
+
+    for (e = list_begin(&pool->free_lists[order]);
+         e != list_end(&pool->free_lists[order]); e = list_next(e))
+    {
+        struct buddy_page *bp = list_entry(e, struct buddy_page, elem);
+        uint64_t end = (uint64_t) pool->base +
+                       ((bp - pool->pages) + ((size_t) 1 << want)) * PGSIZE;
+
+        if (end <= boot_map_end) return bp;
+    }
+    return NULL;
+}
+
+/* Returns the PAGE_CNT pages starting at index PAGE_IDX to POOL,
+   with interrupts off, as the fewest aligned blocks that cover
+   them. */
+static void buddy_free(struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+    bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+    while (page_cnt > 0)
+    {
+        int order = 0;
+
+        while (order + 1 < BUDDY_ORDERS &&
+               page_idx % ((size_t) 1 << (order + 1)) == 0 &&
+               ((size_t) 1 << (order + 1)) <= page_cnt)
+            order++;
+
+        buddy_free_block(pool, page_idx, order);
+        page_idx += (size_t) 1 << order;
+        page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Puts the block of 2**ORDER pages starting at index PAGE_IDX on
+   POOL's free lists, merging it with its buddy for as long as the
+   buddy is a free block of the same order. */
+static void buddy_free_block(struct pool *pool, size_t page_idx, int order)
+{
+    size_t pgcnt = bitmap_size(pool->used_map);
+    struct buddy_page *bp;
+
+    while (order + 1 < BUDDY_ORDERS)
+    {
+        size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+        struct buddy_page *buddy = &pool->pages[buddy_idx];
+
+        if (buddy_idx + ((size_t) 1 << order) > pgcnt ||
+            buddy->order != order + 1)
+            break;
+
+        list_remove(&buddy->elem);
+        buddy->order = 0;
+        page_idx &= ~((size_t) 1 << order);
+        order++;
+    }
 
-    *bm_base += bm_pages;
+    bp = &pool->pages[page_idx];
+    bp->order = order + 1;
+    list_push_front(&pool->free_lists[order], &bp->elem);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -0,0 +1,389 @@
+#include "threads/smp.h"
+
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "devices/timer.h"
+#include "intrinsic.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/ioapic.h"
+#include "threads/lapic.h"
+#include "threads/mmu.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#include "userprog/tss.h"
+#endif
+
+/* Symmetric multiprocessing.
+
+   The BSP finds the other processors (the APs) in the ACPI
+   Multiple APIC Description Table, then starts each one with the
+   INIT-SIPI-SIPI sequence.  An AP runs the trampoline in start.S
+   up to long mode and enters ap_main(), which gives it its own
+   GDT, TSS and local APIC timer and makes it run the scheduler.
+
+   Each processor has its own ready queue in thread.c, and takes
+   threads from the others' when they have more urgent work.  The
+   queues, and the rest of the scheduler, stay correct because
+   disabling interrupts also acquires the big kernel lock (see
+   interrupt.c), so the kernel runs on one processor at a time
+   while user programs run on all of them. */
+
+/* Per-CPU state.  cpus[0] is the BSP. */
+struct cpu cpus[SMP_MAX_CPUS];
+int smp_cpu_cnt = 1;
+int smp_online_cnt = 1;
+
+/* Stack for the AP being started, read by ap_entry_64. */
+void *ap_stack;
+
+/* Local APIC timer counts per timer tick. */
+static uint32_t ap_timer_count;
+
+/* ACPI Root System Description Pointer.  See [ACPI] 5.2.5. */
+struct acpi_rsdp
+{
+    char signature[8]; /* "RSD PTR ". */
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_addr;
+} __attribute__((packed));
+
+/* ACPI System Description Table Header.  See [ACPI] 5.2.6. */
+struct acpi_header
+{
+    char signature[4];
+    uint32_t length; /* Including this header. */
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+/* Multiple APIC Description Table.  See [ACPI] 5.2.12. */
+struct acpi_madt
+{
+    struct acpi_header header; /* Signature "APIC". */
+    uint32_t lapic_addr;       /* Physical address of local APICs. */
+    uint32_t flags;
+    uint8_t entries[];         /* Interrupt controller structures. */
+} __attribute__((packed));
+
+/* MADT Processor Local APIC structure. */
+#define MADT_LAPIC 0
+struct madt_lapic
+{
+    uint8_t type; /* MADT_LAPIC. */
+    uint8_t length;
+    uint8_t processor_id;
+    uint8_t apic_id;
+    uint32_t flags; /* Bit 0: processor is enabled. */
+} __attribute__((packed));
+
+/* MADT I/O APIC structure. */
+#define MADT_IOAPIC 1
+struct madt_ioapic
+{
+    uint8_t type; /* MADT_IOAPIC. */
+    uint8_t length;
+    uint8_t ioapic_id;
+    uint8_t reserved;
+    uint32_t addr;     /* Physical address of its registers. */
+    uint32_t gsi_base; /* First global system interrupt it serves. */
+} __attribute__((packed));
+
+/* MADT Interrupt Source Override structure. */
+#define MADT_ISO 2
+struct madt_iso
+{
+    uint8_t type; /* MADT_ISO. */
+    uint8_t length;
+    uint8_t bus;    /* 0: ISA. */
+    uint8_t source; /* ISA IRQ. */
+    uint32_t gsi;   /* Global system interrupt it arrives on. */
+    uint16_t flags; /* MPS INTI flags: polarity and trigger mode. */
+} __attribute__((packed));
+
+static struct acpi_madt *acpi_find_madt(void);
+static struct acpi_rsdp *acpi_find_rsdp(uint64_t pa, size_t size);
+static void *acpi_map(uint64_t pa, size_t size);
+static bool acpi_checksum(const void *, size_t size);
+static bool start_ap(struct cpu *);
+static intr_handler_func ap_timer_interrupt;
+static intr_handler_func resched_interrupt;
+void ap_main(void) NO_RETURN;
+
+/* Finds the processors and the I/O APIC in the machine.  Must be
+   called on the BSP after paging_init(), before intr_init() and
+   before any other processor starts. */
+void smp_init(void)
+{
+    struct acpi_madt *madt = acpi_find_madt();
+    uint8_t *p, *end;
+
+    cpus[0].id = 0;
+    cpus[0].started = true;
+    if (madt == NULL) return;
+
+    lapic_init(madt->lapic_addr);
+    lapic_enable();
+    cpus[0].lapic_id = lapic_id();
+
+    end = (uint8_t *) madt + madt->header.length;
+    for (p = madt->entries; p + 2 <= end && p[1] >= 2; p += p[1])
+    {
+        struct madt_lapic *e = (struct madt_lapic *) p;
+        struct cpu *cpu;
+
+        if (p[0] == MADT_IOAPIC)
+        {
+            struct madt_ioapic *io = (struct madt_ioapic *) p;
+
+            if (io->gsi_base == 0) ioapic_init(io->addr, io->gsi_base);
+            continue;
+        }
+        if (p[0] == MADT_ISO)
+        {
+            struct madt_iso *iso = (struct madt_iso *) p;
+
+            if (iso->bus == 0)
+                ioapic_override(iso->source, iso->gsi, iso->flags);
+            continue;
+        }
+
+        if (e->type != MADT_LAPIC || !(e->flags & 1) ||
+            e->apic_id == cpus[0].lapic_id)
+            continue;
+        if (smp_cpu_cnt == SMP_MAX_CPUS) break;
+
+        cpu = &cpus[smp_cpu_cnt];
+        cpu->id = smp_cpu_cnt++;
+        cpu->lapic_id = e->apic_id;
+    }
+}
+
+/* Starts the APs found by smp_init().  Must be called on the BSP
+   with interrupts on, once the timer has been calibrated. */
+void smp_start(void)
+{
+    extern char ap_trampoline[], ap_trampoline_end[];
+    int i;
+
+    ASSERT(intr_get_level() == INTR_ON);
+
+    if (smp_cpu_cnt == 1) return;
+
+    intr_register_ext(LAPIC_VEC_TIMER, ap_timer_interrupt, "LAPIC Timer");
+    intr_register_ext(LAPIC_VEC_RESCHED, resched_interrupt, "Reschedule IPI");
+    ap_timer_count = lapic_timer_calibrate();
+
+    memcpy(ptov(AP_TRAMPOLINE), ap_trampoline,
+           ap_trampoline_end - ap_trampoline);
+    for (i = 1; i < smp_cpu_cnt; i++)
+        if (!start_ap(&cpus[i])) printf("smp: CPU %d did not start\n", i);
+
+    printf("smp: %d of %d CPUs online.\n", smp_online_cnt, smp_cpu_cnt);
+}
+
+/* Interrupts a processor other than the running one so that it
+   picks up T, which just became ready: the one that last ran T,
+   and so has T on its queue, if that is idle; otherwise another
+   idle processor if there is any, which steals T; otherwise,
+   unless the CFS is on or T is in the EDF class, the one running
+   the lowest-priority thread if that is lower than T's.  The
+   running processor is left to the caller, who yields if T should
+   preempt it.  Must be called with interrupts off. */
+void smp_reschedule(const struct thread *t)
+{
+    struct cpu *self, *lowest = NULL;
+    int i;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (smp_online_cnt == 1) return;
+
+    self = this_cpu();
+    if (t->cpu != NULL && t->cpu != self && t->cpu->current == t->cpu->idle)
+    {
+        lapic_send_ipi(t->cpu->lapic_id, LAPIC_VEC_RESCHED);
+        return;
+    }
+    for (i = 0; i < smp_cpu_cnt; i++)
+    {
+        struct cpu *cpu = &cpus[i];
+
+        if (cpu == self || !cpu->started) continue;
+        if (cpu->current == cpu->idle)
+        {
+            lapic_send_ipi(cpu->lapic_id, LAPIC_VEC_RESCHED);
+            return;
+        }
+        if (lowest == NULL ||
+            cpu->current->priority < lowest->current->priority)
+            lowest = cpu;
+    }
+
+    if (lowest != NULL && !thread_cfs && t->edf_period == 0 &&
+        lowest->current->priority < t->priority)
+        lapic_send_ipi(lowest->lapic_id, LAPIC_VEC_RESCHED);
+}
+
+/* Starts CPU and waits for it to enter the scheduler.  Returns
+   true if successful, false if it did not show up in time. */
+static bool start_ap(struct cpu *cpu)
+{
+    int i;
+
+    ap_stack = thread_prepare_ap(cpu);
+    if (ap_stack == NULL) return false;
+
+    /* See [IA32-v3a] 8.4.4.1 "Typical BSP Initialization Sequence". */
+    lapic_send_init(cpu->lapic_id);
+    timer_msleep(10);
+    for (i = 0; i < 2 && !cpu->started; i++)
+    {
+        lapic_send_startup(cpu->lapic_id, AP_TRAMPOLINE);
+        timer_usleep(200);
+    }
+
+    for (i = 0; i < 100 && !cpu->started; i++) timer_msleep(1);
+    return cpu->started;
+}
+
+/* Entry point of an AP, called by ap_entry_64 in start.S on the
+   stack of the thread that thread_prepare_ap() set up for it,
+   with interrupts off.  Repeats for this processor what main()
+   did for the BSP, then becomes its idle thread. */
+void ap_main(void)
+{
+    struct cpu *cpu = this_cpu();
+
+    thread_init_ap();
+    intr_init_ap();
+    fpu_init_ap();
+#ifdef USERPROG
+    tss_init();
+    gdt_init();
+    ltr(SEL_TSS);
+    syscall_init_ap();
+#endif
+
+    lapic_enable();
+    lapic_timer_start(ap_timer_count);
+
+    smp_online_cnt++;
+    cpu->started = true;
+    thread_start_ap();
+}
+
+/* Local APIC timer interrupt handler, which does for an AP what
+   timer_interrupt() does for the BSP, except keep time. */
+static void ap_timer_interrupt(struct intr_frame *args UNUSED)
+{
+    struct cpu *cpu = this_cpu();
+
+    cpu->local_ticks++;
+    thread_tick();
+    if (thread_mlfqs)
+    {
+        mlfqs_increment_recent_cpu();
+        if (cpu->local_ticks % 4 == 0) mlfqs_recalculate_priority();
+    }
+}
+
+/* Reschedule IPI handler.  Sent by smp_reschedule() to a
+   processor that should switch to a thread that just became
+   ready, unless another processor has taken it in the meantime. */
+static void resched_interrupt(struct intr_frame *args UNUSED)
+{
+    thread_preempt_on_return();
+}
+
+/* Returns the MADT, or a null pointer if there is none, in which
+   case we stay on the BSP. */
+static struct acpi_madt *acpi_find_madt(void)
+{
+    struct acpi_rsdp *rsdp;
+    struct acpi_header *rsdt;
+    uint16_t ebda;
+    size_t i, cnt;
+
+    /* The RSDP is in the first kB of the EBDA or in the BIOS
+       read-only area.  See [ACPI] 5.2.5.1. */
+    ebda = *(uint16_t *) ptov(0x40e);
+    rsdp = acpi_find_rsdp((uint64_t) ebda << 4, 1024);
+    if (rsdp == NULL) rsdp = acpi_find_rsdp(0xe0000, 0x20000);
+    if (rsdp == NULL) return NULL;
+
+    rsdt = acpi_map(rsdp->rsdt_addr, sizeof *rsdt);
+    rsdt = acpi_map(rsdp->rsdt_addr, rsdt->length);
+    if (memcmp(rsdt->signature, "RSDT", 4) ||
+        !acpi_checksum(rsdt, rsdt->length))
+        return NULL;
+
+    cnt = (rsdt->length - sizeof *rsdt) / sizeof(uint32_t);
+    for (i = 0; i < cnt; i++)
+    {
+        uint32_t pa = ((uint32_t *) (rsdt + 1))[i];
+        struct acpi_header *h = acpi_map(pa, sizeof *h);
+
+        h = acpi_map(pa, h->length);
+        if (!memcmp(h->signature, "APIC", 4) && acpi_checksum(h, h->length))
+            return (struct acpi_madt *) h;
+    }
+    return NULL;
+}
+
+/* Searches SIZE bytes of physical memory at PA for the RSDP,
+   which is 16-byte aligned. */
+static struct acpi_rsdp *acpi_find_rsdp(uint64_t pa, size_t size)
+{
+    uint8_t *p = ptov(pa);
+    uint8_t *end = p + size;
+
+    if (pa == 0) return NULL;
+    for (; p + sizeof(struct acpi_rsdp) <= end; p += 16)
+        if (!memcmp(p, "RSD PTR ", 8) &&
+            acpi_checksum(p, sizeof(struct acpi_rsdp)))
+            return (struct acpi_rsdp *) p;
+    return NULL;
+}
+
+/* Makes sure that SIZE bytes of physical memory at PA, which may
+   lie beyond the RAM that paging_init() mapped, are mapped, and
+   returns their kernel virtual address. */
+static void *acpi_map(uint64_t pa, size_t size)
+{
+    uint64_t page;
+
+    for (page = (uint64_t) pg_round_down(pa); page < pa + size;
+         page += PGSIZE)
+    {
+        uint64_t *pte = pml4e_walk(base_pml4, (uint64_t) ptov(page), 1);
+
+        if (pte == NULL) PANIC("cannot map ACPI tables");
+        if (!(*pte & PTE_P)) *pte = page | PTE_P;
+    }
+    return ptov(pa);
+}
+
+/* Returns true if the SIZE bytes at P add up to zero, as every
+   ACPI table does. */
+static bool acpi_checksum(const void *p_, size_t size)
+{
+    const uint8_t *p = p_;
+    uint8_t sum = 0;
+
+    while (size-- > 0) sum += *p++;
+    return sum == 0;
+}
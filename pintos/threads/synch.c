@@ -29,11 +29,50 @@
 #include "threads/synch.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+static bool waiter_less(const struct heap_elem *, const struct heap_elem *,
+                        void *aux);
+static void waiter_push(struct semaphore *, struct thread *);
+static struct thread *waiter_pop(struct semaphore *);
+static void waiters_refresh(struct semaphore *);
+static void donate(struct lock *);
+static void lockstat_acquired(struct lock_stat *, int64_t wait_start);
+static void lockstat_released(struct lock_stat *);
+
+/* Counter for the `wait_seq' of waiting threads, so that threads
+   of equal priority leave a semaphore in the order they came. */
+static int64_t next_wait_seq;
+
+/* Contention statistics for one named lock or semaphore.  All
+   times are in timer ticks. */
+struct lock_stat
+{
+    const char *name;   /* Name given to lock_set_name(). */
+    int64_t acquired;   /* Number of acquisitions. */
+    int64_t contended;  /* Acquisitions that had to block. */
+    int64_t wait_ticks; /* Total time spent blocked. */
+    int64_t wait_max;   /* Longest time spent blocked. */
+    int64_t hold_ticks; /* Total time held (locks only). */
+    int64_t hold_max;   /* Longest time held (locks only). */
+    int64_t hold_start; /* When the current holder got it. */
+};
+
+/* If true, named locks and semaphores keep statistics.  Set by
+   the kernel command-line option -o lockstat. */
+bool lockstat_enabled;
+
+/* Statistics for named locks and semaphores, handed out in order
+   by sema_set_name().  Names beyond the last are not tracked. */
+#define LOCKSTAT_CNT 64
+static struct lock_stat lock_stats[LOCKSTAT_CNT];
+static size_t lock_stat_cnt;
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -48,7 +87,30 @@ void sema_init(struct semaphore *sema, unsigned value)
     ASSERT(sema != NULL);
 
     sema->value = value;
-    list_init(&sema->waiters);
+    heap_init(&sema->waiters, waiter_less, NULL);
+    sema->waiters_epoch = 0;
+    sema->stat = NULL;
+}
+
+/* Names SEMA for the purpose of lockstat_print_stats(), which
+   also makes it keep statistics if lockstat_enabled is true.
+   NAME must stay valid for as long as the kernel runs. */
+void sema_set_name(struct semaphore *sema, const char *name)
+{
+    enum intr_level old_level;
+
+    ASSERT(sema != NULL);
+    ASSERT(name != NULL);
+
+    if (!lockstat_enabled) return;
+
+    old_level = intr_disable();
+    if (sema->stat == NULL && lock_stat_cnt < LOCKSTAT_CNT)
+    {
+        sema->stat = &lock_stats[lock_stat_cnt++];
+        sema->stat->name = name;
+    }
+    intr_set_level(old_level);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -62,18 +124,21 @@ void sema_init(struct semaphore *sema, unsigned value)
 void sema_down(struct semaphore *sema)
 {
     enum intr_level old_level;
+    int64_t wait_start = -1;
 
     ASSERT(sema != NULL);
     ASSERT(!intr_context());
 
     old_level = intr_disable();
+    if (sema->stat != NULL)
+        wait_start = sema->value == 0 ? timer_ticks() : -1;
     while (sema->value == 0)
     {
-        list_insert_ordered(&sema->waiters, &thread_current()->elem,
-                            priority_large, NULL);
+        waiter_push(sema, thread_current());
         thread_block();
     }
     sema->value--;
+    if (sema->stat != NULL) lockstat_acquired(sema->stat, wait_start);
     intr_set_level(old_level);
 }
 
@@ -93,6 +158,7 @@ bool sema_try_down(struct semaphore *sema)
     if (sema->value > 0)
     {
         sema->value--;
+        if (sema->stat != NULL) lockstat_acquired(sema->stat, -1);
         success = true;
     }
     else
@@ -113,18 +179,80 @@ void sema_up(struct semaphore *sema)
     ASSERT(sema != NULL);
 
     old_level = intr_disable();
-    if (!list_empty(&sema->waiters))
-    {
-        list_sort(&sema->waiters, priority_large, NULL);
-        thread_unblock(
-            list_entry(list_pop_front(&sema->waiters), struct thread, elem));
-    }
+    if (!heap_empty(&sema->waiters)) thread_unblock(waiter_pop(sema));
     sema->value++;
     intr_set_level(old_level);
 
     thread_yield_safe();
 }
 
+/* Returns true if waiting thread A should be woken after waiting
+   thread B: if it has lower priority, or if it has the same
+   priority and started waiting later. */
+static bool waiter_less(const struct heap_elem *a_,
+                        const struct heap_elem *b_, void *aux UNUSED)
+{
+    const struct thread *a = heap_entry(a_, struct thread, wait_elem);
+    const struct thread *b = heap_entry(b_, struct thread, wait_elem);
+
+    if (a->priority != b->priority) return a->priority < b->priority;
+    return a->wait_seq > b->wait_seq;
+}
+
+/* Adds T to the threads waiting for SEMA.  Interrupts must be
+   off. */
+static void waiter_push(struct semaphore *sema, struct thread *t)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (heap_empty(&sema->waiters)) sema->waiters_epoch = mlfqs_get_epoch();
+    t->wait_seq = next_wait_seq++;
+    t->wait_heap = &sema->waiters;
+    heap_push(&sema->waiters, &t->wait_elem);
+}
+
+/* Removes and returns the highest-priority thread waiting for
+   SEMA, which must have a waiter.  Interrupts must be off. */
+static struct thread *waiter_pop(struct semaphore *sema)
+{
+    struct thread *t;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    waiters_refresh(sema);
+    t = heap_entry(heap_pop(&sema->waiters), struct thread, wait_elem);
+    t->wait_heap = NULL;
+    return t;
+}
+
+/* Under the MLFQS, brings the priorities of the threads waiting
+   for SEMA up to date and re-sorts them, if a per-second decay has
+   happened since the stalest of them started waiting.  This costs
+   O(N log N) in the number of waiters, but at most once a second
+   per semaphore.  Interrupts must be off. */
+static void waiters_refresh(struct semaphore *sema)
+{
+    struct heap fresh;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (!thread_mlfqs || sema->waiters_epoch == mlfqs_get_epoch()) return;
+
+    heap_init(&fresh, waiter_less, NULL);
+    while (!heap_empty(&sema->waiters))
+    {
+        struct thread *t =
+            heap_entry(heap_pop(&sema->waiters), struct thread, wait_elem);
+
+        t->wait_heap = NULL;
+        mlfqs_refresh(t);
+        heap_push(&fresh, &t->wait_elem);
+        t->wait_heap = &sema->waiters;
+    }
+    sema->waiters = fresh;
+    sema->waiters_epoch = mlfqs_get_epoch();
+}
+
 static void sema_test_helper(void *sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -183,18 +311,13 @@ void lock_init(struct lock *lock)
     sema_init(&lock->semaphore, 1);
 }
 
-void do_donation()
+/* Names LOCK for the purpose of lockstat_print_stats().  See
+   sema_set_name(). */
+void lock_set_name(struct lock *lock, const char *name)
 {
-    struct thread *curr = thread_current();
+    ASSERT(lock != NULL);
 
-    while (curr->wait_on_lock != NULL)
-    {
-        if (curr->priority > curr->wait_on_lock->holder->priority)
-        {
-            curr->wait_on_lock->holder->priority = curr->priority;
-        }
-        curr = curr->wait_on_lock->holder;
-    }
+    sema_set_name(&lock->semaphore, name);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -207,28 +330,77 @@ void do_donation()
    we need to sleep. */
 void lock_acquire(struct lock *lock)
 {
+    struct thread *curr = thread_current();
+    enum intr_level old_level;
+    int64_t wait_start = -1;
+
     ASSERT(lock != NULL);
     ASSERT(!intr_context());
     ASSERT(!lock_held_by_current_thread(lock));
 
-    struct thread *curr = thread_current();
-
-    if (lock->holder != NULL)
+    /* This is sema_down(), with our priority donated to the holder
+       once we are among the waiters. */
+    old_level = intr_disable();
+    if (lock->semaphore.stat != NULL)
+        wait_start = lock->semaphore.value == 0 ? timer_ticks() : -1;
+    while (lock->semaphore.value == 0)
     {
+        waiter_push(&lock->semaphore, curr);
         if (!thread_mlfqs)
         {
             /* 현재 스레드 내 lock 정보를 등록한다 */
             curr->wait_on_lock = lock;
-            list_insert_ordered(&lock->holder->donor_list, &curr->donor_elem,
-                                priority_large, NULL);
-
-            do_donation();
+            donate(lock);
         }
+        thread_block();
     }
-
-    sema_down(&lock->semaphore);
-    lock->holder = curr;
+    lock->semaphore.value--;
     curr->wait_on_lock = NULL;
+    lock->holder = curr;
+    if (lock->semaphore.stat != NULL)
+        lockstat_acquired(lock->semaphore.stat, wait_start);
+
+    /* Any threads still waiting now donate to us. */
+    if (!thread_mlfqs)
+    {
+        heap_push(&curr->held_locks, &lock->held_elem);
+        thread_change_priority(curr, thread_effective_priority(curr));
+    }
+    intr_set_level(old_level);
+}
+
+/* Passes on the priority of the top waiter of LOCK to its holder,
+   then on to the holder of the lock that that thread waits for,
+   and so on, until a thread's effective priority stays the same.
+   Called with interrupts off when LOCK's top waiter may have
+   changed.
+
+   Each step re-keys one lock in its holder's `held_locks' and, by
+   changing the holder's priority, re-keys that thread in the
+   waiters of the next lock, so a chain of length D costs
+   O(D log N) in all. */
+static void donate(struct lock *lock)
+{
+    struct thread *holder;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    /* The holder is null between lock_release() and the woken
+       waiter taking the lock, in which case there is nobody to
+       donate to. */
+    while ((holder = lock->holder) != NULL)
+    {
+        int priority;
+
+        heap_update(&holder->held_locks, &lock->held_elem);
+        priority = thread_effective_priority(holder);
+        if (priority == holder->priority) break;
+
+        /* 준비 큐에 있는 holder라면 새 우선순위의 큐로 옮겨진다. */
+        thread_change_priority(holder, priority);
+        lock = holder->wait_on_lock;
+        if (lock == NULL) break;
+    }
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -239,52 +411,22 @@ void lock_acquire(struct lock *lock)
    interrupt handler. */
 bool lock_try_acquire(struct lock *lock)
 {
+    enum intr_level old_level;
     bool success;
 
     ASSERT(lock != NULL);
     ASSERT(!lock_held_by_current_thread(lock));
 
+    old_level = intr_disable();
     success = sema_try_down(&lock->semaphore);
-    if (success) lock->holder = thread_current();
-    return success;
-}
-
-/* 락을 제거한다. 락을 제거하고 싶은 스레드는 현재 스레드이다. */
-void lock_remove(struct lock *lock)
-{
-    struct thread *curr = thread_current();
-    struct thread *donor_thread = NULL;
-
-    curr->priority = curr->original_priority;
-
-    if (!list_empty(&curr->donor_list))
-    {
-        for (struct list_elem *e = list_begin(&curr->donor_list);
-             e != list_end(&curr->donor_list); e = list_next(e))
-        {
-            donor_thread = list_entry(e, struct thread, donor_elem);
-
-            if (donor_thread->wait_on_lock == lock)
-            {
-                list_remove(&donor_thread->donor_elem);
-            }
-        }
-    }
-}
-
-void restore_priority()
-{
-    struct thread *curr = thread_current();
-
-    if (!list_empty(&curr->donor_list))
+    if (success)
     {
-        struct thread *front = list_entry(list_front(&curr->donor_list),
-                                          struct thread, donor_elem);
-        if (front->priority > curr->priority)
-        {
-            curr->priority = front->priority;
-        }
+        lock->holder = thread_current();
+        if (!thread_mlfqs)
+            heap_push(&lock->holder->held_locks, &lock->held_elem);
     }
+    intr_set_level(old_level);
+    return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
@@ -295,18 +437,23 @@ void restore_priority()
    handler. */
 void lock_release(struct lock *lock)
 {
+    struct thread *curr = thread_current();
+    enum intr_level old_level;
+
     ASSERT(lock != NULL);
     ASSERT(lock_held_by_current_thread(lock));
 
     /* STEP: 기부받았던 priority를 복원하고 lock을 해제한다 */
-
+    old_level = intr_disable();
+    if (lock->semaphore.stat != NULL) lockstat_released(lock->semaphore.stat);
     if (!thread_mlfqs)
     {
-        lock_remove(lock);
-        restore_priority();
+        heap_remove(&curr->held_locks, &lock->held_elem);
+        thread_change_priority(curr, thread_effective_priority(curr));
     }
-
     lock->holder = NULL;
+    intr_set_level(old_level);
+
     sema_up(&lock->semaphore);
 }
 
@@ -320,13 +467,49 @@ bool lock_held_by_current_thread(const struct lock *lock)
     return lock->holder == thread_current();
 }
 
+/* Returns the priority of the highest-priority thread waiting for
+   LOCK, or PRI_MIN - 1 if there is none.  Interrupts must be off
+   for the answer to mean anything. */
+int lock_priority(const struct lock *lock)
+{
+    const struct heap *waiters = &lock->semaphore.waiters;
+
+    if (heap_empty(waiters)) return PRI_MIN - 1;
+    return heap_entry(heap_top(waiters), struct thread, wait_elem)->priority;
+}
+
+/* Orders locks in a thread's `held_locks' by lock_priority(). */
+bool lock_priority_less(const struct heap_elem *a, const struct heap_elem *b,
+                        void *aux UNUSED)
+{
+    return lock_priority(heap_entry(a, struct lock, held_elem)) <
+           lock_priority(heap_entry(b, struct lock, held_elem));
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem
 {
     struct list_elem elem;      /* List element. */
     struct semaphore semaphore; /* This semaphore. */
+    struct thread *thread;      /* Thread waiting on it. */
 };
 
+/* Returns true if the thread waiting on semaphore_elem A has
+   lower priority than the one waiting on B.  Priorities can
+   change while threads wait, so cond_signal() looks for the
+   maximum instead of keeping the list sorted; list_max() returns
+   the earliest of equals, keeping the order FIFO. */
+static bool cond_waiter_less(const struct list_elem *a_,
+                             const struct list_elem *b_, void *aux UNUSED)
+{
+    const struct semaphore_elem *a =
+        list_entry(a_, struct semaphore_elem, elem);
+    const struct semaphore_elem *b =
+        list_entry(b_, struct semaphore_elem, elem);
+
+    return a->thread->priority < b->thread->priority;
+}
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -357,22 +540,6 @@ void cond_init(struct condition *cond)
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
    we need to sleep. */
-bool sema_large(const struct list_elem *a_, const struct list_elem *b_,
-                void *aux UNUSED)
-{
-    const struct semaphore_elem *sema_a =
-        list_entry(a_, struct semaphore_elem, elem);
-    const struct semaphore_elem *sema_b =
-        list_entry(b_, struct semaphore_elem, elem);
-
-    struct thread *a =
-        list_entry(list_begin(&sema_a->semaphore.waiters), struct thread, elem);
-    struct thread *b =
-        list_entry(list_begin(&sema_b->semaphore.waiters), struct thread, elem);
-
-    return a->priority > b->priority;
-}
-
 void cond_wait(struct condition *cond, struct lock *lock)
 {
     struct semaphore_elem waiter;
@@ -383,7 +550,8 @@ void cond_wait(struct condition *cond, struct lock *lock)
     ASSERT(lock_held_by_current_thread(lock));
 
     sema_init(&waiter.semaphore, 0);
-    list_insert_ordered(&cond->waiters, &waiter.elem, sema_large, NULL);
+    waiter.thread = thread_current();
+    list_push_back(&cond->waiters, &waiter.elem);
 
     lock_release(lock);
     sema_down(&waiter.semaphore);
@@ -406,10 +574,23 @@ void cond_signal(struct condition *cond, struct lock *lock UNUSED)
 
     if (!list_empty(&cond->waiters))
     {
-        list_sort(&cond->waiters, sema_large, NULL);
-        sema_up(&list_entry(list_pop_front(&cond->waiters),
-                            struct semaphore_elem, elem)
-                     ->semaphore);
+        struct list_elem *e;
+
+        if (thread_mlfqs)
+        {
+            enum intr_level old_level = intr_disable();
+
+            for (e = list_begin(&cond->waiters); e != list_end(&cond->waiters);
+                 e = list_next(e))
+                mlfqs_refresh(
+                    list_entry(e, struct semaphore_elem, elem)->thread);
+            intr_set_level(old_level);
+        }
+
+        e = list_max(&cond->waiters, cond_waiter_less, NULL);
+
+        list_remove(e);
+        sema_up(&list_entry(e, struct semaphore_elem, elem)->semaphore);
     }
 }
 
@@ -426,3 +607,289 @@ void cond_broadcast(struct condition *cond, struct lock *lock)
 
     while (!list_empty(&cond->waiters)) cond_signal(cond, lock);
 }
+
+/* Initializes RW as free.
+
+   RW's inner lock is held by a writer for as long as it writes,
+   and by a reader only long enough to count itself in.  Readers
+   and writers alike thus queue up in the inner lock behind a
+   writer, in priority order, and donate their priority to it as
+   any lock waiter does.  Readers that hold RW are not donated to,
+   since it has no single holder, but a writer waiting for them to
+   leave has already shut out any more. */
+void rwlock_init(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+
+    lock_init(&rw->lock);
+    rw->readers = 0;
+    rw->draining = false;
+    sema_init(&rw->drained, 0);
+}
+
+/* Names RW for the purpose of lockstat_print_stats().  See
+   sema_set_name(). */
+void rwlock_set_name(struct rwlock *rw, const char *name)
+{
+    ASSERT(rw != NULL);
+
+    lock_set_name(&rw->lock, name);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void rwlock_read_acquire(struct rwlock *rw)
+{
+    enum intr_level old_level;
+
+    ASSERT(rw != NULL);
+    ASSERT(!intr_context());
+
+    lock_acquire(&rw->lock);
+    old_level = intr_disable();
+    rw->readers++;
+    intr_set_level(old_level);
+    lock_release(&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for reading.
+   If it was the last reader and a writer is waiting, wakes the
+   writer. */
+void rwlock_read_release(struct rwlock *rw)
+{
+    enum intr_level old_level;
+    bool wake = false;
+
+    ASSERT(rw != NULL);
+
+    old_level = intr_disable();
+    ASSERT(rw->readers > 0);
+    if (--rw->readers == 0 && rw->draining)
+    {
+        rw->draining = false;
+        wake = true;
+    }
+    intr_set_level(old_level);
+
+    if (wake) sema_up(&rw->drained);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  Readers that arrive meanwhile wait until the writer is
+   done.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void rwlock_write_acquire(struct rwlock *rw)
+{
+    enum intr_level old_level;
+
+    ASSERT(rw != NULL);
+    ASSERT(!intr_context());
+
+    lock_acquire(&rw->lock);
+
+    /* No reader can join now, so we only have to wait once. */
+    old_level = intr_disable();
+    if (rw->readers > 0)
+    {
+        rw->draining = true;
+        sema_down(&rw->drained);
+    }
+    intr_set_level(old_level);
+}
+
+/* Releases RW, which the current thread must hold for
+   writing. */
+void rwlock_write_release(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+    ASSERT(rw->readers == 0);
+
+    lock_release(&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool rwlock_write_held_by_current_thread(const struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+
+    return lock_held_by_current_thread(&rw->lock);
+}
+
+/* Initializes sequence lock SL. */
+void seqlock_init(struct seqlock *sl)
+{
+    ASSERT(sl != NULL);
+
+    sl->seq = 0;
+}
+
+/* Begins reading the record that SL protects, waiting for a write
+   in progress to finish.  Returns the sequence number to pass to
+   seqlock_read_retry() once the record has been copied.
+
+   x86 neither reorders loads with other loads nor stores with
+   other stores, so compiler barriers are enough to keep the
+   record's accesses between those of the sequence number.  See
+   [IA32-v3a] 8.2.2 "Memory Ordering in P6 and More Recent
+   Processor Families". */
+unsigned seqlock_read_begin(const struct seqlock *sl)
+{
+    unsigned seq;
+
+    ASSERT(sl != NULL);
+
+    while ((seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE)) & 1)
+        asm volatile("pause");
+    barrier();
+    return seq;
+}
+
+/* Returns true if the record that SL protects may have changed
+   since seqlock_read_begin() returned SEQ, in which case the copy
+   must be discarded and read again. */
+bool seqlock_read_retry(const struct seqlock *sl, unsigned seq)
+{
+    ASSERT(sl != NULL);
+
+    barrier();
+    return __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE) != seq;
+}
+
+/* Begins changing the record that SL protects.  The caller must
+   exclude other writers. */
+void seqlock_write_begin(struct seqlock *sl)
+{
+    ASSERT(sl != NULL);
+    ASSERT((sl->seq & 1) == 0);
+
+    __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+    barrier();
+}
+
+/* Finishes changing the record that SL protects. */
+void seqlock_write_end(struct seqlock *sl)
+{
+    ASSERT(sl != NULL);
+    ASSERT((sl->seq & 1) != 0);
+
+    __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Records in STAT an acquisition that blocked from tick
+   WAIT_START, or that did not block if WAIT_START is negative.
+   Interrupts must be off. */
+static void lockstat_acquired(struct lock_stat *stat, int64_t wait_start)
+{
+    int64_t now = timer_ticks();
+
+    stat->acquired++;
+    if (wait_start >= 0)
+    {
+        int64_t wait = now - wait_start;
+
+        stat->contended++;
+        stat->wait_ticks += wait;
+        if (wait > stat->wait_max) stat->wait_max = wait;
+    }
+    stat->hold_start = now;
+}
+
+/* Records in STAT that its lock was released.  Interrupts must
+   be off. */
+static void lockstat_released(struct lock_stat *stat)
+{
+    int64_t hold = timer_ticks() - stat->hold_start;
+
+    stat->hold_ticks += hold;
+    if (hold > stat->hold_max) stat->hold_max = hold;
+}
+
+/* Orders lock statistics from most to least contended, breaking
+   ties by total time spent waiting. */
+static int lockstat_compare(const void *a_, const void *b_)
+{
+    const struct lock_stat *a = *(const struct lock_stat **) a_;
+    const struct lock_stat *b = *(const struct lock_stat **) b_;
+
+    if (a->contended != b->contended)
+        return a->contended < b->contended ? 1 : -1;
+    if (a->wait_ticks != b->wait_ticks)
+        return a->wait_ticks < b->wait_ticks ? 1 : -1;
+    return 0;
+}
+
+/* Prints the statistics of named locks and semaphores, most
+   contended first, if lockstat_enabled is true. */
+void lockstat_print_stats(void)
+{
+    struct lock_stat *ranked[LOCKSTAT_CNT];
+    enum intr_level old_level;
+    size_t i, cnt;
+
+    if (!lockstat_enabled) return;
+
+    /* Take a snapshot, since printing takes the console lock. */
+    old_level = intr_disable();
+    cnt = lock_stat_cnt;
+    for (i = 0; i < cnt; i++) ranked[i] = &lock_stats[i];
+    intr_set_level(old_level);
+    qsort(ranked, cnt, sizeof *ranked, lockstat_compare);
+
+    printf("Lock statistics (times in ticks):\n");
+    printf("  %-16s %10s %10s %10s %8s %10s %8s\n", "name", "acquired",
+           "contended", "wait", "max", "hold", "max");
+    for (i = 0; i < cnt; i++)
+    {
+        const struct lock_stat *s = ranked[i];
+
+        printf("  %-16s %10lld %10lld %10lld %8lld %10lld %8lld\n", s->name,
+               s->acquired, s->contended, s->wait_ticks, s->wait_max,
+               s->hold_ticks, s->hold_max);
+    }
+}
+
+/* Initializes spinlock LOCK as free. */
+void spinlock_init(struct spinlock *lock)
+{
+    ASSERT(lock != NULL);
+
+    lock->locked = 0;
+}
+
+/* Acquires LOCK, spinning until it becomes available.  The
+   exchange is only retried after a plain read has seen the lock
+   free, so waiting processors spin in their own caches instead of
+   bouncing the lock's cache line between them.  `pause' tells the
+   processor that this is a spin-wait loop.  See [IA32-v2b]
+   "PAUSE". */
+void spinlock_acquire(struct spinlock *lock)
+{
+    ASSERT(lock != NULL);
+
+    while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE))
+        while (lock->locked) asm volatile("pause");
+}
+
+/* Tries to acquire LOCK without spinning.  Returns true if
+   successful, false if LOCK was already held. */
+bool spinlock_try_acquire(struct spinlock *lock)
+{
+    ASSERT(lock != NULL);
+
+    return !__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+/* Releases LOCK, which must be held. */
+void spinlock_release(struct spinlock *lock)
+{
+    ASSERT(lock != NULL);
+    ASSERT(lock->locked);
+
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
@@ -2,19 +2,25 @@
 
 #include <debug.h>
 #include <random.h>
+#include <round.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "devices/timer.h"
 #include "intrinsic.h"
 #include "threads/fixed-point.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -28,17 +34,55 @@
 /* ! Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-static struct list sleep_list;
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running, for
+   the priority scheduler and the MLFQS.
+
+   Each processor has its own run queue, with one FIFO list per
+   priority level.  Bit N of a queue's `mask' is set if and only
+   if its lists[N] is not empty, so the highest runnable priority
+   is found with a single find-last-set instead of a walk over a
+   sorted list.  A thread is queued on the processor that last ran
+   it, or for a new thread on the one that created it.  A
+   processor runs the highest-priority thread on any queue,
+   preferring its own, and steals it from another processor's
+   queue only when its own has nothing as urgent.  ready_mask is
+   the union of the queues' masks, so that the highest priority
+   overall is also a single find-last-set.
+
+   The CFS and EDF run queues further below are shared by all
+   processors. */
+struct ready_queue
+{
+    struct list lists[PRI_MAX + 1];
+    uint64_t mask;
+};
+static struct ready_queue ready_queues[SMP_MAX_CPUS];
+static uint64_t ready_mask;
+static size_t ready_cnt;          /* # of threads in all ready queues. */
+static long long ready_steal_cnt; /* # of threads run off another
+                                     processor's queue. */
+
+/* Hierarchical timing wheel of sleeping threads, keyed on
+   `wakeup_tick'.  Level L has SLEEP_WHEEL_SLOTS slots, each
+   covering 64^L ticks, so a sleeper is inserted in constant time
+   into the lowest level whose span reaches its deadline.  Every
+   64^L ticks the current slot of level L is "cascaded" into the
+   levels below it, which moves each sleeper at most
+   SLEEP_WHEEL_LEVELS - 1 times during its whole sleep.  Bit N of
+   sleep_wheel_mask[L] is set if and only if slot N of level L is
+   non-empty, so a tick on which nobody wakes up costs a single
+   bit test. */
+#define SLEEP_WHEEL_BITS 6
+#define SLEEP_WHEEL_SLOTS (1 << SLEEP_WHEEL_BITS)
+#define SLEEP_WHEEL_LEVELS 4
+#define SLEEP_WHEEL_SPAN (1LL << (SLEEP_WHEEL_BITS * SLEEP_WHEEL_LEVELS))
+static struct list sleep_wheel[SLEEP_WHEEL_LEVELS][SLEEP_WHEEL_SLOTS];
+static uint64_t sleep_wheel_mask[SLEEP_WHEEL_LEVELS];
+static int64_t sleep_wheel_now; /* Next tick the wheel will process. */
 
 static struct list all_list; /* List of all threads. */
 
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
@@ -53,9 +97,24 @@ static long long idle_ticks;   /* # of timer ticks spent idle. */
 static long long kernel_ticks; /* # of timer ticks in kernel threads. */
 static long long user_ticks;   /* # of timer ticks in user programs. */
 
+/* Pages of recently destroyed threads, kept for thread_create()
+   so that a burst of short-lived threads does not go through the
+   palloc pool lock and bitmap for every one.  Only the `struct
+   thread' at the bottom of a page is cleared for reuse, by
+   init_thread(); the stack above it is garbage either way.
+   Protected by disabling interrupts. */
+#define THREAD_CACHE_SIZE 16
+static struct thread *thread_cache[THREAD_CACHE_SIZE];
+static size_t thread_cache_cnt;
+static long long thread_cache_hits;   /* # of pages taken from cache. */
+static long long thread_cache_misses; /* # of pages from palloc. */
+
+/* Cache that `struct uni_file's are allocated from.  Created by
+   thread_start(), before the first thread_create(). */
+struct kmem_cache *uni_file_cache;
+
 /* Scheduling. */
-#define TIME_SLICE 4          /* # of timer ticks to give each thread. */
-static unsigned thread_ticks; /* # of timer ticks since last yield. */
+#define TIME_SLICE 4 /* # of timer ticks to give each thread. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
@@ -64,18 +123,169 @@ bool thread_mlfqs;
 
 static int load_avg; /* System load average for MLFQS (fixed-point) */
 
+/* Guards load_avg, so that thread_get_load_avg() can read it
+   without turning interrupts off.  Written with interrupts off. */
+static struct seqlock load_avg_seq;
+
+/* If true, use the completely fair scheduler.
+   Controlled by kernel command-line option "-o cfs".
+
+   The CFS keeps the ready threads in a heap ordered by virtual
+   runtime, the CPU time each has used divided by its weight, so
+   the thread furthest behind its share always runs next.  Weights
+   follow from `nice' as in Linux: each step costs a thread about
+   10% of the CPU against a competitor one step nicer.  Only the
+   running thread's vruntime ever changes, so there is no periodic
+   recomputation over all threads as in the MLFQS.
+
+   Instead of a fixed TIME_SLICE, the running thread may run for
+   its weight's share of CFS_LATENCY ticks, the period in which
+   every ready thread should get a turn, but at least
+   CFS_MIN_GRANULARITY ticks.  When there are too many threads for
+   that, the period stretches instead.
+
+   A thread that wakes up is placed no further back than half a
+   period behind cfs_min_vruntime, which follows the least
+   vruntime among the runnable threads, so it may not make up for
+   all the time it spent asleep. */
+bool thread_cfs;
+
+#define CFS_LATENCY 8         /* Target period, in timer ticks. */
+#define CFS_MIN_GRANULARITY 1 /* Least time slice, in timer ticks. */
+#define CFS_TICK 1024         /* vruntime of a nice 0 tick. */
+#define CFS_NICE_0_WEIGHT 1024
+
+/* Weight of each nice value from -20 to 20.  These are Linux's,
+   plus 12 for a nice of 20, which Linux does not have. */
+static const int cfs_weights[41] = {
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949,
+    11916, 9548,  7620,  6100,  4904,  3906,  3121,  2501,  1991,
+    1586,  1277,  1024,  820,   655,   526,   423,   335,   272,
+    215,   172,   137,   110,   87,    70,    56,    45,    36,
+    29,    23,    18,    15,    12,
+};
+
+static struct heap cfs_queue;    /* Ready threads, least vruntime on top. */
+static int64_t cfs_ready_weight; /* Sum of weights in cfs_queue. */
+static int64_t cfs_min_vruntime; /* Never decreases. */
+static int64_t next_run_seq;     /* Next run_seq, for either run queue. */
+
+/* Earliest-deadline-first scheduling class.
+
+   A thread joins the class with thread_set_deadline(), declaring
+   that it needs RUNTIME ticks of CPU time in every PERIOD ticks.
+   Each period is a job: it starts with a budget of RUNTIME ticks
+   and ends at the thread's deadline, or earlier if the thread
+   calls thread_deadline_wait() to say that it is done, which puts
+   it to sleep until the next period.  A job that is not done by
+   its deadline counts as a miss.
+
+   Ready EDF threads with budget left are in edf_queue, earliest
+   deadline first, and always run before any other thread,
+   whatever the scheduler.  A thread that runs out of budget drops
+   back to its ordinary priority (or nice value) until its next
+   period, so that it cannot take more than it reserved.  Every
+   EDF thread is also in edf_timeline, by deadline, so that the
+   timer only has to look at the first one to start new periods.
+
+   Admission control keeps the sum of RUNTIME / PERIOD over the
+   class within EDF_UTIL_MAX of one processor, which is enough for
+   every admitted thread to meet its deadlines as long as each job
+   fits in its budget, while leaving some time to everybody else. */
+#define EDF_UTIL_SCALE 1000000 /* Utilization of a whole processor. */
+#define EDF_UTIL_MAX (EDF_UTIL_SCALE / 100 * 95)
+
+static struct heap edf_queue;    /* Ready EDF threads with budget. */
+static struct heap edf_timeline; /* All EDF threads, by deadline. */
+static int64_t edf_util;         /* Admitted utilization. */
+
+/* Returns true if T is in the EDF class and has budget left. */
+#define edf_runnable(t) ((t)->edf_period != 0 && (t)->edf_budget > 0)
+
+/* Lazy recent_cpu decay for MLFQS.  Once a second every thread's
+   recent_cpu is multiplied by a coefficient that depends on
+   load_avg.  Instead of applying it to every thread from the
+   timer interrupt, each second is numbered (mlfqs_epoch) and its
+   coefficient remembered, and a thread replays the seconds it
+   missed when it is next looked at (see mlfqs_decay()).  Only
+   the running and ready threads are kept up to date eagerly.  A
+   blocked thread catches up when it is woken, or when a semaphore,
+   condition variable or futex picks which of its waiters to wake
+   (see mlfqs_refresh()). */
+#define MLFQS_DECAY_HISTORY 64
+static int mlfqs_decay_coef[MLFQS_DECAY_HISTORY]; /* Fixed-point. */
+static int64_t mlfqs_epoch; /* # of per-second decays so far. */
+
+/* Once a second the timer interrupt samples the number of ready
+   and running threads into mlfqs_ready_sample, and leaves the
+   load_avg and recent_cpu updates, which walk the run queue, to
+   mlfqs_work. */
+static int mlfqs_ready_sample;
+static struct work mlfqs_work;
+
+/* Number of ready threads that mlfqs_update() brings up to date
+   per stretch with interrupts off. */
+#define MLFQS_BATCH 8
+
+/* Longest stretch with interrupts off in mlfqs_update(), in TSC
+   cycles, and the most ready threads it has had to go through. */
+static uint64_t mlfqs_update_max_cycles;
+static size_t mlfqs_update_max_ready;
+
+/* If true, keep scheduling latency histograms (see thread.h).
+   Set by kernel command-line option "-o schedlat". */
+bool schedlat_enabled;
+static uint32_t schedlat[SCHEDLAT_KIND_CNT][PRI_MAX + 1][SCHEDLAT_BUCKETS];
+
 static void kernel_thread(thread_func *, void *aux);
 
+/* Offset of `stack' member within `struct thread'.
+   Used by switch.S, which can't figure it out on its own. */
+uint32_t thread_stack_ofs = offsetof(struct thread, stack);
+
 static void idle(void *aux UNUSED);
 static struct thread *next_thread_to_run(void);
 static void init_thread(struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule(void);
 static tid_t allocate_tid(void);
+static struct thread *thread_page_get(void);
+static void thread_page_put(struct thread *);
+static void ready_push(struct thread *);
+static void ready_remove(struct thread *);
+static int ready_max_priority(void);
+static struct list *ready_pick_queue(int);
+static bool ready_preempts(const struct thread *);
+static int cfs_weight(const struct thread *);
+static bool cfs_less(const struct heap_elem *, const struct heap_elem *,
+                     void *aux);
+static unsigned cfs_slice(const struct thread *);
+static void cfs_update_min_vruntime(const struct thread *);
+static bool edf_less(const struct heap_elem *, const struct heap_elem *,
+                     void *aux);
+static bool edf_timeline_less(const struct heap_elem *,
+                              const struct heap_elem *, void *aux);
+static void edf_leave(struct thread *);
+static void edf_replenish(int64_t now);
+static void sleep_wheel_insert(struct thread *);
+static int sleep_wheel_cascade(int level);
+static void mlfqs_decay(struct thread *);
+static void mlfqs_update(void *aux);
+static void mlfqs_update_note(uint64_t start);
+static void mlfqs_update_load_avg(void);
+static void mlfqs_update_recent_cpu(void);
+static int mlfqs_priority(const struct thread *);
+static void schedlat_ready(struct thread *, enum schedlat_kind);
+static void schedlat_record(const struct thread *);
+static void schedlat_print_stats(void);
+static intr_handler_func inspect_schedlat;
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
 
+/* Returns true if T is some processor's idle thread. */
+#define is_idle(t) ((t)->cpu != NULL && (t) == (t)->cpu->idle)
+
 /* Returns the running thread.
  * Read the CPU's stack pointer `rsp', and then round that
  * down to the start of a page.  Since `struct thread' is
@@ -103,6 +313,8 @@ static uint64_t gdt[3] = {0, 0x00af9a000000ffff, 0x00cf92000000ffff};
    finishes. */
 void thread_init(void)
 {
+    struct thread *t;
+
     ASSERT(intr_get_level() == INTR_OFF);
 
     /* Reload the temporal gdt for the kernel
@@ -114,33 +326,114 @@ void thread_init(void)
 
     /* Init the globla thread context */
     lock_init(&tid_lock);
-    list_init(&ready_list);
-    list_init(&sleep_list);
+    for (int i = 0; i < SMP_MAX_CPUS; i++)
+    {
+        for (int j = PRI_MIN; j <= PRI_MAX; j++)
+            list_init(&ready_queues[i].lists[j]);
+        ready_queues[i].mask = 0;
+    }
+    ready_mask = 0;
+    ready_cnt = 0;
+    heap_init(&cfs_queue, cfs_less, NULL);
+    heap_init(&edf_queue, edf_less, NULL);
+    heap_init(&edf_timeline, edf_timeline_less, NULL);
+    for (int i = 0; i < SLEEP_WHEEL_LEVELS; i++)
+    {
+        for (int j = 0; j < SLEEP_WHEEL_SLOTS; j++)
+            list_init(&sleep_wheel[i][j]);
+        sleep_wheel_mask[i] = 0;
+    }
+    sleep_wheel_now = 0;
     list_init(&destruction_req);
     list_init(&all_list);
 
     load_avg = 0; /* Initialize load_avg for MLFQS */
+    seqlock_init(&load_avg_seq);
+    mlfqs_epoch = 0;
+    work_init(&mlfqs_work, mlfqs_update, NULL);
 
     /* Set up a thread structure for the running thread. */
-    initial_thread = running_thread();
-    init_thread(initial_thread, "main", PRI_DEFAULT);
-    initial_thread->status = THREAD_RUNNING;
+    t = running_thread();
+    init_thread(t, "main", PRI_DEFAULT);
+    t->status = THREAD_RUNNING;
+    t->cpu = &cpus[0];
+    cpus[0].current = t;
+    initial_thread = t;
     initial_thread->tid = allocate_tid();
 }
 
+/* Loads the temporal gdt on an application processor, the way
+   thread_init() does on the BSP. */
+void thread_init_ap(void)
+{
+    struct desc_ptr gdt_ds = {.size = sizeof(gdt) - 1,
+                              .address = (uint64_t) gdt};
+
+    ASSERT(intr_get_level() == INTR_OFF);
+    lgdt(&gdt_ds);
+}
+
+/* Sets up the thread that application processor CPU starts out
+   on, which becomes its idle thread, and returns the top of its
+   stack.  Returns a null pointer if memory allocation fails. */
+void *thread_prepare_ap(struct cpu *cpu)
+{
+    char name[16];
+    struct thread *t;
+
+    t = palloc_get_page(PAL_ZERO);
+    if (t == NULL) return NULL;
+
+    snprintf(name, sizeof name, "idle%d", cpu->id);
+    init_thread(t, name, PRI_MIN);
+    t->status = THREAD_RUNNING;
+    t->tid = allocate_tid();
+    t->cpu = cpu;
+    cpu->idle = cpu->current = t;
+    return (uint8_t *) t + PGSIZE;
+}
+
+/* Called by an application processor, with interrupts off, once
+   it is ready to run threads.  The running thread becomes this
+   processor's idle thread. */
+void thread_start_ap(void)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    idle(NULL);
+    NOT_REACHED();
+}
+
+/* Returns the processor that is running this code.  Until
+   thread_init() has turned the boot code into a thread, that can
+   only be the BSP. */
+struct cpu *this_cpu(void)
+{
+    if (initial_thread == NULL) return &cpus[0];
+    return running_thread()->cpu;
+}
+
 /* Starts preemptive thread scheduling by enabling interrupts.
    Also creates the idle thread. */
 void thread_start(void)
 {
     /* Create the idle thread. */
     struct semaphore idle_started;
+
+    uni_file_cache =
+        kmem_cache_create("uni_file", sizeof(struct uni_file), NULL);
+    if (uni_file_cache == NULL) PANIC("out of memory for uni_file cache");
+
     sema_init(&idle_started, 0);
     thread_create("idle", PRI_MIN, idle, &idle_started);
 
+    intr_register_int(0x45, 3, INTR_OFF, inspect_schedlat,
+                      "Inspect Scheduling Latency");
+
     /* Start preemptive thread scheduling. */
     intr_enable();
 
-    /* Wait for the idle thread to initialize idle_thread. */
+    /* Wait for the idle thread to register itself as our CPU's. */
     sema_down(&idle_started);
 }
 
@@ -151,7 +444,7 @@ void thread_tick(void)
     struct thread *t = thread_current();
 
     /* Update statistics. */
-    if (t == idle_thread) idle_ticks++;
+    if (is_idle(t)) idle_ticks++;
 #ifdef USERPROG
     else if (t->pml4 != NULL)
         user_ticks++;
@@ -159,8 +452,21 @@ void thread_tick(void)
     else
         kernel_ticks++;
 
+    /* Charge the EDF budget, and drop back to the thread's ordinary
+       class once it runs out. */
+    if (edf_runnable(t) && --t->edf_budget == 0) intr_yield_on_return();
+
+    /* Charge the CFS for the tick. */
+    if (thread_cfs && !is_idle(t))
+    {
+        t->vruntime += CFS_TICK * CFS_NICE_0_WEIGHT / cfs_weight(t);
+        cfs_update_min_vruntime(t);
+    }
+
     /* Enforce preemption. */
-    if (++thread_ticks >= TIME_SLICE) intr_yield_on_return();
+    if (++this_cpu()->thread_ticks >=
+        (thread_cfs && !is_idle(t) ? cfs_slice(t) : TIME_SLICE))
+        intr_yield_on_return();
 }
 
 void thread_sleep(int64_t ticks)
@@ -170,48 +476,138 @@ void thread_sleep(int64_t ticks)
     struct thread *curr = thread_current();
     curr->wakeup_tick = timer_ticks() + ticks;
 
-    list_insert_ordered(&sleep_list, &curr->elem, wakeup_tick_less, NULL);
+    sleep_wheel_insert(curr);
 
     thread_block();
 
     intr_set_level(old_level);
 }
 
-bool wakeup_tick_less(const struct list_elem *a_, const struct list_elem *b_,
-                      void *aux UNUSED)
+/* Wakes up every sleeping thread whose wakeup_tick has arrived.
+   Called by the timer interrupt handler at each timer tick, so it
+   processes every tick up to and including the current one. */
+void thread_wakeup(void)
 {
-    const struct thread *a = list_entry(a_, struct thread, elem);
-    const struct thread *b = list_entry(b_, struct thread, elem);
+    int64_t now = timer_ticks();
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    /* Start new EDF periods first, so that a thread waking up for
+       its next period finds its budget replenished. */
+    edf_replenish(now);
 
-    return a->wakeup_tick < b->wakeup_tick;
+    for (; sleep_wheel_now <= now; sleep_wheel_now++)
+    {
+        int slot = sleep_wheel_now & (SLEEP_WHEEL_SLOTS - 1);
+
+        /* At the start of each lap of level L - 1, pull the next
+           slot of level L down into the lower levels. */
+        for (int level = 1; level < SLEEP_WHEEL_LEVELS; level++)
+        {
+            if (slot != 0) break;
+            slot = sleep_wheel_cascade(level);
+        }
+
+        slot = sleep_wheel_now & (SLEEP_WHEEL_SLOTS - 1);
+        if ((sleep_wheel_mask[0] & (1ULL << slot)) == 0) continue;
+
+        struct list *bucket = &sleep_wheel[0][slot];
+        while (!list_empty(bucket))
+            thread_unblock(
+                list_entry(list_pop_front(bucket), struct thread, elem));
+        sleep_wheel_mask[0] &= ~(1ULL << slot);
+    }
 }
 
-bool priority_large(const struct list_elem *a_, const struct list_elem *b_,
-                    void *aux UNUSED)
+/* Returns the earliest tick on which thread_wakeup() may have
+   a thread to wake up or an EDF period to start.  A sleeper may
+   be due later than that, but never earlier, so the timer can
+   safely stay quiet until then.  Must be called with interrupts
+   off. */
+int64_t thread_next_wakeup(void)
 {
-    const struct thread *a = list_entry(a_, struct thread, elem);
-    const struct thread *b = list_entry(b_, struct thread, elem);
+    int base = sleep_wheel_now & (SLEEP_WHEEL_SLOTS - 1);
+    uint64_t pending = sleep_wheel_mask[0] >> base;
+    int64_t next;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    /* Level 0 slots below BASE, and all higher levels, are not due
+       before the next cascade at the end of this lap. */
+    if (pending != 0)
+        next = sleep_wheel_now + __builtin_ctzll(pending);
+    else
+        next = sleep_wheel_now + (SLEEP_WHEEL_SLOTS - base);
+
+    /* The next EDF period starts then at the latest. */
+    if (!heap_empty(&edf_timeline))
+    {
+        const struct thread *t =
+            heap_entry(heap_top(&edf_timeline), struct thread, edf_elem);
 
-    return a->priority > b->priority;
+        if (t->edf_deadline < next) next = t->edf_deadline;
+    }
+    return next;
 }
 
-void thread_wakeup(void)
+/* Inserts sleeping thread T into the slot of the lowest wheel
+   level whose span covers T's wakeup_tick.  A deadline that has
+   already passed goes into the slot processed on the next tick;
+   one beyond the reach of the top level is parked in the farthest
+   top-level slot and re-inserted when that slot cascades. */
+static void sleep_wheel_insert(struct thread *t)
 {
-    while (!list_empty(&sleep_list))
+    int64_t expires = t->wakeup_tick;
+    int64_t delta = expires - sleep_wheel_now;
+    int level;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (delta < 0)
     {
-        struct thread *t =
-            list_entry(list_front(&sleep_list), struct thread, elem);
+        expires = sleep_wheel_now;
+        delta = 0;
+    }
+    else if (delta >= SLEEP_WHEEL_SPAN)
+    {
+        expires = sleep_wheel_now + SLEEP_WHEEL_SPAN - 1;
+        delta = SLEEP_WHEEL_SPAN - 1;
+    }
 
-        if (t->wakeup_tick <= timer_ticks())
-        {
-            list_pop_front(&sleep_list);
-            thread_unblock(t);
-        }
-        else
-        {
-            break;
-        }
+    for (level = 0; level < SLEEP_WHEEL_LEVELS - 1; level++)
+        if (delta < 1LL << (SLEEP_WHEEL_BITS * (level + 1))) break;
+
+    int slot =
+        (expires >> (SLEEP_WHEEL_BITS * level)) & (SLEEP_WHEEL_SLOTS - 1);
+    list_push_back(&sleep_wheel[level][slot], &t->elem);
+    sleep_wheel_mask[level] |= 1ULL << slot;
+}
+
+/* Empties the current slot of wheel LEVEL, re-inserting each of
+   its threads into the lower levels.  Returns the index of the
+   slot that was cascaded, so the caller knows whether LEVEL has
+   itself wrapped around. */
+static int sleep_wheel_cascade(int level)
+{
+    int slot = (sleep_wheel_now >> (SLEEP_WHEEL_BITS * level)) &
+               (SLEEP_WHEEL_SLOTS - 1);
+
+    if (sleep_wheel_mask[level] & (1ULL << slot))
+    {
+        struct list bucket;
+
+        /* Detach the slot first: a parked far-future sleeper may be
+           re-inserted into this very slot. */
+        list_init(&bucket);
+        while (!list_empty(&sleep_wheel[level][slot]))
+            list_push_back(&bucket, list_pop_front(&sleep_wheel[level][slot]));
+        sleep_wheel_mask[level] &= ~(1ULL << slot);
+
+        while (!list_empty(&bucket))
+            sleep_wheel_insert(
+                list_entry(list_pop_front(&bucket), struct thread, elem));
     }
+    return slot;
 }
 
 /* Prints thread statistics. */
@@ -219,6 +615,86 @@ void thread_print_stats(void)
 {
     printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
            idle_ticks, kernel_ticks, user_ticks);
+    printf("Thread: %lld pages from cache, %lld from palloc\n",
+           thread_cache_hits, thread_cache_misses);
+    if (smp_online_cnt > 1)
+        printf("Thread: %lld threads stolen from another CPU's queue\n",
+               ready_steal_cnt);
+    if (thread_mlfqs)
+        printf("Thread: MLFQS update kept interrupts off for at most "
+               "%llu TSC cycles, with up to %zu ready threads\n",
+               (unsigned long long) mlfqs_update_max_cycles,
+               mlfqs_update_max_ready);
+    if (schedlat_enabled) schedlat_print_stats();
+}
+
+/* Notes that T, which is being put on a ready queue for reason
+   KIND, is waiting to run as of now. */
+static void schedlat_ready(struct thread *t, enum schedlat_kind kind)
+{
+    if (!schedlat_enabled) return;
+
+    t->ready_tsc = rdtsc();
+    t->ready_kind = kind;
+}
+
+/* Adds the time T has spent ready to its histogram, as T is about
+   to run.  Interrupts must be off. */
+static void schedlat_record(const struct thread *t)
+{
+    uint64_t wait = rdtsc() - t->ready_tsc;
+    int class = thread_mlfqs || thread_cfs ? t->nice + 20 : t->priority;
+    int bucket = wait != 0 ? 63 - __builtin_clzll(wait) : 0;
+
+    if (bucket >= SCHEDLAT_BUCKETS) bucket = SCHEDLAT_BUCKETS - 1;
+    schedlat[t->ready_kind][class][bucket]++;
+}
+
+/* Prints the non-empty scheduling latency histograms, one line
+   per kind and priority (or nice value), as "B:COUNT" pairs. */
+static void schedlat_print_stats(void)
+{
+    static const char *kind_names[SCHEDLAT_KIND_CNT] = {"wakeup", "preempt"};
+    int kind, class, bucket;
+
+    printf("Scheduling latency (log2 TSC cycles:count):\n");
+    for (kind = 0; kind < SCHEDLAT_KIND_CNT; kind++)
+        for (class = 0; class <= PRI_MAX; class++)
+        {
+            bool empty = true;
+
+            for (bucket = 0; bucket < SCHEDLAT_BUCKETS; bucket++)
+            {
+                uint32_t cnt = schedlat[kind][class][bucket];
+
+                if (cnt == 0) continue;
+                if (empty)
+                    printf("  %-7s %s %3d:", kind_names[kind],
+                           thread_mlfqs || thread_cfs ? "nice" : "pri ",
+                           thread_mlfqs || thread_cfs ? class - 20 : class);
+                printf(" %d:%u", bucket, cnt);
+                empty = false;
+            }
+            if (!empty) printf("\n");
+        }
+}
+
+/* Tool for measuring scheduling latency, called via int 0x45.
+ * Input:
+ *   @RAX - kind of latency (enum schedlat_kind)
+ *   @RDX - priority, or nice value plus 20 under the MLFQS
+ *   @RCX - histogram bucket
+ * Output:
+ *   @RAX - Number of waits counted in that bucket. */
+static void inspect_schedlat(struct intr_frame *f)
+{
+    uint64_t kind = f->R.rax, class = f->R.rdx, bucket = f->R.rcx;
+
+    if (kind < SCHEDLAT_KIND_CNT && class <= PRI_MAX &&
+        bucket < SCHEDLAT_BUCKETS)
+        f->R.rax = schedlat[kind][class][bucket];
+    else
+        f->R.rax = 0;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -239,13 +715,14 @@ void thread_print_stats(void)
 tid_t thread_create(const char *name, int priority, thread_func *function,
                     void *aux)
 {
+    struct switch_threads_frame *sf;
     struct thread *t;
     tid_t tid;
 
     ASSERT(function != NULL);
 
     /* Allocate thread. */
-    t = palloc_get_page(PAL_ZERO);
+    t = thread_page_get();
     if (t == NULL) return TID_ERROR;
 
     /* Initialize thread. */
@@ -259,6 +736,8 @@ tid_t thread_create(const char *name, int priority, thread_func *function,
 
         mlfqs_calculate_priority(t);
     }
+    else if (thread_cfs)
+        t->nice = thread_current()->nice;
 
     list_push_back(&thread_current()->child_list, &t->child_elem);
     t->parent = thread_current();
@@ -266,28 +745,34 @@ tid_t thread_create(const char *name, int priority, thread_func *function,
 
     t->fdt = palloc_get_page(PAL_ZERO | PAL_USER);
 
-    t->fdt[0] = malloc(sizeof(struct uni_file));
+    t->fdt[0] = kmem_cache_alloc(uni_file_cache);
     t->fdt[0]->fd_type = FD_STDIN;
+    t->fdt[0]->ref_cnt = 1;
     t->fdt[0]->data.standard = (intptr_t) ~0;
 
-    t->fdt[1] = malloc(sizeof(struct uni_file));
+    t->fdt[1] = kmem_cache_alloc(uni_file_cache);
     t->fdt[1]->fd_type = FD_STDOUT;
+    t->fdt[1]->ref_cnt = 1;
     t->fdt[1]->data.standard = (intptr_t) ~1;
 
-    /* Call the kernel_thread if it scheduled.
-     * Note) rdi is 1st argument, and rsi is 2nd argument. */
-    t->tf.rip = (uintptr_t) kernel_thread;
-    t->tf.R.rdi = (uint64_t) function;
-    t->tf.R.rsi = (uint64_t) aux;
-    t->tf.ds = SEL_KDSEG;
-    t->tf.es = SEL_KDSEG;
-    t->tf.ss = SEL_KDSEG;
-    t->tf.cs = SEL_KCSEG;
-    t->tf.eflags = FLAG_IF;
+    /* Make the first switch_threads() to T return into
+       switch_entry(), which calls kernel_thread(FUNCTION, AUX).
+       The frame sits 16 bytes below the top of the page so that
+       the stack is aligned for that call.  Interrupts stay off
+       until kernel_thread() turns them on, which also hands over
+       the big kernel lock taken by whoever switched to T. */
+    sf = (struct switch_threads_frame *) ((uint8_t *) t + PGSIZE - 16) - 1;
+    sf->r12 = (uint64_t) function;
+    sf->r13 = (uint64_t) aux;
+    sf->r14 = (uint64_t) kernel_thread;
+    sf->rip = switch_entry;
+    sf->rbp = 0;
+    t->stack = (uint8_t *) sf;
 
     /* Add to run queue. */
     thread_unblock(t);
-    if (t->priority > thread_current()->priority)
+    if (thread_cfs ? ready_preempts(thread_current())
+                   : t->priority > thread_current()->priority)
     {
         thread_yield();
     }
@@ -325,8 +810,28 @@ void thread_unblock(struct thread *t)
 
     old_level = intr_disable();
     ASSERT(t->status == THREAD_BLOCKED);
-    list_insert_ordered(&ready_list, &t->elem, priority_large, NULL);
+    if (thread_mlfqs && !is_idle(t))
+    {
+        /* 잠들어 있던 동안 놓친 recent_cpu 감쇠를 반영한 뒤 큐에 넣는다. */
+        mlfqs_decay(t);
+        mlfqs_calculate_priority(t);
+    }
+    else if (thread_cfs && !is_idle(t))
+    {
+        /* Give back at most half a period for the time asleep. */
+        int64_t floor = cfs_min_vruntime - CFS_LATENCY * CFS_TICK / 2;
+
+        if (t->vruntime < floor) t->vruntime = floor;
+    }
+    ready_push(t);
     t->status = THREAD_READY;
+    schedlat_ready(t, SCHEDLAT_WAKEUP);
+    smp_reschedule(t);
+
+    /* An interrupt handler has no thread_yield_safe() to follow, so
+       let an EDF thread in as soon as the handler returns. */
+    if (intr_context() && edf_runnable(t) && ready_preempts(thread_current()))
+        intr_yield_on_return();
     intr_set_level(old_level);
 }
 
@@ -370,9 +875,12 @@ void thread_exit(void)
     process_exit();
 #endif
 
+    fpu_release(thread_current());
+
     /* Just set our status to dying and schedule another process.
        We will be destroyed during the call to schedule_tail(). */
     intr_disable();
+    if (thread_current()->edf_period != 0) edf_leave(thread_current());
     list_remove(&thread_current()->all_elem);  // 여기에 추가!
     do_schedule(THREAD_DYING);
     NOT_REACHED();
@@ -384,20 +892,26 @@ void thread_yield_safe(void)
     /* 1. 인터럽트 핸들러 안이 아닌가? */
     if (intr_context()) return;
 
-    /* 2. 준비 큐가 비어 있지 않은가?
-          (비어 있으면 list_front()를 호출할 수 없다.) */
-    if (list_empty(&ready_list)) return;
-
-    /* 3. 현재 스레드보다 더 높은 우선순위 스레드가 있는가? */
-    struct thread *front =
-        list_entry(list_front(&ready_list), struct thread, elem);
-
-    if (thread_current()->priority < front->priority)
+    /* 2. 현재 스레드보다 먼저 실행되어야 할 스레드가 준비 큐에 있는가? */
+    if (ready_preempts(thread_current()))
     {
         thread_yield();
     }
 }
 
+/* Called by an interrupt handler: makes the running thread yield
+   the CPU when the handler returns if a ready thread should run
+   instead, or if it is the idle thread and any thread is ready. */
+void thread_preempt_on_return(void)
+{
+    struct thread *curr = thread_current();
+
+    ASSERT(intr_context());
+
+    if (is_idle(curr) ? ready_cnt > 0 : ready_preempts(curr))
+        intr_yield_on_return();
+}
+
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
 void thread_yield(void)
@@ -408,8 +922,11 @@ void thread_yield(void)
     ASSERT(!intr_context());
 
     old_level = intr_disable();
-    if (curr != idle_thread)
-        list_insert_ordered(&ready_list, &curr->elem, priority_large, NULL);
+    if (!is_idle(curr))
+    {
+        ready_push(curr);
+        schedlat_ready(curr, SCHEDLAT_PREEMPT);
+    }
     do_schedule(THREAD_READY);
     intr_set_level(old_level);
 }
@@ -430,33 +947,63 @@ void thread_set_priority(int new_priority)
      */
 
     curr->original_priority = new_priority;
-    if (!list_empty(&curr->donor_list))
+    thread_change_priority(curr, thread_effective_priority(curr));
+
+    /* 실행 중인 스레드는 준비 큐에 없으므로 재정렬할 필요가 없다. */
+    if (ready_preempts(curr))
     {
-        if (new_priority > curr->priority)
-        {
-            curr->priority = new_priority;
-        }
+        thread_yield();
     }
-    else
+}
+
+/* Changes the effective priority of T to PRIORITY.  If T is
+   waiting in a ready queue, it is moved to the tail of the queue
+   for its new priority, so the run queue stays consistent in
+   constant time.  If T is waiting on a semaphore, its place in
+   the semaphore's waiter heap is updated.  Must be called with interrupts off or on the
+   running thread. */
+void thread_change_priority(struct thread *t, int priority)
+{
+    enum intr_level old_level;
+
+    ASSERT(is_thread(t));
+    ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
+
+    old_level = intr_disable();
+    if (t->status == THREAD_READY && t->priority != priority)
+    {
+        ready_remove(t);
+        t->priority = priority;
+        ready_push(t);
+    }
+    else if (t->wait_heap != NULL && t->priority != priority)
     {
-        curr->priority = new_priority;
+        t->priority = priority;
+        heap_update(t->wait_heap, &t->wait_elem);
     }
+    else
+        t->priority = priority;
+    intr_set_level(old_level);
+}
 
-    /* 고려 사항 (?)
-     * 1. 현재 스레드의 priority 값이 new_priority보다 작을 때
-     * 2. 기부하는 케이스가 아닌경우는?  */
+/* Returns the priority T should run at: its own priority or, if
+   it is greater, the priority of the highest-priority thread
+   waiting for a lock that T holds.  Each lock is keyed in
+   `held_locks' by its own top waiter, so this is O(1), and
+   nested donation follows from the waiters' priorities being
+   effective priorities themselves. */
+int thread_effective_priority(const struct thread *t)
+{
+    int priority = t->original_priority;
 
-    if (!list_empty(&ready_list))
+    if (!heap_empty(&t->held_locks))
     {
-        list_sort(&ready_list, priority_large, NULL);
-        struct thread *t =
-            list_entry(list_front(&ready_list), struct thread, elem);
+        struct lock *lock =
+            heap_entry(heap_top(&t->held_locks), struct lock, held_elem);
 
-        if (curr->priority < t->priority)
-        {
-            thread_yield();
-        }
+        if (lock_priority(lock) > priority) priority = lock_priority(lock);
     }
+    return priority;
 }
 
 /* Returns the current thread's priority. */
@@ -465,9 +1012,15 @@ int thread_get_priority(void)
     return thread_current()->priority;
 }
 
-/* Calculates and sets the priority of the given thread for MLFQS.
- * priority = PRI_MAX - (recent_cpu / 4) - (nice * 2) */
+/* Calculates and sets the priority of the given thread for MLFQS. */
 void mlfqs_calculate_priority(struct thread *t)
+{
+    thread_change_priority(t, mlfqs_priority(t));
+}
+
+/* Returns the MLFQS priority of T.
+ * priority = PRI_MAX - (recent_cpu / 4) - (nice * 2) */
+static int mlfqs_priority(const struct thread *t)
 {
     int calc_result = INT_TO_FIXED_POINT(PRI_MAX) -
                       DIV_FIXED_POINT_INT(t->recent_cpu, 4) -
@@ -478,7 +1031,7 @@ void mlfqs_calculate_priority(struct thread *t)
     if (new_priority < PRI_MIN) new_priority = PRI_MIN;
     if (new_priority > PRI_MAX) new_priority = PRI_MAX;
 
-    t->priority = new_priority;
+    return new_priority;
 }
 
 /* Increments recent_cpu of the current thread by 1 (called every tick).
@@ -487,47 +1040,190 @@ void mlfqs_increment_recent_cpu(void)
 {
     struct thread *current_thread = thread_current();
 
-    if (current_thread != idle_thread)
+    if (!is_idle(current_thread))
     {
         current_thread->recent_cpu =
             ADD_FIXED_POINT_INT(current_thread->recent_cpu, 1);
     }
 }
 
-/* Updates recent_cpu for all threads (called every second).
- * recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice */
-void mlfqs_update_recent_cpu(void)
+/* Called by the timer interrupt once a second.  Only samples the
+ * number of threads that want to run now; the updates themselves
+ * run in a worker thread. */
+void mlfqs_second(void)
+{
+    int ready_threads = ready_cnt;
+    int i;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    /* Count the thread running on each processor, too. */
+    for (i = 0; i < smp_cpu_cnt; i++)
+        if (cpus[i].current != NULL && !is_idle(cpus[i].current))
+            ready_threads++;
+
+    mlfqs_ready_sample = ready_threads;
+    work_schedule(&mlfqs_work, WORK_HIGH);
+}
+
+/* Notes that a stretch with interrupts off that began at TSC
+   value START is ending. */
+static void mlfqs_update_note(uint64_t start)
+{
+    uint64_t cycles = rdtsc() - start;
+
+    if (cycles > mlfqs_update_max_cycles) mlfqs_update_max_cycles = cycles;
+}
+
+/* Work function for the per-second MLFQS updates.  Starts a new
+ * decay second, then brings the ready threads up to date and
+ * re-queues them at their new priorities, MLFQS_BATCH at a time
+ * with interrupts off, turning interrupts back on in between.
+ *
+ * Every thread that ready_push() queues is already up to date, so
+ * the threads that missed this second are always at the front of
+ * their lists.  A single pass over each processor's queue from the
+ * highest list down, which moves on from a list as soon as its
+ * front thread is up to date, finds all of them, even though
+ * threads come and go between batches.  ready_push() keeps a
+ * re-queued thread on the same processor's queue. */
+static void mlfqs_update(void *aux UNUSED)
 {
-    struct list_elem *e;
+    enum intr_level old_level;
+    uint64_t start;
+    int cpu = 0, pri = PRI_MAX;
+
+    old_level = intr_disable();
+    start = rdtsc();
+    if (ready_cnt > mlfqs_update_max_ready) mlfqs_update_max_ready = ready_cnt;
+    mlfqs_update_load_avg();
+    mlfqs_update_recent_cpu();
+    mlfqs_update_note(start);
+    intr_set_level(old_level);
 
-    for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
+    while (cpu < smp_cpu_cnt)
     {
-        struct thread *t = list_entry(e, struct thread, all_elem);
+        int cnt = 0;
 
-        if (t != idle_thread)
+        old_level = intr_disable();
+        start = rdtsc();
+        while (cpu < smp_cpu_cnt && cnt < MLFQS_BATCH)
         {
-            int calc_result = ADD_FIXED_POINT_INT(
-                MUL_FIXED_POINT(
-                    DIV_FIXED_POINT(MUL_FIXED_POINT_INT(load_avg, 2),
-                                    ADD_FIXED_POINT_INT(
-                                        MUL_FIXED_POINT_INT(load_avg, 2), 1)),
-                    t->recent_cpu),
-                t->nice);
-
-            t->recent_cpu = calc_result;
+            struct list *queue = &ready_queues[cpu].lists[pri];
+            struct thread *t = NULL;
+
+            if (!list_empty(queue))
+                t = list_entry(list_front(queue), struct thread, elem);
+            if (t == NULL || t->recent_cpu_epoch == mlfqs_epoch)
+            {
+                /* Move on to the next list. */
+                if (pri-- == PRI_MIN)
+                {
+                    pri = PRI_MAX;
+                    cpu++;
+                }
+                continue;
+            }
+
+            /* ready_push() brings T up to date. */
+            ready_remove(t);
+            ready_push(t);
+            cnt++;
         }
+        mlfqs_update_note(start);
+        intr_set_level(old_level);
     }
 }
 
-/* Updates load_avg (called every second).
- * load_avg = (59/60) * load_avg + (1/60) * ready_threads */
-void mlfqs_update_load_avg(void)
+/* Starts a new decay second (called every second, after
+ * mlfqs_update_load_avg()).
+ * recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice
+ * The coefficient is recorded for every thread, which picks it up
+ * in mlfqs_decay() when it is next looked at.  The running thread
+ * is decayed right away, and mlfqs_update() then goes through the
+ * ready threads, whose priorities the scheduler looks at.
+ *
+ * Re-queueing the ready threads is the one part of the MLFQS that
+ * is still O(n), in the number of ready threads, once a second: a
+ * decay moves each of them by an amount that depends on its own
+ * recent_cpu and nice, so they cannot be moved as a group. */
+static void mlfqs_update_recent_cpu(void)
 {
-    int ready_threads = 0;
+    struct thread *curr = thread_current();
+
+    ASSERT(intr_get_level() == INTR_OFF);
 
-    if (thread_current() != idle_thread) ready_threads++;
+    mlfqs_decay_coef[mlfqs_epoch % MLFQS_DECAY_HISTORY] =
+        DIV_FIXED_POINT(MUL_FIXED_POINT_INT(load_avg, 2),
+                        ADD_FIXED_POINT_INT(MUL_FIXED_POINT_INT(load_avg, 2), 1));
+    mlfqs_epoch++;
 
-    ready_threads += list_size(&ready_list);
+    if (!is_idle(curr))
+    {
+        mlfqs_decay(curr);
+        mlfqs_calculate_priority(curr);
+    }
+}
+
+/* Brings T's recent_cpu up to date by replaying the per-second
+ * decays that T has missed since it was last updated.  If T has
+ * missed more seconds than we remember, the missing oldest ones
+ * are approximated with the oldest coefficient we still have;
+ * recent_cpu shrinks geometrically, so the error dies out. */
+static void mlfqs_decay(struct thread *t)
+{
+    int64_t missed = mlfqs_epoch - t->recent_cpu_epoch;
+    int64_t e;
+
+    if (missed > MLFQS_DECAY_HISTORY)
+    {
+        int coef = mlfqs_decay_coef[(mlfqs_epoch - MLFQS_DECAY_HISTORY) %
+                                    MLFQS_DECAY_HISTORY];
+
+        for (e = MLFQS_DECAY_HISTORY;
+             e < missed && e < 2 * MLFQS_DECAY_HISTORY; e++)
+            t->recent_cpu = ADD_FIXED_POINT_INT(
+                MUL_FIXED_POINT(coef, t->recent_cpu), t->nice);
+        missed = MLFQS_DECAY_HISTORY;
+    }
+
+    for (e = mlfqs_epoch - missed; e < mlfqs_epoch; e++)
+        t->recent_cpu = ADD_FIXED_POINT_INT(
+            MUL_FIXED_POINT(mlfqs_decay_coef[e % MLFQS_DECAY_HISTORY],
+                            t->recent_cpu),
+            t->nice);
+    t->recent_cpu_epoch = mlfqs_epoch;
+}
+
+/* Brings T's recent_cpu and priority up to date under the MLFQS,
+ * if T has missed any per-second decays.  For use on threads that
+ * are blocked, whose priorities are otherwise only brought up to
+ * date when they are woken, by code that is about to compare them.
+ * Interrupts must be off. */
+void mlfqs_refresh(struct thread *t)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (!thread_mlfqs || is_idle(t) || t->recent_cpu_epoch == mlfqs_epoch)
+        return;
+    mlfqs_decay(t);
+    mlfqs_calculate_priority(t);
+}
+
+/* Returns the number of per-second decays so far.  A thread whose
+ * recent_cpu was brought up to date at a smaller number may have
+ * a stale priority. */
+int64_t mlfqs_get_epoch(void)
+{
+    return mlfqs_epoch;
+}
+
+/* Updates load_avg (called every second), with the number of
+ * threads sampled by mlfqs_second().
+ * load_avg = (59/60) * load_avg + (1/60) * ready_threads */
+static void mlfqs_update_load_avg(void)
+{
+    int ready_threads = mlfqs_ready_sample;
 
     int calc_result = ADD_FIXED_POINT(
         MUL_FIXED_POINT(
@@ -537,18 +1233,27 @@ void mlfqs_update_load_avg(void)
             DIV_FIXED_POINT(INT_TO_FIXED_POINT(1), INT_TO_FIXED_POINT(60)),
             ready_threads));
 
+    seqlock_write_begin(&load_avg_seq);
     load_avg = calc_result;
+    seqlock_write_end(&load_avg_seq);
 }
 
-/* Recalculates priority for all threads (for MLFQS). */
-void mlfqs_recalculate_priority_all(void)
+/* Recalculates the running thread's priority (called every 4
+ * ticks).  Only the running thread's recent_cpu has changed since
+ * the last recalculation: nice changes are applied by
+ * thread_set_nice() and decays by mlfqs_update_recent_cpu().
+ * The latter only reaches the thread running on the BSP, so a
+ * thread on another processor catches up here.
+ * Preempts the running thread if it is no longer the highest. */
+void mlfqs_recalculate_priority(void)
 {
-    struct list_elem *e;
-    for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
-    {
-        struct thread *t = list_entry(e, struct thread, all_elem);
-        mlfqs_calculate_priority(t);
-    }
+    struct thread *curr = thread_current();
+
+    if (is_idle(curr)) return;
+
+    mlfqs_decay(curr);
+    mlfqs_calculate_priority(curr);
+    if (ready_preempts(curr)) intr_yield_on_return();
 }
 
 /* Returns the current thread's nice value. */
@@ -572,25 +1277,29 @@ void thread_set_nice(int nice)
         // 새로운 NICE 값에 따라 우선순위 재계산
         mlfqs_calculate_priority(current_thread);
 
-        if (!list_empty(&ready_list))
+        // 현재 실행중인 스레드의 우선순위가 더 이상 최고가 아니라면 cpu를
+        // yield한다.
+        if (ready_preempts(current_thread))
         {
-            struct thread *front =
-                list_entry(list_front(&ready_list), struct thread, elem);
-
-            // 현재 실행중인 스레드의 우선순위가 더 이상 최고가 아니라면 cpu를
-            // yield한다.
-            if (front->priority > current_thread->priority)
-            {
-                thread_yield();
-            }
+            thread_yield();
         }
     }
+    else if (thread_cfs && ready_preempts(current_thread))
+        thread_yield();
 }
 
 /* 현재 load_avg에 100을 곱한 값을 반올림한 정수를 반환 */
 int thread_get_load_avg()
 {
-    return FIXED_POINT_TO_INT_NEAREST(MUL_FIXED_POINT_INT(load_avg, 100));
+    unsigned seq;
+    int la;
+
+    do
+    {
+        seq = seqlock_read_begin(&load_avg_seq);
+        la = load_avg;
+    } while (seqlock_read_retry(&load_avg_seq, seq));
+    return FIXED_POINT_TO_INT_NEAREST(MUL_FIXED_POINT_INT(la, 100));
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
@@ -601,41 +1310,108 @@ int thread_get_recent_cpu(void)
         MUL_FIXED_POINT_INT(current_thread->recent_cpu, 100));
 }
 
+/* Puts the running thread in the EDF class, reserving RUNTIME
+   ticks of CPU time in every PERIOD ticks, starting with a period
+   that begins now.  If it is already in the class, its
+   reservation is replaced.  A RUNTIME of 0 takes the thread out of
+   the class.  Returns false, leaving the thread as it was, if the
+   arguments are invalid or if admitting the reservation would
+   overcommit the class. */
+bool thread_set_deadline(int64_t runtime, int64_t period)
+{
+    struct thread *curr = thread_current();
+    enum intr_level old_level;
+    int64_t util, old_util = 0;
+    bool success = true;
+
+    if (runtime == 0)
+    {
+        old_level = intr_disable();
+        if (curr->edf_period != 0) edf_leave(curr);
+        intr_set_level(old_level);
+        return true;
+    }
+    if (runtime < 0 || period <= 0 || runtime > period) return false;
+    util = DIV_ROUND_UP(runtime * EDF_UTIL_SCALE, period);
+
+    old_level = intr_disable();
+    if (curr->edf_period != 0)
+        old_util = DIV_ROUND_UP(curr->edf_runtime * EDF_UTIL_SCALE,
+                                curr->edf_period);
+    if (edf_util - old_util + util > EDF_UTIL_MAX)
+        success = false;
+    else
+    {
+        if (curr->edf_period != 0) edf_leave(curr);
+        curr->edf_runtime = curr->edf_budget = runtime;
+        curr->edf_period = period;
+        curr->edf_deadline = timer_ticks() + period;
+        curr->edf_pending = true;
+        heap_push(&edf_timeline, &curr->edf_elem);
+        edf_util += util;
+    }
+    intr_set_level(old_level);
+    return success;
+}
+
+/* Ends the running EDF thread's job for this period and sleeps
+   until the next period begins.  Does nothing if the thread is
+   not in the EDF class. */
+void thread_deadline_wait(void)
+{
+    struct thread *curr = thread_current();
+    enum intr_level old_level = intr_disable();
+
+    if (curr->edf_period != 0)
+    {
+        curr->edf_pending = false;
+        curr->wakeup_tick = curr->edf_deadline;
+        sleep_wheel_insert(curr);
+        thread_block();
+    }
+    intr_set_level(old_level);
+}
+
+/* Returns the number of deadlines the running thread has missed
+   in the EDF class. */
+int thread_get_deadline_misses(void)
+{
+    return thread_current()->edf_misses;
+}
+
 /* Idle thread.  Executes when no other thread is ready to run.
 
-   The idle thread is initially put on the ready list by
+   The BSP's idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   point it registers itself as the BSP's idle thread, "up"s the
+   semaphore passed to it to enable thread_start() to continue,
+   and immediately blocks.  An AP's idle thread is the thread it
+   boots on, which calls here through thread_start_ap() with a
+   null IDLE_STARTED.  After that, an idle thread never appears in
+   a ready queue.  It is returned by next_thread_to_run() as a
+   special case when no processor's ready queue has a thread. */
 static void idle(void *idle_started_ UNUSED)
 {
     struct semaphore *idle_started = idle_started_;
+    struct cpu *cpu = this_cpu();
 
-    idle_thread = thread_current();
-    sema_up(idle_started);
+    cpu->idle = thread_current();
+    if (idle_started != NULL) sema_up(idle_started);
 
     for (;;)
     {
-        /* Let someone else run. */
+        /* Let someone else run, after catching `ticks' up with the
+           time we spent halted.  Only the BSP keeps time. */
         intr_disable();
+        if (cpu->id == 0) timer_idle_exit();
         thread_block();
 
-        /* Re-enable interrupts and wait for the next one.
-
-           The `sti' instruction disables interrupts until the
-           completion of the next instruction, so these two
-           instructions are executed atomically.  This atomicity is
-           important; otherwise, an interrupt could be handled
-           between re-enabling interrupts and waiting for the next
-           one to occur, wasting as much as one clock tick worth of
-           time.
+        /* Nothing else to run, so let the timer skip the ticks
+           until the next sleeper is due. */
+        if (cpu->id == 0) timer_idle_enter();
 
-           See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-           7.11.1 "HLT Instruction". */
-        asm volatile("sti; hlt" : : : "memory");
+        /* Re-enable interrupts and wait for the next one. */
+        intr_wait();
     }
 }
 
@@ -653,6 +1429,8 @@ static void kernel_thread(thread_func *function, void *aux)
    NAME. */
 static void init_thread(struct thread *t, const char *name, int priority)
 {
+    enum intr_level old_level;
+
     ASSERT(t != NULL);
     ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
     ASSERT(name != NULL);
@@ -660,18 +1438,23 @@ static void init_thread(struct thread *t, const char *name, int priority)
     memset(t, 0, sizeof *t);
     t->status = THREAD_BLOCKED;
     strlcpy(t->name, name, sizeof t->name);
-    t->tf.rsp = (uint64_t) t + PGSIZE - sizeof(void *);
     t->priority = priority;
     t->original_priority = priority;
     t->nice = 0;
     t->recent_cpu = 0;
+    t->recent_cpu_epoch = mlfqs_epoch;
+    t->vruntime = cfs_min_vruntime;
+    t->edf_period = 0;
     t->wait_on_lock = NULL;
-    list_init(&t->donor_list);
+    heap_init(&t->held_locks, lock_priority_less, NULL);
+    t->wait_heap = NULL;
     list_init(&t->child_list);
     sema_init(&t->fork_sema, 0);
     sema_init(&t->wait_sema, 0);
     sema_init(&t->exit_sema, 0);
+    old_level = intr_disable();
     list_push_back(&all_list, &t->all_elem);
+    intr_set_level(old_level);
     t->magic = THREAD_MAGIC;
 }
 
@@ -679,13 +1462,321 @@ static void init_thread(struct thread *t, const char *name, int priority)
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   the running processor's idle thread. */
 static struct thread *next_thread_to_run(void)
 {
-    if (list_empty(&ready_list))
-        return idle_thread;
+    if (!heap_empty(&edf_queue))
+    {
+        struct thread *t =
+            heap_entry(heap_top(&edf_queue), struct thread, run_elem);
+        ready_remove(t);
+        return t;
+    }
+    else if (thread_cfs)
+    {
+        struct thread *t;
+
+        if (heap_empty(&cfs_queue)) return this_cpu()->idle;
+        t = heap_entry(heap_top(&cfs_queue), struct thread, run_elem);
+        ready_remove(t);
+        cfs_update_min_vruntime(t);
+        return t;
+    }
+    else if (ready_mask == 0)
+        return this_cpu()->idle;
     else
-        return list_entry(list_pop_front(&ready_list), struct thread, elem);
+    {
+        struct thread *t = list_entry(
+            list_front(ready_pick_queue(ready_max_priority())), struct thread,
+            elem);
+        ready_remove(t);
+        return t;
+    }
+}
+
+/* Returns the list of threads of priority PRI that the running
+   processor should take its next thread from, which must be
+   non-empty on some processor: its own if that has one, otherwise
+   the first other processor's after it in turn, so that stealing
+   is spread over the processors. */
+static struct list *ready_pick_queue(int pri)
+{
+    struct cpu *self = this_cpu();
+    int i;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (ready_queues[self->id].mask & (1ULL << pri))
+        return &ready_queues[self->id].lists[pri];
+
+    for (i = 1; i < smp_cpu_cnt; i++)
+    {
+        struct ready_queue *rq = &ready_queues[(self->id + i) % smp_cpu_cnt];
+
+        if (rq->mask & (1ULL << pri))
+        {
+            ready_steal_cnt++;
+            return &rq->lists[pri];
+        }
+    }
+    NOT_REACHED();
+}
+
+/* Appends T to the tail of the ready queue for its priority on
+   the processor that last ran it, or under the CFS inserts it
+   into the run queue behind any thread with the same vruntime.
+   An EDF thread with budget left goes into the EDF run queue
+   instead, behind any thread with the same deadline. */
+static void ready_push(struct thread *t)
+{
+    struct ready_queue *rq;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+    if (edf_runnable(t))
+    {
+        t->run_seq = next_run_seq++;
+        heap_push(&edf_queue, &t->run_elem);
+        ready_cnt++;
+        return;
+    }
+    else if (thread_cfs)
+    {
+        t->run_seq = next_run_seq++;
+        heap_push(&cfs_queue, &t->run_elem);
+        cfs_ready_weight += cfs_weight(t);
+        ready_cnt++;
+        return;
+    }
+
+    /* Under the MLFQS, queue T up to date, so that mlfqs_update()
+       finds the threads that missed a decay at the queue fronts. */
+    if (thread_mlfqs && !is_idle(t) && t->recent_cpu_epoch != mlfqs_epoch)
+    {
+        mlfqs_decay(t);
+        t->priority = mlfqs_priority(t);
+    }
+
+    /* Queue T on the processor that last ran it, unless that is
+       not running the scheduler. */
+    if (t->cpu == NULL || !t->cpu->started) t->cpu = this_cpu();
+    rq = &ready_queues[t->cpu->id];
+    list_push_back(&rq->lists[t->priority], &t->elem);
+    rq->mask |= 1ULL << t->priority;
+    ready_mask |= 1ULL << t->priority;
+    ready_cnt++;
+}
+
+/* Removes T from the ready queue for its priority on the
+   processor it is queued on, or from the CFS or EDF run queue. */
+static void ready_remove(struct thread *t)
+{
+    struct ready_queue *rq;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (edf_runnable(t))
+    {
+        heap_remove(&edf_queue, &t->run_elem);
+        ready_cnt--;
+        return;
+    }
+    else if (thread_cfs)
+    {
+        heap_remove(&cfs_queue, &t->run_elem);
+        cfs_ready_weight -= cfs_weight(t);
+        ready_cnt--;
+        return;
+    }
+
+    rq = &ready_queues[t->cpu->id];
+    list_remove(&t->elem);
+    if (list_empty(&rq->lists[t->priority]))
+    {
+        int i;
+
+        rq->mask &= ~(1ULL << t->priority);
+        ready_mask = 0;
+        for (i = 0; i < smp_cpu_cnt; i++) ready_mask |= ready_queues[i].mask;
+    }
+    ready_cnt--;
+}
+
+/* Returns the highest priority among the ready threads, or -1 if
+   no thread is ready. */
+static int ready_max_priority(void)
+{
+    return ready_mask == 0 ? -1 : 63 - __builtin_clzll(ready_mask);
+}
+
+/* Returns true if a ready thread should run instead of CURR, which
+   is running: if an EDF thread is ready with an earlier deadline,
+   or CURR is not an EDF thread with budget left; under the CFS,
+   if the thread furthest behind is behind CURR by more than a
+   tick, so that threads on the same vruntime do not keep
+   preempting each other; otherwise, if it has a higher
+   priority. */
+static bool ready_preempts(const struct thread *curr)
+{
+    enum intr_level old_level;
+    bool preempt = false;
+
+    old_level = intr_disable();
+    if (!heap_empty(&edf_queue))
+    {
+        const struct thread *first =
+            heap_entry(heap_top(&edf_queue), struct thread, run_elem);
+
+        preempt = !edf_runnable(curr) ||
+                  first->edf_deadline < curr->edf_deadline;
+    }
+    else if (edf_runnable(curr))
+        preempt = false;
+    else if (!thread_cfs)
+        preempt = curr->priority < ready_max_priority();
+    else if (!heap_empty(&cfs_queue))
+    {
+        const struct thread *first =
+            heap_entry(heap_top(&cfs_queue), struct thread, run_elem);
+
+        preempt = first->vruntime + CFS_TICK < curr->vruntime;
+    }
+    intr_set_level(old_level);
+    return preempt;
+}
+
+/* Returns T's CFS weight. */
+static int cfs_weight(const struct thread *t)
+{
+    int nice = t->nice < -20 ? -20 : t->nice > 20 ? 20 : t->nice;
+
+    return cfs_weights[nice + 20];
+}
+
+/* Returns true if ready thread A should run after ready thread B:
+   if it has a greater vruntime, or if it has the same vruntime and
+   became ready later. */
+static bool cfs_less(const struct heap_elem *a_, const struct heap_elem *b_,
+                     void *aux UNUSED)
+{
+    const struct thread *a = heap_entry(a_, struct thread, run_elem);
+    const struct thread *b = heap_entry(b_, struct thread, run_elem);
+
+    if (a->vruntime != b->vruntime) return a->vruntime > b->vruntime;
+    return a->run_seq > b->run_seq;
+}
+
+/* Returns the number of ticks running thread T may run before it
+   is preempted: its weight's share of the CFS period, among the
+   threads that are ready and T itself.  Each processor has a
+   period of its own, so the threads running elsewhere do not
+   count.  Interrupts must be off. */
+static unsigned cfs_slice(const struct thread *t)
+{
+    int64_t weight = cfs_weight(t);
+    int64_t period = CFS_LATENCY;
+    int64_t slice;
+    size_t nr_running = ready_cnt + 1;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (nr_running > CFS_LATENCY / CFS_MIN_GRANULARITY)
+        period = nr_running * CFS_MIN_GRANULARITY;
+    slice = period * weight / (cfs_ready_weight + weight);
+    return slice > CFS_MIN_GRANULARITY ? slice : CFS_MIN_GRANULARITY;
+}
+
+/* Advances cfs_min_vruntime to the least vruntime among T, which
+   is running or about to, and the ready threads.  With several
+   processors the other running threads are not considered, so
+   the floor is only approximate, which only affects how far
+   back a waking thread may be placed. */
+static void cfs_update_min_vruntime(const struct thread *t)
+{
+    int64_t vruntime = t->vruntime;
+
+    if (!heap_empty(&cfs_queue))
+    {
+        const struct thread *first =
+            heap_entry(heap_top(&cfs_queue), struct thread, run_elem);
+
+        if (first->vruntime < vruntime) vruntime = first->vruntime;
+    }
+    if (vruntime > cfs_min_vruntime) cfs_min_vruntime = vruntime;
+}
+
+/* Returns true if ready EDF thread A should run after ready EDF
+   thread B: if its deadline is later, or if it has the same
+   deadline and became ready later. */
+static bool edf_less(const struct heap_elem *a_, const struct heap_elem *b_,
+                     void *aux UNUSED)
+{
+    const struct thread *a = heap_entry(a_, struct thread, run_elem);
+    const struct thread *b = heap_entry(b_, struct thread, run_elem);
+
+    if (a->edf_deadline != b->edf_deadline)
+        return a->edf_deadline > b->edf_deadline;
+    return a->run_seq > b->run_seq;
+}
+
+/* Returns true if EDF thread A's deadline is later than B's. */
+static bool edf_timeline_less(const struct heap_elem *a_,
+                              const struct heap_elem *b_, void *aux UNUSED)
+{
+    const struct thread *a = heap_entry(a_, struct thread, edf_elem);
+    const struct thread *b = heap_entry(b_, struct thread, edf_elem);
+
+    return a->edf_deadline > b->edf_deadline;
+}
+
+/* Takes T, which must be running, out of the EDF class and gives
+   back its reservation.  Interrupts must be off. */
+static void edf_leave(struct thread *t)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(t->status == THREAD_RUNNING);
+
+    heap_remove(&edf_timeline, &t->edf_elem);
+    edf_util -= DIV_ROUND_UP(t->edf_runtime * EDF_UTIL_SCALE, t->edf_period);
+    t->edf_period = 0;
+}
+
+/* Starts a new period for every EDF thread whose deadline is at or
+   before NOW, counting a miss for each deadline that passed with
+   the job not done.  A ready thread moves to the run queue its new
+   budget puts it in, and preempts the running thread if it
+   should. */
+static void edf_replenish(int64_t now)
+{
+    bool woken = false;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    while (!heap_empty(&edf_timeline))
+    {
+        struct thread *t =
+            heap_entry(heap_top(&edf_timeline), struct thread, edf_elem);
+        bool ready = t->status == THREAD_READY;
+
+        if (t->edf_deadline > now) break;
+
+        if (ready) ready_remove(t);
+        for (; t->edf_deadline <= now; t->edf_deadline += t->edf_period)
+        {
+            if (t->edf_pending) t->edf_misses++;
+            t->edf_pending = true;
+        }
+        t->edf_budget = t->edf_runtime;
+        heap_update(&edf_timeline, &t->edf_elem);
+        if (ready)
+        {
+            ready_push(t);
+            woken = true;
+        }
+    }
+
+    if (woken && ready_preempts(thread_current())) intr_yield_on_return();
 }
 
 /* Use iretq to launch the thread */
@@ -718,74 +1809,27 @@ void do_iret(struct intr_frame *tf)
         : "memory");
 }
 
-/* Switching the thread by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
+/* Switches to thread TH, which must be ready to run and whose
+   address space schedule() has already activated.
+
+   Every switch happens in the kernel, between two threads that
+   called schedule() with interrupts off (or a new thread that
+   will start in switch_entry()), so only the callee-saved
+   registers and the stack pointer need to change hands; see
+   switch.S.  iretq is left to do_iret(), which enters user mode.
 
-   At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.
+   At this function's return, we are running again, having been
+   switched back to by some other thread, and interrupts are still
+   disabled.
 
    It's not safe to call printf() until the thread switch is
    complete.  In practice that means that printf()s should be
    added at the end of the function. */
 static void thread_launch(struct thread *th)
 {
-    uint64_t tf_cur = (uint64_t) &running_thread()->tf;
-    uint64_t tf = (uint64_t) &th->tf;
     ASSERT(intr_get_level() == INTR_OFF);
 
-    /* The main switching logic.
-     * We first restore the whole execution context into the intr_frame
-     * and then switching to the next thread by calling do_iret.
-     * Note that, we SHOULD NOT use any stack from here
-     * until switching is done. */
-    __asm __volatile(
-        /* Store registers that will be used. */
-        "push %%rax\n"
-        "push %%rbx\n"
-        "push %%rcx\n"
-        /* Fetch input once */
-        "movq %0, %%rax\n"
-        "movq %1, %%rcx\n"
-        "movq %%r15, 0(%%rax)\n"
-        "movq %%r14, 8(%%rax)\n"
-        "movq %%r13, 16(%%rax)\n"
-        "movq %%r12, 24(%%rax)\n"
-        "movq %%r11, 32(%%rax)\n"
-        "movq %%r10, 40(%%rax)\n"
-        "movq %%r9, 48(%%rax)\n"
-        "movq %%r8, 56(%%rax)\n"
-        "movq %%rsi, 64(%%rax)\n"
-        "movq %%rdi, 72(%%rax)\n"
-        "movq %%rbp, 80(%%rax)\n"
-        "movq %%rdx, 88(%%rax)\n"
-        "pop %%rbx\n"  // Saved rcx
-        "movq %%rbx, 96(%%rax)\n"
-        "pop %%rbx\n"  // Saved rbx
-        "movq %%rbx, 104(%%rax)\n"
-        "pop %%rbx\n"  // Saved rax
-        "movq %%rbx, 112(%%rax)\n"
-        "addq $120, %%rax\n"
-        "movw %%es, (%%rax)\n"
-        "movw %%ds, 8(%%rax)\n"
-        "addq $32, %%rax\n"
-        "call __next\n"  // read the current rip.
-        "__next:\n"
-        "pop %%rbx\n"
-        "addq $(out_iret -  __next), %%rbx\n"
-        "movq %%rbx, 0(%%rax)\n"  // rip
-        "movw %%cs, 8(%%rax)\n"   // cs
-        "pushfq\n"
-        "popq %%rbx\n"
-        "mov %%rbx, 16(%%rax)\n"  // eflags
-        "mov %%rsp, 24(%%rax)\n"  // rsp
-        "movw %%ss, 32(%%rax)\n"
-        "mov %%rcx, %%rdi\n"
-        "call do_iret\n"
-        "out_iret:\n"
-        :
-        : "g"(tf_cur), "g"(tf)
-        : "memory");
+    switch_threads(running_thread(), th);
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -800,7 +1844,7 @@ static void do_schedule(int status)
     {
         struct thread *victim =
             list_entry(list_pop_front(&destruction_req), struct thread, elem);
-        palloc_free_page(victim);
+        thread_page_put(victim);
     }
     thread_current()->status = status;
     schedule();
@@ -810,15 +1854,20 @@ static void schedule(void)
 {
     struct thread *curr = running_thread();
     struct thread *next = next_thread_to_run();
+    struct cpu *cpu = curr->cpu;
 
     ASSERT(intr_get_level() == INTR_OFF);
     ASSERT(curr->status != THREAD_RUNNING);
     ASSERT(is_thread(next));
-    /* Mark us as running. */
+    /* Mark us as running, on this processor. */
     next->status = THREAD_RUNNING;
+    next->cpu = cpu;
+    cpu->current = next;
 
     /* Start new time slice. */
-    thread_ticks = 0;
+    cpu->thread_ticks = 0;
+
+    if (schedlat_enabled && !is_idle(next)) schedlat_record(next);
 
 #ifdef USERPROG
     /* Activate the new address space. */
@@ -840,12 +1889,56 @@ static void schedule(void)
             list_push_back(&destruction_req, &curr->elem);
         }
 
+        /* Leave the FPU registers to NEXT, or arrange to trap. */
+        fpu_switch(curr, next);
+
         /* Before switching the thread, we first save the information
          * of current running. */
         thread_launch(next);
     }
 }
 
+/* Returns a page for a new thread, preferably one from the
+   thread cache, or a null pointer if memory is exhausted.  The
+   page's contents are undefined. */
+static struct thread *thread_page_get(void)
+{
+    enum intr_level old_level = intr_disable();
+    struct thread *t = NULL;
+
+    if (thread_cache_cnt > 0)
+    {
+        t = thread_cache[--thread_cache_cnt];
+        thread_cache_hits++;
+    }
+    intr_set_level(old_level);
+    if (t != NULL) return t;
+
+    /* Only a page actually taken from palloc counts as a miss. */
+    t = palloc_get_page(0);
+    if (t != NULL)
+    {
+        old_level = intr_disable();
+        thread_cache_misses++;
+        intr_set_level(old_level);
+    }
+    return t;
+}
+
+/* Releases dead thread T's page, keeping it in the thread cache
+   if there is room.  Interrupts must be off. */
+static void thread_page_put(struct thread *t)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    /* Make a stale pointer to T fail is_thread(). */
+    t->magic = 0;
+    if (thread_cache_cnt < THREAD_CACHE_SIZE)
+        thread_cache[thread_cache_cnt++] = t;
+    else
+        palloc_free_page(t);
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t allocate_tid(void)
 {
@@ -0,0 +1,117 @@
+#include "threads/workqueue.h"
+
+#include <debug.h>
+#include <stdio.h>
+
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* A queue of work items served by one worker thread. */
+struct workqueue
+{
+    const char *name;      /* Name of the worker thread. */
+    int priority;          /* Its priority. */
+    int nice;              /* Its nice value, for the MLFQS and CFS. */
+    struct list items;     /* Scheduled work items. */
+    struct thread *worker; /* Worker thread, once started. */
+    bool waiting;          /* Worker blocked for lack of work? */
+    long long run_cnt;     /* # of work items run. */
+};
+
+static struct workqueue workqueues[WORK_CLASS_CNT] = {
+    [WORK_HIGH] = {"kworker/hi", PRI_MAX, -20},
+    [WORK_NORMAL] = {"kworker", PRI_DEFAULT, 0},
+};
+
+static thread_func worker_thread;
+
+/* Initializes the workqueues and starts their worker threads.
+   Must be called after thread_start() and before any interrupt
+   handler schedules work. */
+void workqueue_init(void)
+{
+    int i;
+
+    for (i = 0; i < WORK_CLASS_CNT; i++) list_init(&workqueues[i].items);
+    for (i = 0; i < WORK_CLASS_CNT; i++)
+        thread_create(workqueues[i].name, workqueues[i].priority,
+                      worker_thread, &workqueues[i]);
+}
+
+/* Initializes W to run FUNC(AUX) when scheduled. */
+void work_init(struct work *w, work_func *func, void *aux)
+{
+    ASSERT(w != NULL);
+    ASSERT(func != NULL);
+
+    w->func = func;
+    w->aux = aux;
+    w->pending = false;
+}
+
+/* Queues W to be run by CLASS's worker thread, unless it is
+   already queued and has not started yet.  Returns true if W was
+   queued, false if it already was.  May be called from an
+   interrupt handler, in which case a WORK_HIGH item runs as soon
+   as the handler returns. */
+bool work_schedule(struct work *w, enum work_class class)
+{
+    struct workqueue *wq = &workqueues[class];
+    enum intr_level old_level;
+    bool queued;
+
+    ASSERT(class < WORK_CLASS_CNT);
+
+    old_level = intr_disable();
+    queued = !w->pending;
+    if (queued)
+    {
+        w->pending = true;
+        list_push_back(&wq->items, &w->elem);
+        if (wq->waiting)
+        {
+            wq->waiting = false;
+            thread_unblock(wq->worker);
+        }
+        if (class == WORK_HIGH && intr_context()) intr_yield_on_return();
+    }
+    intr_set_level(old_level);
+    return queued;
+}
+
+/* Prints workqueue statistics. */
+void workqueue_print_stats(void)
+{
+    int i;
+
+    for (i = 0; i < WORK_CLASS_CNT; i++)
+        printf("Workqueue: %s ran %lld work items\n", workqueues[i].name,
+               workqueues[i].run_cnt);
+}
+
+/* Worker thread for workqueue WQ_.  Runs its work items in order,
+   and blocks whenever it runs out. */
+static void worker_thread(void *wq_)
+{
+    struct workqueue *wq = wq_;
+
+    wq->worker = thread_current();
+    thread_set_nice(wq->nice);
+    for (;;)
+    {
+        enum intr_level old_level = intr_disable();
+        struct work *w;
+
+        while (list_empty(&wq->items))
+        {
+            wq->waiting = true;
+            thread_block();
+        }
+        w = list_entry(list_pop_front(&wq->items), struct work, elem);
+        w->pending = false;
+        wq->run_cnt++;
+        intr_set_level(old_level);
+
+        w->func(w->aux);
+    }
+}
@@ -7,6 +7,7 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "userprog/gdt.h"
+#include "userprog/process.h"
 #include "userprog/syscall.h"
 
 /* Number of page faults processed. */
@@ -48,8 +49,6 @@ void exception_init(void)
     intr_register_int(0, 0, INTR_ON, kill, "#DE Divide Error");
     intr_register_int(1, 0, INTR_ON, kill, "#DB Debug Exception");
     intr_register_int(6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-    intr_register_int(7, 0, INTR_ON, kill,
-                      "#NM Device Not Available Exception");
     intr_register_int(11, 0, INTR_ON, kill, "#NP Segment Not Present");
     intr_register_int(12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
     intr_register_int(13, 0, INTR_ON, kill, "#GP General Protection Exception");
@@ -90,6 +89,7 @@ static void kill(struct intr_frame *f)
             printf("%s: dying due to interrupt %#04llx (%s).\n", thread_name(),
                    f->vec_no, intr_name(f->vec_no));
             intr_dump_frame(f);
+            process_kill(-1);
             thread_exit();
 
         case SEL_KCSEG:
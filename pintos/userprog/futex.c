@@ -0,0 +1,158 @@
+#include "userprog/futex.h"
+
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Futexes ("fast user-space mutexes").
+
+   User programs build their locks out of atomic instructions on
+   an int in their own memory, and only make a system call when
+   they have to wait or when somebody may be waiting.  A waiter
+   passes the value it expects the int to have; it sleeps only if
+   the int still has it.  The check and the sleep are atomic with
+   respect to futex_wake(), since both run with interrupts off, so
+   a waker that changes the int and then calls futex_wake() cannot
+   slip in between.
+
+   Waiters are keyed by the kernel virtual address of the int,
+   which names the physical frame and offset rather than the user
+   address, so threads that map the same frame at different
+   addresses still meet.  Each waiter sleeps on a semaphore of its
+   own, as in cond_wait(), in a bucket chosen by hashing the key. */
+
+/* Number of hash buckets. */
+#define FUTEX_BUCKETS 64
+
+/* A thread waiting in futex_wait(). */
+struct futex_waiter
+{
+    struct list_elem elem;      /* Element in its bucket. */
+    const int *key;             /* Kernel address of the int. */
+    struct thread *thread;      /* The waiting thread. */
+    struct semaphore semaphore; /* Upped to wake it. */
+};
+
+/* Waiters, hashed by key.  Protected by disabling interrupts. */
+static struct list buckets[FUTEX_BUCKETS];
+
+/* Initializes the futex waiter buckets. */
+void futex_init(void)
+{
+    int i;
+
+    for (i = 0; i < FUTEX_BUCKETS; i++) list_init(&buckets[i]);
+}
+
+/* Returns the key for user address UADDR in the running process,
+   which must be mapped. */
+static const int *futex_key(int *uaddr)
+{
+    const int *key = pml4_get_page(thread_current()->pml4, uaddr);
+
+    ASSERT(key != NULL);
+    return key;
+}
+
+/* Returns the bucket for KEY. */
+static struct list *futex_bucket(const int *key)
+{
+    return &buckets[hash_bytes(&key, sizeof key) % FUTEX_BUCKETS];
+}
+
+/* If the int at user address UADDR, which must be mapped and
+   aligned, still equals VAL, sleeps until futex_wake() is called
+   on it, or until the thread is killed, and returns 0.  Otherwise
+   returns -1 at once. */
+int futex_wait(int *uaddr, int val)
+{
+    struct futex_waiter waiter;
+    enum intr_level old_level;
+
+    ASSERT(!intr_context());
+
+    waiter.key = futex_key(uaddr);
+    waiter.thread = thread_current();
+    sema_init(&waiter.semaphore, 0);
+
+    old_level = intr_disable();
+    if (waiter.thread->killed || *(volatile const int *) waiter.key != val)
+    {
+        intr_set_level(old_level);
+        return -1;
+    }
+    list_push_back(futex_bucket(waiter.key), &waiter.elem);
+    sema_down(&waiter.semaphore);
+    intr_set_level(old_level);
+    return 0;
+}
+
+/* Wakes up to CNT threads waiting on the int at user address
+   UADDR, which must be mapped and aligned, highest priority
+   first.  Returns the number of threads woken. */
+int futex_wake(int *uaddr, int cnt)
+{
+    const int *key = futex_key(uaddr);
+    struct list *bucket = futex_bucket(key);
+    enum intr_level old_level;
+    int woken = 0;
+
+    old_level = intr_disable();
+    while (woken < cnt)
+    {
+        struct futex_waiter *best = NULL;
+        struct list_elem *e;
+
+        /* The earliest of equals keeps the order FIFO. */
+        for (e = list_begin(bucket); e != list_end(bucket); e = list_next(e))
+        {
+            struct futex_waiter *w = list_entry(e, struct futex_waiter, elem);
+
+            if (w->key != key) continue;
+            mlfqs_refresh(w->thread);
+            if (best == NULL || w->thread->priority > best->thread->priority)
+                best = w;
+        }
+        if (best == NULL) break;
+
+        list_remove(&best->elem);
+        sema_up(&best->semaphore);
+        woken++;
+    }
+    intr_set_level(old_level);
+    return woken;
+}
+
+/* Wakes every thread waiting in futex_wait() that has been killed,
+   so that it can exit. */
+void futex_wake_killed(void)
+{
+    enum intr_level old_level = intr_disable();
+    int i;
+
+    for (i = 0; i < FUTEX_BUCKETS; i++)
+    {
+        struct list_elem *e = list_begin(&buckets[i]);
+
+        while (e != list_end(&buckets[i]))
+        {
+            struct futex_waiter *w = list_entry(e, struct futex_waiter, elem);
+
+            if (w->thread->killed)
+            {
+                /* sema_up() may yield, so start over. */
+                list_remove(e);
+                sema_up(&w->semaphore);
+                e = list_begin(&buckets[i]);
+            }
+            else
+                e = list_next(e);
+        }
+    }
+    intr_set_level(old_level);
+}
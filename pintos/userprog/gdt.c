@@ -1,10 +1,12 @@
 #include "userprog/gdt.h"
 
 #include <debug.h>
+#include <string.h>
 
 #include "intrinsic.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/vaddr.h"
 #include "userprog/tss.h"
 
@@ -68,7 +70,10 @@ struct segment_descriptor64
             (unsigned) (base) >> 24                                          \
     }
 
-static struct segment_desc gdt[SEL_CNT] = {
+/* Template for the GDT of each processor, which gdt_init() copies
+   into its `struct cpu'.  Every processor needs its own, because
+   the TSS descriptor differs and because `ltr' marks it busy. */
+static const struct segment_desc gdt_template[SEL_CNT] = {
     [SEL_NULL >> 3] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
     [SEL_KCSEG >> 3] = SEG64(0xa, 0x0, 0xffffffff, 0),
     [SEL_KDSEG >> 3] = SEG64(0x2, 0x0, 0xffffffff, 0),
@@ -79,17 +84,20 @@ static struct segment_desc gdt[SEL_CNT] = {
     [7] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
 };
 
-struct desc_ptr gdt_ds = {.size = sizeof(gdt) - 1, .address = (uint64_t) gdt};
-
-/* Sets up a proper GDT.  The bootstrap loader's GDT didn't
-   include user-mode selectors or a TSS, but we need both now. */
+/* Sets up a proper GDT for the running processor.  The bootstrap
+   loader's GDT didn't include user-mode selectors or a TSS, but we
+   need both now.  tss_init() must have been called first. */
 void gdt_init(void)
 {
     /* Initialize GDT. */
+    struct segment_desc *gdt = (struct segment_desc *) this_cpu()->gdt;
+    struct desc_ptr gdt_ds = {.size = sizeof gdt_template - 1,
+                              .address = (uint64_t) gdt};
     struct segment_descriptor64 *tss_desc =
         (struct segment_descriptor64 *) &gdt[SEL_TSS >> 3];
     struct task_state *tss = tss_get();
 
+    memcpy(gdt, gdt_template, sizeof gdt_template);
     *tss_desc = (struct segment_descriptor64){
         .lim_15_0 = (uint64_t) (sizeof(struct task_state)) & 0xffff,
         .base_15_0 = (uint64_t) (tss) &0xffff,
@@ -14,27 +14,53 @@
 #include "intrinsic.h"
 #include "lib/string.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/tss.h"
+#include "userprog/vdso.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
 
+/* FS base MSR, which user code uses as its TLS pointer. */
+#define MSR_FS_BASE 0xc0000100
+
 static void process_cleanup(void);
 static bool load(const char *file_name, struct intr_frame *if_);
 static void initd(void *f_name);
 static void __do_fork(void *);
-
-/* General process initializer for initd and other process. */
-static void process_init(void)
+static void __do_clone(void *);
+static void process_release_children(struct thread *);
+static void process_kill_others(void);
+
+/* General process initializer for initd and other process.  Makes
+ * the current thread the main and only thread of a new process.
+ * Returns false if out of memory. */
+static bool process_init(void)
 {
     struct thread *current = thread_current();
+    struct process *p = malloc(sizeof *p);
+
+    if (p == NULL) return false;
+
+    p->main = current;
+    list_init(&p->threads);
+    list_push_back(&p->threads, &current->process_elem);
+    p->thread_cnt = 1;
+    p->exiting = false;
+    p->exit_status = 0;
+    sema_init(&p->left, 0);
+    lock_init(&p->fd_lock);
+    current->process = p;
+    return true;
 }
 
 /* Starts the first userland program, called "initd", loaded from FILE_NAME.
@@ -69,7 +95,7 @@ static void initd(void *f_name)
     supplemental_page_table_init(&thread_current()->spt);
 #endif
 
-    process_init();
+    if (!process_init()) PANIC("Fail to launch initd\n");
 
     if (process_exec(f_name) < 0) PANIC("Fail to launch initd\n");
     NOT_REACHED();
@@ -143,6 +169,9 @@ static bool duplicate_pte(uint64_t *pte, void *va, void *aux)
         return true;
     }
 
+    /* The child gets vdso pages of its own. */
+    if (is_vdso_vaddr(va)) return true;
+
     /* 2. Resolve VA from the parent's page map level 4. */
     parent_page = pml4_get_page(parent->pml4, va);
     if (parent_page == NULL)
@@ -199,8 +228,16 @@ static void __do_fork(void *aux)
 #else
     if (!pml4_for_each(parent->pml4, duplicate_pte, parent)) goto error;
 #endif
+    if (!vdso_map(current->pml4, current->tid)) goto error;
 
-    /* 3. Duplicate file descriptors */
+    /* The parent is blocked in fork(), so its FPU state, if it has
+       any, has been saved. */
+    if (!fpu_copy(current, parent)) goto error;
+    current->fs_base = parent->fs_base;
+
+    /* 3. Duplicate file descriptors.  The parent's other threads
+     * may be closing them meanwhile. */
+    lock_acquire(&parent->process->fd_lock);
     for (int i = 2; i < MAX_FD_NUM; i++)
     {
         if (parent->fdt[i] == NULL)
@@ -210,15 +247,16 @@ static void __do_fork(void *aux)
         else if (parent->fdt[i] != NULL)
         {
             /* 메모리 할당 */
-            current->fdt[i] = malloc(sizeof(struct uni_file));
+            current->fdt[i] = kmem_cache_alloc(uni_file_cache);
             if (current->fdt[i] == NULL)
             {
                 /* 메모리 할당 실패 시 모든 것을 정리하는 sys_exit(-1)으로 */
                 succ = false;
-                goto error;
+                break;
             }
 
             current->fdt[i]->fd_type = parent->fdt[i]->fd_type;
+            current->fdt[i]->ref_cnt = 1;
 
             /* 파일 복제 */
             current->fdt[i]->data.file =
@@ -227,12 +265,14 @@ static void __do_fork(void *aux)
             {
                 /* 파일 복제 실패 시 모든 것을 정리하는 sys_exit(-1)으로 */
                 succ = false;
-                goto error;
+                break;
             }
         }
     }
+    lock_release(&parent->process->fd_lock);
+    if (!succ) goto error;
 
-    process_init();
+    if (!process_init()) goto error;
 
     sema_up(&current->fork_sema);
 
@@ -246,6 +286,100 @@ error:
     sys_exit(-1);
 }
 
+/* What clone() hands to the new thread. */
+struct clone_args
+{
+    struct thread *creator;  /* Thread that called clone(). */
+    struct intr_frame *if_;  /* Its user context. */
+    void *entry;             /* User function to start at. */
+    void *aux;               /* Its argument. */
+    void *stack;             /* Top of the new thread's user stack. */
+    void *tls;               /* The new thread's FS base. */
+};
+
+/* Starts another thread in the current process, running ENTRY(AUX)
+ * in user mode on the stack whose top is STACK, with TLS as its FS
+ * base.  It shares the address space and file descriptors of the
+ * process.  Returns the new thread's id, for process_join(), or
+ * TID_ERROR if the thread cannot be created. */
+tid_t process_clone(void *entry, void *aux, void *stack, void *tls,
+                    struct intr_frame *if_)
+{
+    struct thread *curr = thread_current();
+    struct clone_args args = {curr, if_, entry, aux, stack, tls};
+    struct thread *child;
+    tid_t tid;
+
+    tid = thread_create(curr->name, PRI_DEFAULT, __do_clone, &args);
+    if (tid == TID_ERROR) return TID_ERROR;
+
+    child = process_get_child(tid);
+    if (child == NULL) return TID_ERROR;
+
+    /* ARGS lives on our stack, so wait until the thread is done
+     * with it. */
+    sema_down(&child->fork_sema);
+    if (child->exit_status == -1) return TID_ERROR;
+
+    return tid;
+}
+
+/* A thread function that joins the process of the thread that
+ * called clone() and enters user mode as it asked. */
+static void __do_clone(void *args_)
+{
+    struct clone_args *args = args_;
+    struct thread *current = thread_current();
+    struct thread *creator = args->creator;
+    struct process *p = creator->process;
+    struct intr_frame if_;
+    enum intr_level old_level;
+    bool joined;
+
+    memcpy(&if_, args->if_, sizeof if_);
+    if_.rip = (uint64_t) args->entry;
+    if_.R.rdi = (uint64_t) args->aux;
+    /* As if ENTRY had been called: the return address slot leaves
+     * the stack 8 bytes short of 16-byte alignment. */
+    if_.rsp = ((uint64_t) args->stack & ~(uint64_t) 0xf) - 8;
+    current->fs_base = (uint64_t) args->tls;
+    current->cloned = true;
+
+    /* A process that is exiting, or a thread that is being killed,
+     * must not gain threads. */
+    old_level = intr_disable();
+    joined = !p->exiting && !creator->killed;
+    if (joined)
+    {
+        list_push_back(&p->threads, &current->process_elem);
+        p->thread_cnt++;
+        current->process = p;
+    }
+    intr_set_level(old_level);
+
+    if (!joined)
+    {
+        current->exit_status = -1;
+        sema_up(&current->fork_sema);
+        thread_exit();
+    }
+
+    /* Share the process's file descriptor table instead of the one
+     * thread_create() gave us. */
+    kmem_cache_free(uni_file_cache, current->fdt[0]);
+    kmem_cache_free(uni_file_cache, current->fdt[1]);
+    palloc_free_page(current->fdt);
+    current->fdt = creator->fdt;
+
+    current->pml4 = creator->pml4;
+    process_activate(current);
+    current->exit_status = 0;
+
+    sema_up(&current->fork_sema);
+    do_iret(&if_);
+    NOT_REACHED();
+}
+
 /* Switch the current execution context to the f_name.
  * Returns -1 on fail. */
 int process_exec(void *f_name)
@@ -261,8 +395,23 @@ int process_exec(void *f_name)
     _if.cs = SEL_UCSEG;
     _if.eflags = FLAG_IF | FLAG_MBS;
 
+    /* Only the main thread may replace the program, and only once
+     * the other threads are gone, since they share the address
+     * space. */
+    struct process *p = thread_current()->process;
+    if (p != NULL)
+    {
+        if (p->main != thread_current())
+        {
+            palloc_free_page(file_name);
+            return -1;
+        }
+        process_kill_others();
+    }
+
     /* We first kill the current context */
     process_cleanup();
+    fpu_release(thread_current());
 
     /* And then load the binary */
     success = load(file_name, &_if);
@@ -288,7 +437,7 @@ int process_exec(void *f_name)
 int process_wait(tid_t child_tid UNUSED)
 {
     struct thread *child = process_get_child(child_tid);
-    if (child == NULL)
+    if (child == NULL || child->cloned)
     {
         return -1;
     }
@@ -307,10 +456,113 @@ int process_wait(tid_t child_tid UNUSED)
     return child->exit_status;
 }
 
-/* Exit the process. This function is called by thread_exit (). */
+/* Waits for thread TID, which the calling thread must have
+ * created with clone(), to exit and returns the status it passed
+ * to exit_thread(), or -1 if it was killed.  Returns -1 at once if
+ * TID is not such a thread or has already been joined. */
+int process_join(tid_t tid)
+{
+    struct thread *child = process_get_child(tid);
+    int status;
+
+    if (child == NULL || !child->cloned) return -1;
+
+    sema_down(&child->wait_sema);
+    status = child->exit_status;
+    list_remove(&child->child_elem);
+    sema_up(&child->exit_sema);
+    return status;
+}
+
+/* Starts terminating the current thread's process with STATUS,
+ * unless it is already terminating.  Every other thread of the
+ * process exits on its way back to user mode; the main thread then
+ * reports STATUS to the parent. */
+void process_kill(int status)
+{
+    struct process *p = thread_current()->process;
+    enum intr_level old_level;
+    struct list_elem *e;
+
+    if (p == NULL) return;
+
+    old_level = intr_disable();
+    if (!p->exiting)
+    {
+        p->exiting = true;
+        p->exit_status = status;
+        for (e = list_begin(&p->threads); e != list_end(&p->threads);
+             e = list_next(e))
+        {
+            struct thread *t = list_entry(e, struct thread, process_elem);
+            if (t != thread_current()) t->killed = true;
+        }
+    }
+    intr_set_level(old_level);
+    futex_wake_killed();
+}
+
+/* Kills every other thread of the current thread's process, which
+ * must be its main thread, and waits until they are gone. */
+static void process_kill_others(void)
+{
+    struct thread *curr = thread_current();
+    struct process *p = curr->process;
+    enum intr_level old_level;
+    struct list_elem *e;
+
+    ASSERT(p->main == curr);
+
+    old_level = intr_disable();
+    for (e = list_begin(&p->threads); e != list_end(&p->threads);
+         e = list_next(e))
+    {
+        struct thread *t = list_entry(e, struct thread, process_elem);
+        if (t != curr) t->killed = true;
+    }
+    intr_set_level(old_level);
+    futex_wake_killed();
+
+    old_level = intr_disable();
+    while (p->thread_cnt > 1) sema_down(&p->left);
+    intr_set_level(old_level);
+}
+
+/* Exit the process. This function is called by thread_exit ().
+ * A thread other than the main one only leaves the process,
+ * since the main thread tears it down once all others are gone. */
 void process_exit(void)
 {
     struct thread *curr = thread_current();
+    struct process *p = curr->process;
+
+    if (p != NULL && p->main != curr)
+    {
+        enum intr_level old_level;
+
+        /* Stop using the address space before we stop counting. */
+        curr->pml4 = NULL;
+        pml4_activate(NULL);
+        curr->fdt = NULL;
+
+        old_level = intr_disable();
+        list_remove(&curr->process_elem);
+        p->thread_cnt--;
+        curr->process = NULL;
+        sema_up(&p->left);
+        intr_set_level(old_level);
+
+        process_release_children(curr);
+        sema_up(&curr->wait_sema);
+        sema_down(&curr->exit_sema);
+        return;
+    }
+
+    if (p != NULL)
+    {
+        process_kill(curr->exit_status);
+        process_kill_others();
+    }
 
     if (curr->executing_file != NULL)
     {
@@ -318,13 +570,15 @@ void process_exit(void)
         curr->executing_file = NULL;
     }
 
+    /* The other threads are gone, so nothing but the table refers
+     * to the entries any more. */
     for (int fd_num = 0; fd_num < MAX_FD_NUM; fd_num++)
     {
         if (curr->fdt[fd_num] != NULL)
         {
             if (fd_num == 0 || fd_num == 1)
             {
-                free(curr->fdt[fd_num]);
+                kmem_cache_free(uni_file_cache, curr->fdt[fd_num]);
             }
             else
             {
@@ -332,21 +586,13 @@ void process_exit(void)
                 {
                     file_close(curr->fdt[fd_num]->data.file);
                 }
-                free(curr->fdt[fd_num]);
+                kmem_cache_free(uni_file_cache, curr->fdt[fd_num]);
             }
             curr->fdt[fd_num] = NULL;
         }
     }
 
-    /* 종료되지 않은 자식 프로세스가 있는 것을 생각해 전부 종료시켜줌 */
-    while (!list_empty(&curr->child_list))
-    {
-        struct list_elem *e = list_front(&curr->child_list);
-        struct thread *child = list_entry(e, struct thread, child_elem);
-
-        list_remove(e);              // 리스트에서 먼저 제거
-        sema_up(&child->exit_sema);  // 자식이 종료될 수 있도록 허용
-    }
+    process_release_children(curr);
 
     sema_up(&curr->wait_sema);
 
@@ -355,6 +601,27 @@ void process_exit(void)
     palloc_free_page(curr->fdt);
     curr->fdt = NULL;
     process_cleanup();
+
+    if (p != NULL)
+    {
+        curr->process = NULL;
+        free(p);
+    }
+}
+
+/* Lets the children of T that have not been waited for, processes
+ * and threads alike, exit without waiting for T. */
+static void process_release_children(struct thread *t)
+{
+    /* 종료되지 않은 자식 프로세스가 있는 것을 생각해 전부 종료시켜줌 */
+    while (!list_empty(&t->child_list))
+    {
+        struct list_elem *e = list_front(&t->child_list);
+        struct thread *child = list_entry(e, struct thread, child_elem);
+
+        list_remove(e);              // 리스트에서 먼저 제거
+        sema_up(&child->exit_sema);  // 자식이 종료될 수 있도록 허용
+    }
 }
 
 /* Free the current process's resources. */
@@ -381,6 +648,7 @@ static void process_cleanup(void)
          * that's been freed (and cleared). */
         curr->pml4 = NULL;
         pml4_activate(NULL);
+        vdso_unmap(pml4);
         pml4_destroy(pml4);
     }
 }
@@ -394,6 +662,9 @@ void process_activate(struct thread *next)
 
     /* Set thread's kernel stack for use in processing interrupts. */
     tss_update(next);
+
+    /* Give it its own TLS pointer. */
+    write_msr(MSR_FS_BASE, next->fs_base);
 }
 
 /* We load ELF binaries.  The following definitions are taken
@@ -484,7 +755,7 @@ static bool load(const char *file_name, struct intr_frame *if_)
     process_activate(thread_current());
 
     /* Open executable file. */
-    lock_acquire(&filesys_lock);
+    rwlock_read_acquire(&filesys_lock);
     file = filesys_open(file_name);
 
     if (file == NULL)
@@ -566,6 +837,9 @@ static bool load(const char *file_name, struct intr_frame *if_)
     /* Set up stack. */
     if (!setup_stack(if_)) goto done;
 
+    /* Map the clock and pid pages. */
+    if (!vdso_map(t->pml4, t->tid)) goto done;
+
     /* Set up arguments on user stack */
     setup_argument(argc, argv, if_);
 
@@ -580,7 +854,7 @@ static bool load(const char *file_name, struct intr_frame *if_)
 
 done:
     /* We arrive here whether the load is successful or not. */
-    lock_release(&filesys_lock);
+    rwlock_read_release(&filesys_lock);
     return success;
 }
 
@@ -639,7 +913,10 @@ static void setup_argument(int argc, char *argv[], struct intr_frame *if_)
         memcpy(if_->rsp, argv[i], args_len);
         args_start_addr[i] = if_->rsp;
     }
-    size_t pad_size = if_->rsp % 8;
+    /* Pad so that rsp % 16 == 8 once argv[], its null sentinel and
+     * the fake return address are pushed, as the ABI has it on
+     * entry to a function.  SSE code relies on it. */
+    size_t pad_size = if_->rsp % 16 + (argc % 2 == 0 ? 8 : 0);
     if_->rsp -= pad_size;
     memset(if_->rsp, 0, pad_size);
     if_->rsp -= 8;
@@ -14,9 +14,13 @@
 #include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/process.h"
+#include "userprog/tss.h"
+#include "userprog/vdso.h"
 
 void syscall_entry(void);
 void syscall_handler(struct intr_frame *);
@@ -33,11 +37,46 @@ void syscall_handler(struct intr_frame *);
 #define MSR_STAR 0xc0000081         /* Segment selector msr */
 #define MSR_LSTAR 0xc0000082        /* Long mode SYSCALL target */
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
+#define MSR_KERNEL_GS_BASE 0xc0000102 /* GS base swapped in by swapgs */
 
-struct lock filesys_lock;
+/* Scratch space for syscall_entry, which has nowhere to save
+ * registers until it has found the kernel stack.  Each processor
+ * has its own slot, which syscall_entry reaches through the kernel
+ * GS base.  The layout is fixed by syscall-entry.S. */
+struct syscall_scratch
+{
+    uint64_t rbx;
+    uint64_t r12;
+    struct task_state *tss;
+};
+static struct syscall_scratch syscall_scratch[SMP_MAX_CPUS];
+
+static void syscall_init_msrs(void);
+
+/* Serializes changes to the file system.  Threads that only read
+ * files and directories hold it for reading, so they do not wait
+ * for one another. */
+struct rwlock filesys_lock;
 
 void syscall_init(void)
 {
+    syscall_init_msrs();
+    rwlock_init(&filesys_lock);
+    rwlock_set_name(&filesys_lock, "filesys_lock");
+}
+
+/* Sets up an application processor for system calls. */
+void syscall_init_ap(void)
+{
+    syscall_init_msrs();
+}
+
+/* Points the running processor's system call MSRs at
+ * syscall_entry, and its kernel GS base at its scratch slot. */
+static void syscall_init_msrs(void)
+{
+    struct syscall_scratch *scratch = &syscall_scratch[this_cpu()->id];
+
     write_msr(MSR_STAR, ((uint64_t) SEL_UCSEG - 0x10) << 48 |
                             ((uint64_t) SEL_KCSEG) << 32);
     write_msr(MSR_LSTAR, (uint64_t) syscall_entry);
@@ -48,7 +87,8 @@ void syscall_init(void)
     write_msr(MSR_SYSCALL_MASK,
               FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
 
-    lock_init(&filesys_lock);
+    scratch->tss = tss_get();
+    write_msr(MSR_KERNEL_GS_BASE, (uint64_t) scratch);
 }
 
 void check_valid(void *vaddr)
@@ -75,20 +115,67 @@ void check_fd(int fd)
 int allocate_file(struct file *open_file)
 {
     struct thread *curr = thread_current();
+    int fd_num = -1;
 
+    /* The threads of a process share its fd table. */
+    lock_acquire(&curr->process->fd_lock);
     for (int i = 0; i < MAX_FD_NUM; i++)
     {
         if (curr->fdt[i] == NULL)
         {
-            curr->fdt[i] = malloc(sizeof(struct uni_file));
+            curr->fdt[i] = kmem_cache_alloc(uni_file_cache);
             curr->fdt[i]->fd_type = FD_FILE;
+            curr->fdt[i]->ref_cnt = 1;
             curr->fdt[i]->data.file = open_file;
 
-            return i;
+            fd_num = i;
+            break;
         }
     }
+    lock_release(&curr->process->fd_lock);
+
+    return fd_num;
+}
+
+/* Returns the entry for FD, which check_fd() has passed, in the
+   running thread's fd table, or a null pointer if FD is not open.
+   A reference is taken, so the entry stays open even if another
+   thread of the process closes FD meanwhile.  Release it with
+   fd_put(). */
+static struct uni_file *fd_get(int fd)
+{
+    struct thread *curr = thread_current();
+    struct uni_file *f;
+
+    lock_acquire(&curr->process->fd_lock);
+    f = curr->fdt[fd];
+    if (f != NULL) f->ref_cnt++;
+    lock_release(&curr->process->fd_lock);
+
+    return f;
+}
+
+/* Drops a reference to F, closing it when no fd table slot or
+   system call uses it any longer. */
+static void fd_put(struct uni_file *f)
+{
+    struct lock *fd_lock = &thread_current()->process->fd_lock;
+    bool last;
+
+    lock_acquire(fd_lock);
+    last = --f->ref_cnt == 0;
+    lock_release(fd_lock);
+
+    if (!last)
+    {
+        return;
+    }
 
-    return -1;
+    if (f->fd_type != FD_STDIN && f->fd_type != FD_STDOUT)
+    {
+        file_close(f->data.file);
+    }
+    kmem_cache_free(uni_file_cache, f);
 }
 
 void sys_halt(void)
@@ -99,6 +186,16 @@ void sys_halt(void)
 void sys_exit(int status)
 {
     struct thread *curr = thread_current();
+    struct process *p = curr->process;
+
+    /* Any thread may exit the process, but only the main thread
+       reports the status, which is the first one passed. */
+    if (!curr->killed) process_kill(status);
+    if (p != NULL)
+    {
+        if (p->main != curr) thread_exit();
+        status = p->exit_status;
+    }
     curr->exit_status = status;
 
     printf("%s: exit(%d)\n", curr->name, curr->exit_status);
@@ -135,21 +232,20 @@ bool sys_create(const char *file, unsigned initial_size)
 {
     check_valid(file);
 
-    if (filesys_create(file, initial_size))
-    {
-        return true;
-    }
-    else
-    {
-        return false;
-    }
+    rwlock_write_acquire(&filesys_lock);
+    bool create_result = filesys_create(file, initial_size);
+    rwlock_write_release(&filesys_lock);
+
+    return create_result;
 }
 
 bool sys_remove(const char *file)
 {
     check_valid(file);
 
+    rwlock_write_acquire(&filesys_lock);
     bool file_remove_result = filesys_remove(file);
+    rwlock_write_release(&filesys_lock);
 
     return file_remove_result;
 }
@@ -158,9 +254,9 @@ int sys_open(const char *file)
 {
     check_valid(file);
 
-    lock_acquire(&filesys_lock);
+    rwlock_read_acquire(&filesys_lock);
     struct file *open_file = filesys_open(file);
-    lock_release(&filesys_lock);
+    rwlock_read_release(&filesys_lock);
 
     if (open_file == NULL)
     {
@@ -182,9 +278,17 @@ int sys_filesize(int fd)
 {
     check_fd(fd);
 
-    struct thread *curr = thread_current();
-    struct file *file = curr->fdt[fd]->data.file;
-    return file_length(file);
+    struct uni_file *f = fd_get(fd);
+
+    if (f == NULL)
+    {
+        return -1;
+    }
+
+    int length = file_length(f->data.file);
+    fd_put(f);
+
+    return length;
 }
 
 int sys_read(int fd, void *buffer, unsigned length)
@@ -192,22 +296,27 @@ int sys_read(int fd, void *buffer, unsigned length)
     check_valid(buffer);
     check_fd(fd);
 
+    /* The vdso pages are read-only to the user, but not to us. */
+    if (length > 0 && (uint64_t) buffer < VDSO_ADDR + VDSO_PAGES * PGSIZE &&
+        (uint64_t) buffer + length > VDSO_ADDR)
+        sys_exit(-1);
+
     if (fd == 1)
     {
         return -1;
     }
 
-    struct thread *curr = thread_current();
-    struct file *reading_file = curr->fdt[fd]->data.file;
+    struct uni_file *reading = fd_get(fd);
 
-    if (reading_file == NULL)
+    if (reading == NULL)
     {
         return -1;
     }
 
-    lock_acquire(&filesys_lock);
-    off_t bytes_read = file_read(reading_file, buffer, length);
-    lock_release(&filesys_lock);
+    rwlock_read_acquire(&filesys_lock);
+    off_t bytes_read = file_read(reading->data.file, buffer, length);
+    rwlock_read_release(&filesys_lock);
+    fd_put(reading);
 
     return bytes_read;
 }
@@ -228,17 +337,17 @@ int sys_write(int fd, const void *buffer, unsigned length)
         return length;
     }
 
-    struct thread *curr = thread_current();
-    struct file *file = curr->fdt[fd]->data.file;
+    struct uni_file *writing = fd_get(fd);
 
-    if (file == NULL)
+    if (writing == NULL)
     {
         return -1;
     }
 
-    lock_acquire(&filesys_lock);
-    off_t bytes_written = file_write(file, buffer, length);
-    lock_release(&filesys_lock);
+    rwlock_write_acquire(&filesys_lock);
+    off_t bytes_written = file_write(writing->data.file, buffer, length);
+    rwlock_write_release(&filesys_lock);
+    fd_put(writing);
 
     return bytes_written;
 }
@@ -247,20 +356,30 @@ void sys_seek(int fd, unsigned position)
 {
     check_fd(fd);
 
-    struct thread *curr = thread_current();
-    struct file *file = curr->fdt[fd]->data.file;
+    struct uni_file *f = fd_get(fd);
 
-    file_seek(file, position);
+    if (f == NULL)
+    {
+        return;
+    }
+
+    file_seek(f->data.file, position);
+    fd_put(f);
 }
 
 unsigned sys_tell(int fd)
 {
     check_fd(fd);
 
-    struct thread *curr = thread_current();
-    struct file *file = curr->fdt[fd]->data.file;
+    struct uni_file *f = fd_get(fd);
 
-    off_t file_pos = file_tell(file);
+    if (f == NULL)
+    {
+        return -1;
+    }
+
+    off_t file_pos = file_tell(f->data.file);
+    fd_put(f);
 
     return file_pos;
 }
@@ -278,20 +397,97 @@ void sys_close(int fd)
 
     struct thread *curr = thread_current();
 
-    if (curr->fdt[fd] == NULL)
+    lock_acquire(&curr->process->fd_lock);
+    struct uni_file *closing = curr->fdt[fd];
+    curr->fdt[fd] = NULL;
+    lock_release(&curr->process->fd_lock);
+
+    if (closing == NULL)
     {
         return;
     }
 
-    struct file *closing_file = curr->fdt[fd]->data.file;
+    /* Closed now, or when the last system call using it returns. */
+    fd_put(closing);
+}
 
-    file_close(closing_file);
+int sys_dup2(int oldfd, int newfd)
+{
+}
 
-    curr->fdt[fd] = NULL;
+/* Puts the calling process in the EDF scheduling class with a
+   budget of RUNTIME timer ticks in every PERIOD ticks, or takes it
+   out if RUNTIME is 0.  Returns false if the reservation is
+   invalid or cannot be admitted. */
+bool sys_sched_deadline(int runtime, int period)
+{
+    return thread_set_deadline(runtime, period);
 }
 
-int sys_dup2(int oldfd, int newfd)
+/* Ends the calling process's job for this EDF period and sleeps
+   until the next one.  Returns the number of deadlines it has
+   missed so far. */
+int sys_sched_wait(void)
+{
+    thread_deadline_wait();
+    return thread_get_deadline_misses();
+}
+
+/* Performs futex operation OP on the int at UADDR with argument
+   VAL: FUTEX_WAIT sleeps while *UADDR == VAL, and FUTEX_WAKE wakes
+   up to VAL waiters.  See userprog/futex.c. */
+int sys_futex(int *uaddr, int op, int val)
 {
+    check_valid(uaddr);
+    if ((uintptr_t) uaddr % sizeof *uaddr != 0) sys_exit(-1);
+
+    switch (op)
+    {
+        case FUTEX_WAIT:
+            return futex_wait(uaddr, val);
+        case FUTEX_WAKE:
+            return futex_wake(uaddr, val);
+        default:
+            return -1;
+    }
+}
+
+/* Starts a thread in the calling process that runs ENTRY(AUX) on
+   the user stack whose top is STACK, with TLS as its FS base.
+   Returns its thread id, or -1 on failure, including when TLS is
+   neither null nor a user address. */
+int sys_clone(void *entry, void *aux, void *stack, void *tls,
+              struct intr_frame *f)
+{
+    check_valid(entry);
+    check_valid((uint8_t *) stack - 1);
+
+    /* Writing a non-canonical FS base would fault in the kernel. */
+    if (tls != NULL && !is_user_vaddr(tls))
+    {
+        return -1;
+    }
+
+    return process_clone(entry, aux, stack, tls, f);
+}
+
+/* Waits for thread TID, created by the caller with clone(), and
+   returns the status it passed to exit_thread(). */
+int sys_join(int tid)
+{
+    return process_join(tid);
+}
+
+/* Ends the calling thread with STATUS.  In the main thread, this
+   is exit(STATUS). */
+void sys_exit_thread(int status)
+{
+    struct thread *curr = thread_current();
+
+    if (curr->process == NULL || curr->process->main == curr)
+        sys_exit(status);
+    curr->exit_status = status;
+    thread_exit();
 }
 
 /* The main system call interface */
@@ -340,7 +536,29 @@ void syscall_handler(struct intr_frame *f)
             break;
         case SYS_DUP2:
             break;
+        case SYS_SCHED_DEADLINE:
+            f->R.rax = sys_sched_deadline(f->R.rdi, f->R.rsi);
+            break;
+        case SYS_SCHED_WAIT:
+            f->R.rax = sys_sched_wait();
+            break;
+        case SYS_FUTEX:
+            f->R.rax = sys_futex((int *) f->R.rdi, f->R.rsi, f->R.rdx);
+            break;
+        case SYS_CLONE:
+            f->R.rax = sys_clone((void *) f->R.rdi, (void *) f->R.rsi,
+                                 (void *) f->R.rdx, (void *) f->R.r10, f);
+            break;
+        case SYS_JOIN:
+            f->R.rax = sys_join(f->R.rdi);
+            break;
+        case SYS_EXIT_THREAD:
+            sys_exit_thread(f->R.rdi);
+            break;
         default:
             break;
     }
+
+    /* Some other thread may have exited the process meanwhile. */
+    if (thread_current()->killed) sys_exit(-1);
 }
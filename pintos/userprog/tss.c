@@ -5,6 +5,7 @@
 
 #include "intrinsic.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/gdt.h"
@@ -45,32 +46,33 @@
  *      not in use, so we can always use that.  Thus, when the
  *      scheduler switches threads, it also changes the TSS's
  *      stack pointer to point to the new thread's kernel stack.
- *      (The call is in schedule in thread.c.) */
-
-/* Kernel TSS. */
-struct task_state *tss;
+ *      (The call is in schedule in thread.c.)
+ *
+ *  Each processor has a TSS of its own, since each one runs a
+ *  different thread.  It is kept in the processor's `struct cpu'. */
 
-/* Initializes the kernel TSS. */
+/* Initializes the running processor's kernel TSS. */
 void tss_init(void)
 {
     /* Our TSS is never used in a call gate or task gate, so only a
      * few fields of it are ever referenced, and those are the only
      * ones we initialize. */
-    tss = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+    this_cpu()->tss = palloc_get_page(PAL_ASSERT | PAL_ZERO);
     tss_update(thread_current());
 }
 
-/* Returns the kernel TSS. */
+/* Returns the running processor's kernel TSS. */
 struct task_state *tss_get(void)
 {
+    struct task_state *tss = this_cpu()->tss;
+
     ASSERT(tss != NULL);
     return tss;
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
- * of the thread stack. */
+/* Sets the ring 0 stack pointer in the running processor's TSS to
+ * point to the end of the thread stack. */
 void tss_update(struct thread *next)
 {
-    ASSERT(tss != NULL);
-    tss->rsp0 = (uint64_t) next + PGSIZE;
+    tss_get()->rsp0 = (uint64_t) next + PGSIZE;
 }
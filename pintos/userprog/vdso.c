@@ -0,0 +1,114 @@
+#include "userprog/vdso.h"
+
+#include <debug.h>
+
+#include "devices/hrtimer.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+
+/* Clock and pid pages mapped into user processes.
+
+   The clock page is a single frame that every process maps
+   read-only at VDSO_ADDR.  Once vdso_init() has filled it in,
+   only timer_interrupt() writes it, through vdso_tick(), and it
+   brackets each write with increments of its sequence number as
+   seqlock_write_begin() and seqlock_write_end() do.  The
+   nanosecond clock is the one hrtimer_now() reads.  The page
+   after it is allocated per process and holds the pid.
+
+   pml4_destroy() frees every frame a page table maps, so
+   vdso_unmap() must take both pages out before that. */
+
+/* The clock page. */
+static struct vdso_clock *clock;
+
+static void clock_write_begin(void);
+static void clock_write_end(void);
+
+/* Allocates the clock page and starts publishing the time in it.
+   Must be called after timer_calibrate(), so that the nanosecond
+   clock is calibrated. */
+void vdso_init(void)
+{
+    struct vdso_clock *c = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+    enum intr_level old_level;
+
+    c->timer_freq = TIMER_FREQ;
+    hrtimer_clock(&c->tsc_base, &c->tsc_mult);
+
+    old_level = intr_disable();
+    c->ticks = timer_ticks();
+    clock = c;
+    intr_set_level(old_level);
+}
+
+/* Publishes TICKS, the new value of the timer tick count.  Called
+   by the timer interrupt handler. */
+void vdso_tick(int64_t ticks)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (clock == NULL) return;
+
+    clock_write_begin();
+    clock->ticks = ticks;
+    clock_write_end();
+}
+
+/* Maps the clock page and a new page holding PID into PML4,
+   read-only, at VDSO_ADDR.  Returns true if successful, false if
+   out of memory or if something is already mapped there. */
+bool vdso_map(uint64_t *pml4, int pid)
+{
+    uint8_t *upage = (uint8_t *) VDSO_ADDR;
+    struct vdso_process *process;
+
+    if (pml4_get_page(pml4, upage) != NULL ||
+        pml4_get_page(pml4, upage + PGSIZE) != NULL)
+        return false;
+
+    process = palloc_get_page(PAL_USER | PAL_ZERO);
+    if (process == NULL) return false;
+    process->pid = pid;
+
+    if (!pml4_set_page(pml4, upage, clock, false) ||
+        !pml4_set_page(pml4, upage + PGSIZE, process, false))
+    {
+        pml4_clear_page(pml4, upage);
+        palloc_free_page(process);
+        return false;
+    }
+    return true;
+}
+
+/* Removes what vdso_map() mapped from PML4, if anything, and frees
+   the pid page. */
+void vdso_unmap(uint64_t *pml4)
+{
+    uint8_t *upage = (uint8_t *) VDSO_ADDR;
+    void *process;
+
+    if (pml4_get_page(pml4, upage) != clock) return;
+    pml4_clear_page(pml4, upage);
+
+    process = pml4_get_page(pml4, upage + PGSIZE);
+    if (process == NULL) return;
+    pml4_clear_page(pml4, upage + PGSIZE);
+    palloc_free_page(process);
+}
+
+/* Starts changing the clock page. */
+static void clock_write_begin(void)
+{
+    __atomic_store_n(&clock->seq, clock->seq + 1, __ATOMIC_RELAXED);
+    barrier();
+}
+
+/* Finishes changing the clock page. */
+static void clock_write_end(void)
+{
+    __atomic_store_n(&clock->seq, clock->seq + 1, __ATOMIC_RELEASE);
+}
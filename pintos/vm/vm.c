@@ -5,6 +5,9 @@
 #include "vm/vm.h"
 #include "vm/inspect.h"
 
+/* Cache that `struct frame's are allocated from. */
+static struct kmem_cache *frame_cache;
+
 /* 각 서브시스템의 초기화 코드를 호출하여
  * 가상 메모리 서브시스템을 초기화합니다. */
 void vm_init(void)
@@ -17,6 +20,8 @@ void vm_init(void)
     register_inspect_intr();
     /* ! DO NOT MODIFY UPPER LINES. */
     /* TODO: Your code goes here. */
+    frame_cache = kmem_cache_create("frame", sizeof(struct frame), NULL);
+    if (frame_cache == NULL) PANIC("out of memory for frame cache");
 }
 
 /* 페이지의 타입을 가져옵니다.
@@ -119,17 +124,17 @@ static struct frame *vm_evict_frame(void)
  * 이 함수는 프레임을 제거하여 사용 가능한 메모리 공간을 확보합니다. */
 static struct frame *vm_get_frame(void)
 {
-    struct frame *frame = malloc(sizeof(struct frame));
+    struct frame *frame = kmem_cache_alloc(frame_cache);
     void *kva = palloc_get_page(PAL_USER);
     if (kva == NULL)
     {
         PANIC("jinwoo");
     }
 
+    ASSERT(frame != NULL);
     frame->kva = kva;
+    frame->page = NULL;
 
-    ASSERT(frame != NULL);
-    ASSERT(frame->page == NULL);
     return frame;
 }
 